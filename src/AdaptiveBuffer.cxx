@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "AdaptiveBuffer.hxx"
+
+#include <glib.h>
+
+#include <assert.h>
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "adaptive_buffer"
+
+AdaptiveBuffer::AdaptiveBuffer(unsigned initial, unsigned _min, unsigned _max)
+	:min_chunks(_min), max_chunks(_max)
+{
+	assert(min_chunks <= max_chunks);
+
+	threshold[false] = threshold[true] = Clamp(initial);
+}
+
+void
+AdaptiveBuffer::Set(bool remote, unsigned n)
+{
+	n = Clamp(n);
+	if (n == threshold[remote])
+		return;
+
+	g_debug("%s: %u -> %u chunks", remote ? "remote" : "local",
+		threshold[remote], n);
+	threshold[remote] = n;
+}
+
+void
+AdaptiveBuffer::Grow(bool remote)
+{
+	const unsigned t = threshold[remote];
+	Set(remote, t > 0 ? t * 2 : 1);
+}
+
+void
+AdaptiveBuffer::Settle(bool remote, unsigned drain)
+{
+	const unsigned t = threshold[remote];
+	const unsigned shrunk = t - t / 4;
+	const unsigned needed = drain * 2;
+
+	Set(remote, needed > shrunk ? needed : shrunk);
+}
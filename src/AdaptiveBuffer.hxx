@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ADAPTIVE_BUFFER_HXX
+#define MPD_ADAPTIVE_BUFFER_HXX
+
+#include "gcc.h"
+
+/**
+ * Chooses the number of chunks which must be decoded before playback
+ * starts or resumes (see #player_control::buffered_before_play).
+ * Local files and remote streams are tracked separately, because
+ * they behave very differently, and a playlist may mix them.
+ *
+ * The threshold doubles after an underrun, and shrinks slowly
+ * after each song which played without one, but never below twice
+ * the amount by which the buffer was drained during that song.  It
+ * always stays within the configured bounds; if both bounds are
+ * equal, the threshold is constant.
+ *
+ * This object is only used by the player thread.
+ */
+class AdaptiveBuffer {
+	const unsigned min_chunks, max_chunks;
+
+	/**
+	 * The current threshold, indexed by "is remote".
+	 */
+	unsigned threshold[2];
+
+public:
+	AdaptiveBuffer(unsigned initial, unsigned _min, unsigned _max);
+
+	bool IsEnabled() const {
+		return min_chunks < max_chunks;
+	}
+
+	gcc_pure
+	unsigned Get(bool remote) const {
+		return threshold[remote];
+	}
+
+	/**
+	 * The decoder didn't keep up with playback.
+	 */
+	void Grow(bool remote);
+
+	/**
+	 * A song has been played completely without an underrun.
+	 *
+	 * @param drain the maximum number of chunks by which the
+	 * buffer level dropped below the level it had when buffering
+	 * was complete
+	 */
+	void Settle(bool remote, unsigned drain);
+
+private:
+	unsigned Clamp(unsigned n) const {
+		return n < min_chunks
+			? min_chunks
+			: (n > max_chunks ? max_chunks : n);
+	}
+
+	void Set(bool remote, unsigned n);
+};
+
+#endif
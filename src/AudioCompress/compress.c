@@ -89,37 +89,34 @@ struct CompressorConfig *Compressor_getConfig(struct Compressor *obj)
         return &obj->prefs;
 }
 
-void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
-                              unsigned int count)
+/*! The gain ramp for one block of samples, see Compressor_prepare() */
+struct CompressorRamp {
+        int curGain;
+        int newGain;
+        int delta;
+        unsigned int ramp;
+        unsigned int slot;
+};
+
+/*! Determine the gain for the next block from its peak (on a 16 bit
+ *  scale, with the position of the peak) and the peak history.  The
+ *  whole block is scanned before any sample is amplified, so the ramp
+ *  can be cut short before a peak which would clip.
+ */
+static void Compressor_prepare(struct Compressor *obj, int peakVal,
+                               int peakPos, unsigned int count,
+                               struct CompressorRamp *r)
 {
         struct CompressorConfig *prefs = Compressor_getConfig(obj);
-	int16_t *ap;
-	unsigned int i;
         int *peaks = obj->peaks;
         int curGain = obj->gain[obj->pos];
         int newGain;
-        int peakVal = 1;
-        int peakPos = 0;
-        int slot = (obj->pos + 1) % obj->bufsz;
-        int *clipped = obj->clipped + slot;
+        unsigned int slot = (obj->pos + 1) % obj->bufsz;
         unsigned int ramp = count;
-        int delta;
+	unsigned int i;
 
-	ap = audio;
-	for (i = 0; i < count; i++)
-	{
-		int val = *ap++;
-                if (val < 0)
-                        val = -val;
-		if (val > peakVal)
-                {
-			peakVal = val;
-                        peakPos = i;
-                }
-	}
 	peaks[slot] = peakVal;
 
-
 	for (i = 0; i < obj->bufsz; i++)
 	{
 		if (peaks[i] > peakVal)
@@ -159,10 +156,44 @@ void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
                 ramp = 1;
         if (!curGain)
                 curGain = 1 << 10;
-	delta = (newGain - curGain) / (int)ramp;
+
+        r->curGain = curGain;
+        r->newGain = newGain;
+        r->delta = (newGain - curGain) / (int)ramp;
+        r->ramp = ramp;
+        r->slot = slot;
+        obj->clipped[slot] = 0;
+}
+
+void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
+                              unsigned int count)
+{
+	int16_t *ap;
+	unsigned int i;
+        int peakVal = 1;
+        int peakPos = 0;
+        struct CompressorRamp r;
+        int curGain;
+        int *clipped;
+
+	ap = audio;
+	for (i = 0; i < count; i++)
+	{
+		int val = *ap++;
+                if (val < 0)
+                        val = -val;
+		if (val > peakVal)
+                {
+			peakVal = val;
+                        peakPos = i;
+                }
+	}
+
+        Compressor_prepare(obj, peakVal, peakPos, count, &r);
+        curGain = r.curGain;
+        clipped = obj->clipped + r.slot;
 
 	ap = audio;
-        *clipped = 0;
 	for (i = 0; i < count; i++)
 	{
 		int sample;
@@ -181,12 +212,154 @@ void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
 		*ap++ = sample;
 
                 //! Adjust the gain
-                if (i < ramp)
-                        curGain += delta;
+                if (i < r.ramp)
+                        curGain += r.delta;
                 else
-                        curGain = newGain;
+                        curGain = r.newGain;
 	}
 
-        obj->pos = slot;
+        obj->pos = r.slot;
 }
 
+/*! Amplify one sample; the amount which was clipped is added to
+ *  *clip, which should point to a local variable.
+ */
+static inline int32_t Compressor_amplify_int32(int32_t value, int gain,
+                                               int32_t min, int32_t max,
+                                               unsigned int shift, int *clip)
+{
+        int64_t sample = (int64_t)value * gain >> 10;
+
+        if (sample < min)
+        {
+                *clip += (int)((min - sample) >> shift);
+                sample = min;
+        } else if (sample > max)
+        {
+                *clip += (int)((sample - max) >> shift);
+                sample = max;
+        }
+
+        return (int32_t)sample;
+}
+
+void Compressor_Process_int32(struct Compressor *obj, int32_t *audio,
+                              unsigned int count, unsigned int bits)
+{
+        const unsigned int shift = bits - 16;
+        const int32_t max = (int32_t)((1u << (bits - 1)) - 1);
+        const int32_t min = -max - 1;
+	int32_t *ap;
+	unsigned int i, ramp;
+        int peakVal = 1;
+        int peakPos = 0;
+        struct CompressorRamp r;
+        int curGain;
+        int clip = 0;
+
+        /* the peak detection works on a 16 bit scale */
+	ap = audio;
+	for (i = 0; i < count; i++)
+	{
+		int val = *ap++ >> shift;
+                if (val < 0)
+                        val = -val;
+		if (val > peakVal)
+                {
+			peakVal = val;
+                        peakPos = i;
+                }
+	}
+
+        Compressor_prepare(obj, peakVal, peakPos, count, &r);
+        curGain = r.curGain;
+        ramp = r.ramp < count ? r.ramp : count;
+
+        //! Ramp the gain towards the new value
+	for (i = 0; i < ramp; i++)
+	{
+		audio[i] = Compressor_amplify_int32(audio[i], curGain,
+                                                    min, max, shift, &clip);
+                curGain += r.delta;
+	}
+
+        //! Apply the new gain to the rest of the block
+        curGain = r.newGain;
+	for (; i < count; i++)
+		audio[i] = Compressor_amplify_int32(audio[i], curGain,
+                                                    min, max, shift, &clip);
+
+        obj->clipped[r.slot] = clip;
+        obj->pos = r.slot;
+}
+
+/*! Amplify one sample; the amount which was clipped (on a 16 bit
+ *  scale) is added to *clip, which should point to a local variable.
+ */
+static inline float Compressor_amplify_float(float value, int gain,
+                                             int *clip)
+{
+        float sample = value * (float)gain * (1.0f / 1024.0f);
+
+        if (sample < -1.0f)
+        {
+                *clip += (int)((-1.0f - sample) * 32767.0f);
+                sample = -1.0f;
+        } else if (sample > 1.0f)
+        {
+                *clip += (int)((sample - 1.0f) * 32767.0f);
+                sample = 1.0f;
+        }
+
+        return sample;
+}
+
+void Compressor_Process_float(struct Compressor *obj, float *audio,
+                              unsigned int count)
+{
+	float *ap;
+	unsigned int i, ramp;
+        float peak = 0;
+        int peakVal;
+        int peakPos = 0;
+        struct CompressorRamp r;
+        int curGain;
+        int clip = 0;
+
+	ap = audio;
+	for (i = 0; i < count; i++)
+	{
+		float val = *ap++;
+                if (val < 0)
+                        val = -val;
+		if (val > peak)
+                {
+			peak = val;
+                        peakPos = i;
+                }
+	}
+
+        /* the peak detection works on a 16 bit scale */
+        peakVal = peak >= 1.0f ? 32767 : (int)(peak * 32767.0f);
+        if (peakVal < 1)
+                peakVal = 1;
+
+        Compressor_prepare(obj, peakVal, peakPos, count, &r);
+        curGain = r.curGain;
+        ramp = r.ramp < count ? r.ramp : count;
+
+        //! Ramp the gain towards the new value
+	for (i = 0; i < ramp; i++)
+	{
+		audio[i] = Compressor_amplify_float(audio[i], curGain, &clip);
+                curGain += r.delta;
+	}
+
+        //! Apply the new gain to the rest of the block
+        curGain = r.newGain;
+	for (; i < count; i++)
+		audio[i] = Compressor_amplify_float(audio[i], curGain, &clip);
+
+        obj->clipped[r.slot] = clip;
+        obj->pos = r.slot;
+}
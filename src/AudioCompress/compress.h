@@ -38,12 +38,17 @@ struct CompressorConfig *Compressor_getConfig(struct Compressor *);
 //! Process 16-bit signed data
 void Compressor_Process_int16(struct Compressor *, int16_t *data, unsigned int count);
 
+//! Process 32-bit signed data with the specified number of significant bits (e.g. 24)
+void Compressor_Process_int32(struct Compressor *, int32_t *data, unsigned int count,
+                              unsigned int bits);
+
+//! Process floating point data (-1.0 .. 1.0)
+void Compressor_Process_float(struct Compressor *, float *data, unsigned int count);
+
 #ifdef __cplusplus
 }
 #endif
 
-//! TODO: Compressor_Process_int32, Compressor_Process_float, others as needed
-
 //! TODO: functions for getting at the peak/gain/clip history buffers (for monitoring)
 
 #endif
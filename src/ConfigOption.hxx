@@ -29,6 +29,7 @@ enum ConfigOption {
 	CONF_FOLLOW_OUTSIDE_SYMLINKS,
 	CONF_DB_FILE,
 	CONF_STICKER_FILE,
+	CONF_TAG_CACHE_FILE,
 	CONF_LOG_FILE,
 	CONF_PID_FILE,
 	CONF_STATE_FILE,
@@ -53,6 +54,12 @@ enum ConfigOption {
 	CONF_SAMPLERATE_CONVERTER,
 	CONF_AUDIO_BUFFER_SIZE,
 	CONF_BUFFER_BEFORE_PLAY,
+	CONF_BUFFER_BEFORE_PLAY_MIN,
+	CONF_BUFFER_BEFORE_PLAY_MAX,
+	CONF_INPUT_PREFETCH,
+	CONF_PIPELINE_STATS_INTERVAL,
+	CONF_THREAD,
+	CONF_AUDIO_BUFFER_LOCK,
 	CONF_HTTP_PROXY_HOST,
 	CONF_HTTP_PROXY_PORT,
 	CONF_HTTP_PROXY_USER,
@@ -29,6 +29,7 @@ const ConfigTemplate config_templates[] = {
 	{ "follow_outside_symlinks", false, false },
 	{ "db_file", false, false },
 	{ "sticker_file", false, false },
+	{ "tag_cache_file", false, false },
 	{ "log_file", false, false },
 	{ "pid_file", false, false },
 	{ "state_file", false, false },
@@ -53,6 +54,12 @@ const ConfigTemplate config_templates[] = {
 	{ "samplerate_converter", false, false },
 	{ "audio_buffer_size", false, false },
 	{ "buffer_before_play", false, false },
+	{ "buffer_before_play_min", false, false },
+	{ "buffer_before_play_max", false, false },
+	{ "input_prefetch", false, false },
+	{ "pipeline_stats_interval", false, false },
+	{ "thread", true, true },
+	{ "audio_buffer_lock", false, false },
 	{ "http_proxy_host", false, false },
 	{ "http_proxy_port", false, false },
 	{ "http_proxy_user", false, false },
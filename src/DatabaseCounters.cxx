@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseCounters.hxx"
+#include "DatabasePlugin.hxx"
+#include "Directory.hxx"
+#include "song.h"
+
+#include <assert.h>
+#include <string.h>
+
+inline void
+DatabaseCounters::Apply(Count &count, unsigned long duration, bool add)
+{
+	if (add) {
+		++count.songs;
+		count.duration += duration;
+	} else {
+		assert(count.songs > 0);
+		assert(count.duration >= duration);
+
+		--count.songs;
+		count.duration -= duration;
+	}
+}
+
+/**
+ * Does the tag contain the value of the specified item before that
+ * item?
+ */
+gcc_pure
+static bool
+IsDuplicate(const struct tag &tag, unsigned i)
+{
+	const struct tag_item &item = *tag.items[i];
+
+	for (unsigned j = 0; j < i; ++j)
+		if (tag.items[j]->type == item.type &&
+		    strcmp(tag.items[j]->value, item.value) == 0)
+			return true;
+
+	return false;
+}
+
+void
+DatabaseCounters::Apply(const song &song, bool add)
+{
+	/* same rounding as the "count" command has always done */
+	const double d = song_get_duration(&song);
+	const unsigned long duration = d > 0 ? (unsigned long)d : 0;
+
+	Apply(total, duration, add);
+
+	const struct tag *tag = song.tag;
+	if (tag == nullptr)
+		return;
+
+	for (unsigned i = 0; i < tag->num_items; ++i) {
+		if (IsDuplicate(*tag, i))
+			continue;
+
+		const struct tag_item &item = *tag->items[i];
+		CountMap &map = tags[item.type];
+
+		if (add)
+			Apply(map[item.value], duration, true);
+		else {
+			auto j = map.find(item.value);
+			assert(j != map.end());
+
+			Apply(j->second, duration, false);
+			if (j->second.songs == 0)
+				map.erase(j);
+		}
+	}
+}
+
+void
+DatabaseCounters::RemoveDirectory(const Directory &directory)
+{
+	const Directory *const d = &directory;
+
+	const struct song *song;
+	directory_for_each_song(song, d)
+		Remove(*song);
+
+	const Directory *child;
+	directory_for_each_child(child, d)
+		RemoveDirectory(*child);
+}
+
+void
+DatabaseCounters::GetStats(DatabaseStats &stats) const
+{
+	stats.song_count = total.songs;
+	stats.total_duration = total.duration;
+	stats.artist_count = tags[TAG_ARTIST].size();
+	stats.album_count = tags[TAG_ALBUM].size();
+}
+
+void
+DatabaseCounters::GetTagCount(enum tag_type type, const char *value,
+			      unsigned &songs_r,
+			      unsigned long &duration_r) const
+{
+	assert(type < TAG_NUM_OF_ITEM_TYPES);
+
+	const CountMap &map = tags[type];
+	auto i = map.find(value);
+	if (i != map.end()) {
+		songs_r = i->second.songs;
+		duration_r = i->second.duration;
+	} else {
+		songs_r = 0;
+		duration_r = 0;
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_COUNTERS_HXX
+#define MPD_DATABASE_COUNTERS_HXX
+
+#include "tag.h"
+#include "gcc.h"
+
+#include <string>
+#include <unordered_map>
+
+struct song;
+struct Directory;
+struct DatabaseStats;
+
+/**
+ * Statistics about a database, updated incrementally whenever a song
+ * is added or removed.  Besides the totals, it counts the songs for
+ * each tag value, so "stats" and "count" with a simple tag filter do
+ * not need to walk the whole database.
+ *
+ * The object is attached to the root #Directory; all methods must be
+ * called while holding the #db_mutex.
+ */
+class DatabaseCounters {
+	struct Count {
+		unsigned songs;
+
+		/**
+		 * The sum of all song durations (in seconds).
+		 */
+		unsigned long duration;
+
+		Count():songs(0), duration(0) {}
+	};
+
+	typedef std::unordered_map<std::string, Count> CountMap;
+
+	Count total;
+
+	/**
+	 * The number of songs for each distinct tag value.  Values
+	 * which occur more than once in the same song are counted
+	 * once.
+	 */
+	CountMap tags[TAG_NUM_OF_ITEM_TYPES];
+
+public:
+	void Add(const song &song) {
+		Apply(song, true);
+	}
+
+	/**
+	 * Removes a song from the counters.  Its tag must be the same
+	 * as when it was added.
+	 */
+	void Remove(const song &song) {
+		Apply(song, false);
+	}
+
+	/**
+	 * Recursively remove all songs of a directory.
+	 */
+	void RemoveDirectory(const Directory &directory);
+
+	/**
+	 * Fills the #DatabaseStats object with the totals.
+	 */
+	void GetStats(DatabaseStats &stats) const;
+
+	/**
+	 * Determines the number of songs with the specified tag
+	 * value, and their total duration.
+	 */
+	void GetTagCount(enum tag_type type, const char *value,
+			 unsigned &songs_r, unsigned long &duration_r) const;
+
+private:
+	void Apply(const song &song, bool add);
+	static void Apply(Count &count, unsigned long duration, bool add);
+};
+
+#endif
@@ -132,3 +132,26 @@ GetStats(const Database &db, const DatabaseSelection &selection,
 	stats.album_count = albums.size();
 	return true;
 }
+
+static bool
+CountVisitSong(unsigned &songs, unsigned long &duration, song &song)
+{
+	++songs;
+	duration += song_get_duration(&song);
+
+	return true;
+}
+
+bool
+CountSongs(const Database &db, const DatabaseSelection &selection,
+	   unsigned &songs_r, unsigned long &duration_r,
+	   GError **error_r)
+{
+	songs_r = 0;
+	duration_r = 0;
+
+	using namespace std::placeholders;
+	const auto f = std::bind(CountVisitSong,
+				 std::ref(songs_r), std::ref(duration_r), _1);
+	return db.Visit(selection, f, error_r);
+}
@@ -38,4 +38,9 @@ bool
 GetStats(const Database &db, const DatabaseSelection &selection,
 	 DatabaseStats &stats, GError **error_r);
 
+bool
+CountSongs(const Database &db, const DatabaseSelection &selection,
+	   unsigned &songs_r, unsigned long &duration_r,
+	   GError **error_r);
+
 #endif
@@ -133,6 +133,15 @@ public:
 	virtual bool GetStats(const DatabaseSelection &selection,
 			      DatabaseStats &stats,
 			      GError **error_r) const = 0;
+
+	/**
+	 * Count the selected songs and their total duration (in
+	 * seconds).
+	 */
+	virtual bool CountSongs(const DatabaseSelection &selection,
+				unsigned &songs_r,
+				unsigned long &duration_r,
+				GError **error_r) const = 0;
 };
 
 struct DatabasePlugin {
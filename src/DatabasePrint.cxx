@@ -130,26 +130,6 @@ db_selection_print(Client *client, const DatabaseSelection &selection,
 	return db->Visit(selection, d, s, p, error_r);
 }
 
-struct SearchStats {
-	int numberOfSongs;
-	unsigned long playTime;
-};
-
-static void printSearchStats(Client *client, SearchStats *stats)
-{
-	client_printf(client, "songs: %i\n", stats->numberOfSongs);
-	client_printf(client, "playtime: %li\n", stats->playTime);
-}
-
-static bool
-stats_visitor_song(SearchStats &stats, song &song)
-{
-	stats.numberOfSongs++;
-	stats.playTime += song_get_duration(&song);
-
-	return true;
-}
-
 bool
 searchStatsForSongsIn(Client *client, const char *name,
 		      const SongFilter *filter,
@@ -161,17 +141,13 @@ searchStatsForSongsIn(Client *client, const char *name,
 
 	const DatabaseSelection selection(name, true, filter);
 
-	SearchStats stats;
-	stats.numberOfSongs = 0;
-	stats.playTime = 0;
-
-	using namespace std::placeholders;
-	const auto f = std::bind(stats_visitor_song, std::ref(stats),
-				 _1);
-	if (!db->Visit(selection, f, error_r))
+	unsigned songs;
+	unsigned long duration;
+	if (!db->CountSongs(selection, songs, duration, error_r))
 		return false;
 
-	printSearchStats(client, &stats);
+	client_printf(client, "songs: %u\n", songs);
+	client_printf(client, "playtime: %lu\n", duration);
 	return true;
 }
 
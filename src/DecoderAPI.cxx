@@ -28,6 +28,7 @@
 #include "DecoderInternal.hxx"
 #include "song.h"
 #include "InputStream.hxx"
+#include "PipelineStats.hxx"
 
 #include <glib.h>
 
@@ -185,6 +186,7 @@ decoder_command_finished(struct decoder *decoder)
 		music_pipe_clear(dc->pipe, dc->buffer);
 
 		decoder->timestamp = dc->seek_where;
+		decoder->data_time = 0;
 	}
 
 	dc->command = DECODE_COMMAND_NONE;
@@ -360,12 +362,32 @@ update_stream_tag(struct decoder *decoder, struct input_stream *is)
 	return true;
 }
 
+/**
+ * Measures the time the decoder plugin spent since the previous
+ * decoder_data() call, and remembers when this call returns.
+ */
+class DecodeTimer {
+	struct decoder &decoder;
+
+public:
+	explicit DecodeTimer(struct decoder &_decoder):decoder(_decoder) {
+		if (decoder.data_time != 0)
+			pipeline_stats.decode_time.AddSince(decoder.data_time);
+	}
+
+	~DecodeTimer() {
+		decoder.data_time = g_get_monotonic_time();
+	}
+};
+
 enum decoder_command
 decoder_data(struct decoder *decoder,
 	     struct input_stream *is,
 	     const void *data, size_t length,
 	     uint16_t kbit_rate)
 {
+	const DecodeTimer timer(*decoder);
+
 	struct decoder_control *dc = decoder->dc;
 	GError *error = NULL;
 	enum decoder_command cmd;
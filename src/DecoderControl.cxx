@@ -29,6 +29,7 @@
 
 decoder_control::decoder_control()
 	:thread(nullptr),
+	 prefetch(mutex, cond),
 	 state(DECODE_STATE_STOP),
 	 command(DECODE_COMMAND_NONE),
 	 song(nullptr),
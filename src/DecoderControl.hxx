@@ -22,6 +22,7 @@
 
 #include "decoder_command.h"
 #include "audio_format.h"
+#include "InputPrefetch.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 
@@ -66,6 +67,13 @@ struct decoder_control {
 	 */
 	Cond client_cond;
 
+	/**
+	 * Input streams of songs which will be decoded soon.  They
+	 * are opened by the player thread, and adopted by the
+	 * decoder thread.
+	 */
+	InputPrefetch prefetch;
+
 	enum decoder_state state;
 	enum decoder_command command;
 
@@ -24,6 +24,8 @@
 #include "pcm/PcmConvert.hxx"
 #include "replay_gain_info.h"
 
+#include <glib.h>
+
 struct input_stream;
 
 struct decoder {
@@ -81,6 +83,14 @@ struct decoder {
 	 */
 	unsigned replay_gain_serial;
 
+	/**
+	 * The g_get_monotonic_time() value when decoder_data()
+	 * returned the last time, or 0 if there is no such
+	 * measurement (e.g. after seeking).  The difference to the
+	 * next call is the time spent in the decoder plugin.
+	 */
+	gint64 data_time;
+
 	decoder(decoder_control *_dc, bool _initial_seek_pending,
 		struct tag *_tag)
 		:dc(_dc),
@@ -90,7 +100,7 @@ struct decoder {
 		 seeking(false),
 		 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
 		 chunk(nullptr),
-		 replay_gain_serial(0) {
+		 replay_gain_serial(0), data_time(0) {
 	}
 
 	~decoder();
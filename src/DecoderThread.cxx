@@ -32,6 +32,7 @@
 #include "InputStream.hxx"
 #include "DecoderList.hxx"
 #include "util/UriUtil.hxx"
+#include "ThreadScheduling.hxx"
 
 extern "C" {
 #include "replay_gain_ape.h"
@@ -78,7 +79,31 @@ decoder_input_stream_open(struct decoder_control *dc, const char *uri)
 	GError *error = NULL;
 	struct input_stream *is;
 
-	is = input_stream_open(uri, dc->mutex, dc->cond, &error);
+	is = dc->prefetch.Take(uri);
+	if (is != NULL) {
+		/* the prefetch thread has opened this stream already;
+		   if it has failed meanwhile, try again with a new
+		   one */
+		dc->Lock();
+		input_stream_update(is);
+		const bool success = input_stream_check(is, &error);
+		dc->Unlock();
+
+		if (success)
+			g_debug("using prefetched stream %s", uri);
+		else {
+			g_debug("prefetched stream failed: %s",
+				error->message);
+			g_error_free(error);
+			error = NULL;
+
+			input_stream_close(is);
+			is = NULL;
+		}
+	}
+
+	if (is == NULL)
+		is = input_stream_open(uri, dc->mutex, dc->cond, &error);
 	if (is == NULL) {
 		if (error != NULL) {
 			g_warning("%s", error->message);
@@ -456,6 +481,8 @@ decoder_task(gpointer arg)
 {
 	struct decoder_control *dc = (struct decoder_control *)arg;
 
+	thread_scheduling_apply(THREAD_CLASS_DECODER);
+
 	dc->Lock();
 
 	do {
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Directory.hxx"
+#include "DatabaseCounters.hxx"
 #include "SongFilter.hxx"
 #include "PlaylistVector.hxx"
 #include "DatabaseLock.hxx"
@@ -50,7 +51,24 @@ Directory::Allocate(const char *path)
 	return directory;
 }
 
+size_t
+Directory::NameHash::operator()(const char *name) const
+{
+	/* FNV-1a */
+	size_t hash = 2166136261u;
+	for (; *name != 0; ++name)
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	return hash;
+}
+
+bool
+Directory::NameEqual::operator()(const char *a, const char *b) const
+{
+	return strcmp(a, b) == 0;
+}
+
 Directory::Directory()
+	:counters(nullptr)
 {
 	INIT_LIST_HEAD(&children);
 	INIT_LIST_HEAD(&songs);
@@ -59,6 +77,7 @@ Directory::Directory()
 }
 
 Directory::Directory(const char *_path)
+	:counters(nullptr)
 {
 	INIT_LIST_HEAD(&children);
 	INIT_LIST_HEAD(&songs);
@@ -75,6 +94,8 @@ Directory::~Directory()
 	Directory *child, *n;
 	directory_for_each_child_safe(child, n, this)
 		child->Free();
+
+	delete counters;
 }
 
 Directory *
@@ -97,12 +118,30 @@ Directory::Free()
 	g_free(this);
 }
 
+DatabaseCounters *
+Directory::GetCounters() const
+{
+	const Directory *root = this;
+	while (root->parent != nullptr)
+		root = root->parent;
+
+	return root->counters;
+}
+
 void
 Directory::Delete()
 {
 	assert(holding_db_lock());
 	assert(parent != nullptr);
 
+	DatabaseCounters *c = GetCounters();
+	if (c != nullptr)
+		c->RemoveDirectory(*this);
+
+	auto i = parent->child_map.find(GetName());
+	if (i != parent->child_map.end() && i->second == this)
+		parent->child_map.erase(i);
+
 	list_del(&siblings);
 	Free();
 }
@@ -143,6 +182,7 @@ Directory::CreateChild(const char *name_utf8)
 	g_free(allocated);
 
 	list_add_tail(&child->siblings, &children);
+	child_map[child->GetName()] = child;
 	return child;
 }
 
@@ -151,12 +191,10 @@ Directory::FindChild(const char *name) const
 {
 	assert(holding_db_lock());
 
-	const Directory *child;
-	directory_for_each_child(child, this)
-		if (strcmp(child->GetName(), name) == 0)
-			return child;
-
-	return NULL;
+	auto i = child_map.find(name);
+	return i != child_map.end()
+		? i->second
+		: NULL;
 }
 
 void
@@ -215,6 +253,11 @@ Directory::AddSong(struct song *song)
 	assert(song->parent == this);
 
 	list_add_tail(&song->siblings, &songs);
+	song_map[song->uri] = song;
+
+	DatabaseCounters *c = GetCounters();
+	if (c != nullptr)
+		c->Add(*song);
 }
 
 void
@@ -224,7 +267,15 @@ Directory::RemoveSong(struct song *song)
 	assert(song != NULL);
 	assert(song->parent == this);
 
+	auto i = song_map.find(song->uri);
+	if (i != song_map.end() && i->second == song)
+		song_map.erase(i);
+
 	list_del(&song->siblings);
+
+	DatabaseCounters *c = GetCounters();
+	if (c != nullptr)
+		c->Remove(*song);
 }
 
 const song *
@@ -233,15 +284,12 @@ Directory::FindSong(const char *name_utf8) const
 	assert(holding_db_lock());
 	assert(name_utf8 != NULL);
 
-	struct song *song;
-	directory_for_each_song(song, this) {
-		assert(song->parent == this);
-
-		if (strcmp(song->uri, name_utf8) == 0)
-			return song;
-	}
+	auto i = song_map.find(name_utf8);
+	if (i == song_map.end())
+		return NULL;
 
-	return NULL;
+	assert(i->second->parent == this);
+	return i->second;
 }
 
 struct song *
@@ -27,6 +27,8 @@
 #include "PlaylistVector.hxx"
 #include "gerror.h"
 
+#include <unordered_map>
+
 #include <stdbool.h>
 #include <sys/types.h>
 
@@ -48,8 +50,36 @@
 struct song;
 struct db_visitor;
 class SongFilter;
+class DatabaseCounters;
 
 struct Directory {
+	/**
+	 * Hash function for the name indexes.
+	 */
+	struct NameHash {
+		gcc_pure
+		size_t operator()(const char *name) const;
+	};
+
+	struct NameEqual {
+		gcc_pure
+		bool operator()(const char *a, const char *b) const;
+	};
+
+	/**
+	 * Maps the base name of each child directory (pointing into
+	 * the child's #path) to the object.
+	 */
+	typedef std::unordered_map<const char *, Directory *,
+				   NameHash, NameEqual> ChildMap;
+
+	/**
+	 * Maps the name of each song (its #uri attribute) to the
+	 * object.
+	 */
+	typedef std::unordered_map<const char *, song *,
+				   NameHash, NameEqual> SongMap;
+
 	/**
 	 * Pointers to the siblings of this directory within the
 	 * parent directory.  It is unused (undefined) in the root
@@ -76,8 +106,33 @@ struct Directory {
 	 */
 	struct list_head songs;
 
+	/**
+	 * An index of #children, for quick lookup by name.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Read access in the update thread does not need protection.
+	 */
+	ChildMap child_map;
+
+	/**
+	 * An index of #songs, for quick lookup by name.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Read access in the update thread does not need protection.
+	 */
+	SongMap song_map;
+
 	PlaylistVector playlists;
 
+	/**
+	 * Statistics about all songs in this tree.  Only the root
+	 * directory may have this object, and it's optional; it is
+	 * owned by this object.  Use GetCounters() to find it.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	DatabaseCounters *counters;
+
 	Directory *parent;
 	time_t mtime;
 	ino_t inode;
@@ -118,6 +173,13 @@ public:
 	 */
 	void Free();
 
+	/**
+	 * Returns the #DatabaseCounters object of the root directory
+	 * of this tree, or nullptr if there is none.
+	 */
+	gcc_pure
+	DatabaseCounters *GetCounters() const;
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
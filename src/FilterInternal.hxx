@@ -25,6 +25,10 @@
 #ifndef MPD_FILTER_INTERNAL_HXX
 #define MPD_FILTER_INTERNAL_HXX
 
+#include "gcc.h"
+
+#include <assert.h>
+
 struct audio_format;
 
 class Filter {
@@ -66,6 +70,46 @@ public:
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r,
 				      GError **error_r) = 0;
+
+	/**
+	 * Does this filter implement FilterInPlace()?  Only filters
+	 * which neither change the audio format nor the size of the
+	 * data may do that.
+	 */
+	virtual bool IsInPlace() const {
+		return false;
+	}
+
+	/**
+	 * Filters a block of PCM data, overwriting the input buffer.
+	 * This saves a copy when the caller owns a writable buffer
+	 * anyway (see #ChainFilter).  Must only be called if
+	 * IsInPlace() returns true.
+	 *
+	 * @param buffer the buffer to be modified
+	 * @param size the size of #buffer in bytes
+	 * @param error location to store the error occurring, or NULL
+	 * to ignore errors.
+	 * @return true on success
+	 */
+	virtual bool FilterInPlace(gcc_unused void *buffer,
+				   gcc_unused size_t size,
+				   gcc_unused GError **error_r) {
+		assert(false);
+		return false;
+	}
+
+	/**
+	 * If this filter does nothing but scaling the samples by a
+	 * constant factor, returns that factor (#PCM_VOLUME_1 means
+	 * 100%).  This allows #ChainFilter to merge adjacent gain
+	 * stages into one pcm_volume() call.
+	 *
+	 * @return true if this is a gain filter, false otherwise
+	 */
+	virtual bool GetGain(gcc_unused unsigned &volume_r) const {
+		return false;
+	}
 };
 
 #endif
@@ -22,6 +22,10 @@
 #include "UpdateGlue.hxx"
 #include "event/Loop.hxx"
 
+extern "C" {
+#include "clock.h"
+}
+
 #include <glib.h>
 
 #include <string.h>
@@ -31,32 +35,51 @@
 
 enum {
 	/**
-	 * Wait this long after the last change before calling
-	 * update_enqueue().  This increases the probability that
-	 * updates can be bundled.
+	 * Wait until there was no change for this long [ms] before
+	 * calling update_enqueue_batch().  This increases the probability
+	 * that updates can be bundled.
+	 */
+	INOTIFY_QUIET_MS = 500,
+
+	/**
+	 * Don't let a steady stream of changes postpone the update
+	 * for longer than this [ms].
+	 */
+	INOTIFY_MAX_DELAY_MS = 10000,
+
+	/**
+	 * If update_enqueue_batch() fails because the update queue is
+	 * full, retry after this duration [s].
+	 */
+	INOTIFY_RETRY_DELAY_S = 5,
+
+	/**
+	 * When this many files of the same directory are queued,
+	 * they are replaced by the directory.  All files end up in
+	 * one update job, so this is only a bound for the size of
+	 * that job; a directory scan visits every file in it.
 	 */
-	INOTIFY_UPDATE_DELAY_S = 5,
+	INOTIFY_MAX_FILES_PER_DIRECTORY = 64,
 };
 
 void
 InotifyQueue::OnTimeout()
 {
-	unsigned id;
-
-	while (!queue.empty()) {
-		const char *uri_utf8 = queue.front().c_str();
-
-		id = update_enqueue(uri_utf8, false);
-		if (id == 0) {
-			/* retry later */
-			ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
-			return;
-		}
+	if (queue.empty())
+		return;
+
+	/* submit all queued paths as one update job, which saves the
+	   database only once */
+	const unsigned id = update_enqueue_batch(queue);
+	if (id == 0) {
+		/* retry later */
+		ScheduleSeconds(INOTIFY_RETRY_DELAY_S);
+		return;
+	}
 
-		g_debug("updating '%s' job=%u", uri_utf8, id);
+	g_debug("updating %u paths job=%u", (unsigned)queue.size(), id);
 
-		queue.pop_front();
-	}
+	queue.clear();
 }
 
 static bool
@@ -64,15 +87,46 @@ path_in(const char *path, const char *possible_parent)
 {
 	size_t length = strlen(possible_parent);
 
-	return path[0] == 0 ||
+	return length == 0 ||
 		(memcmp(possible_parent, path, length) == 0 &&
 		 (path[length] == 0 || path[length] == '/'));
 }
 
+/**
+ * Is the specified path a direct child of the directory?
+ */
+static bool
+path_is_child(const char *path, const char *directory)
+{
+	size_t length = strlen(directory);
+	if (length > 0) {
+		if (memcmp(directory, path, length) != 0 ||
+		    path[length] != '/')
+			return false;
+
+		path += length + 1;
+	}
+
+	return *path != 0 && strchr(path, '/') == NULL;
+}
+
 void
 InotifyQueue::Enqueue(const char *uri_utf8)
 {
-	ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
+	const unsigned now = monotonic_clock_ms();
+	if (queue.empty())
+		first_time = now;
+
+	/* wait for the next quiet period, but not beyond the
+	   deadline of the oldest item */
+	const unsigned elapsed = now - first_time;
+	unsigned delay = INOTIFY_QUIET_MS;
+	if (elapsed + delay > INOTIFY_MAX_DELAY_MS)
+		delay = elapsed < INOTIFY_MAX_DELAY_MS
+			? INOTIFY_MAX_DELAY_MS - elapsed
+			: 0;
+
+	Schedule(delay);
 
 	for (auto i = queue.begin(), end = queue.end(); i != end;) {
 		const char *current_uri = i->c_str();
@@ -90,5 +144,23 @@ InotifyQueue::Enqueue(const char *uri_utf8)
 			++i;
 	}
 
+	/* many files of one directory: update the directory
+	   instead */
+	const char *slash = strrchr(uri_utf8, '/');
+	const std::string parent(uri_utf8,
+				 slash != nullptr ? slash - uri_utf8 : 0);
+
+	unsigned siblings = 0;
+	for (const auto &i : queue)
+		if (path_is_child(i.c_str(), parent.c_str()))
+			++siblings;
+
+	if (siblings + 1 >= INOTIFY_MAX_FILES_PER_DIRECTORY) {
+		g_debug("coalescing %u updates in '%s'",
+			siblings + 1, parent.c_str());
+		Enqueue(parent.c_str());
+		return;
+	}
+
 	queue.emplace_back(uri_utf8);
 }
@@ -26,12 +26,28 @@
 #include <list>
 #include <string>
 
+/**
+ * Collects the URIs reported by inotify, and passes them as one
+ * job to update_enqueue_batch() after the file system has been quiet
+ * for a moment.  The URIs may refer to single files, so only those
+ * get re-read.
+ */
 class InotifyQueue final : private TimeoutMonitor {
 	std::list<std::string> queue;
 
+	/**
+	 * The monotonic time stamp [ms] when the oldest item in
+	 * #queue was added.
+	 */
+	unsigned first_time;
+
 public:
 	InotifyQueue(EventLoop &_loop):TimeoutMonitor(_loop) {}
 
+	/**
+	 * @param uri_utf8 the URI of the file or directory which was
+	 * modified; "" means the whole music directory
+	 */
 	void Enqueue(const char *uri_utf8);
 
 private:
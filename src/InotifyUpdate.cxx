@@ -24,11 +24,13 @@
 #include "Mapper.hxx"
 #include "Main.hxx"
 #include "fs/Path.hxx"
+#include "event/TimeoutMonitor.hxx"
 
 #include <glib.h>
 
-#include <map>
+#include <unordered_map>
 #include <forward_list>
+#include <deque>
 
 #include <assert.h>
 #include <sys/inotify.h>
@@ -48,6 +50,16 @@ enum {
 #endif
 };
 
+enum {
+	/**
+	 * The number of directories scanned for sub directories in one
+	 * main loop iteration.  Registering the watches is spread over
+	 * many iterations, so MPD stays responsive while a large
+	 * music directory is being registered.
+	 */
+	INOTIFY_SCAN_CHUNK = 32,
+};
+
 struct WatchDirectory {
 	WatchDirectory *parent;
 
@@ -70,12 +82,48 @@ struct WatchDirectory {
 	}
 };
 
+/**
+ * Registers inotify watches on sub directories, a few at a time.
+ */
+class InotifyScanner final : private TimeoutMonitor {
+	/**
+	 * Watch descriptors of the directories which need to be
+	 * scanned.  Descriptors (instead of pointers) are used
+	 * because a directory may disappear before it gets scanned.
+	 */
+	std::deque<int> queue;
+
+public:
+	InotifyScanner(EventLoop &_loop):TimeoutMonitor(_loop) {}
+
+	void Enqueue(const WatchDirectory &directory) {
+		queue.push_back(directory.descriptor);
+		if (!IsActive())
+			Schedule(0);
+	}
+
+	void Clear() {
+		queue.clear();
+		Cancel();
+	}
+
+private:
+	virtual void OnTimeout() override;
+};
+
 static InotifySource *inotify_source;
 static InotifyQueue *inotify_queue;
+static InotifyScanner *inotify_scanner;
 
 static unsigned inotify_max_depth;
 static WatchDirectory *inotify_root;
-static std::map<int, WatchDirectory *> inotify_directories;
+static std::unordered_map<int, WatchDirectory *> inotify_directories;
+
+/**
+ * Set when the kernel refused a watch because the limit
+ * ("fs.inotify.max_user_watches") was reached.
+ */
+static bool inotify_limit_reached;
 
 static void
 tree_add_watch_directory(WatchDirectory *directory)
@@ -158,59 +206,114 @@ static bool skip_path(const char *path)
 		strchr(path, '\n') != NULL;
 }
 
+G_GNUC_PURE
+static unsigned
+watch_directory_depth(const WatchDirectory *d)
+{
+	assert(d != NULL);
+
+	unsigned depth = 0;
+	while ((d = d->parent) != NULL)
+		++depth;
+
+	return depth;
+}
+
+/**
+ * Is this directory entry a directory?  Uses the type from readdir()
+ * if the file system provides it, which saves a stat() call for each
+ * file.
+ */
+static bool
+is_directory_entry(const struct dirent *ent, const char *path_fs)
+{
+#ifdef _DIRENT_HAVE_D_TYPE
+	if (ent->d_type == DT_DIR)
+		return true;
+
+	if (ent->d_type != DT_UNKNOWN && ent->d_type != DT_LNK)
+		return false;
+#else
+	(void)ent;
+#endif
+
+	struct stat st;
+	if (stat(path_fs, &st) < 0) {
+		g_warning("Failed to stat %s: %s",
+			  path_fs, g_strerror(errno));
+		return false;
+	}
+
+	return S_ISDIR(st.st_mode);
+}
+
+/**
+ * Registers watches for all sub directories of the specified
+ * directory, and schedules scanning them.
+ */
 static void
-recursive_watch_subdirectories(WatchDirectory *directory,
-			       const char *path_fs, unsigned depth)
+watch_subdirectories(WatchDirectory *directory)
 {
 	GError *error = NULL;
 	DIR *dir;
 	struct dirent *ent;
 
 	assert(directory != NULL);
-	assert(depth <= inotify_max_depth);
-	assert(path_fs != NULL);
-
-	++depth;
 
+	const unsigned depth = watch_directory_depth(directory) + 1;
 	if (depth > inotify_max_depth)
 		return;
 
+	const char *root = mapper_get_music_directory_fs().c_str();
+	char *uri_fs = watch_directory_get_uri_fs(directory);
+	char *path_fs = uri_fs != NULL
+		? g_strconcat(root, "/", uri_fs, NULL)
+		: g_strdup(root);
+	g_free(uri_fs);
+
 	dir = opendir(path_fs);
 	if (dir == NULL) {
 		g_warning("Failed to open directory %s: %s",
 			  path_fs, g_strerror(errno));
+		g_free(path_fs);
 		return;
 	}
 
 	while ((ent = readdir(dir))) {
 		char *child_path_fs;
-		struct stat st;
 		int ret;
 
 		if (skip_path(ent->d_name))
 			continue;
 
 		child_path_fs = g_strconcat(path_fs, "/", ent->d_name, NULL);
-		ret = stat(child_path_fs, &st);
-		if (ret < 0) {
-			g_warning("Failed to stat %s: %s",
-				  child_path_fs, g_strerror(errno));
-			g_free(child_path_fs);
-			continue;
-		}
-
-		if (!S_ISDIR(st.st_mode)) {
+		if (!is_directory_entry(ent, child_path_fs)) {
 			g_free(child_path_fs);
 			continue;
 		}
 
 		ret = inotify_source->Add(child_path_fs, IN_MASK, &error);
 		if (ret < 0) {
-			g_warning("Failed to register %s: %s",
-				  child_path_fs, error->message);
+			const bool limit = error->code == ENOSPC;
+			if (!limit)
+				g_warning("Failed to register %s: %s",
+					  child_path_fs, error->message);
+			else if (!inotify_limit_reached)
+				g_warning("Failed to register %s: "
+					  "the inotify watch limit was reached; "
+					  "increase the sysctl "
+					  "fs.inotify.max_user_watches",
+					  child_path_fs);
 			g_error_free(error);
 			error = NULL;
 			g_free(child_path_fs);
+
+			if (limit) {
+				inotify_limit_reached = true;
+				inotify_scanner->Clear();
+				break;
+			}
+
 			continue;
 		}
 
@@ -226,29 +329,37 @@ recursive_watch_subdirectories(WatchDirectory *directory,
 
 		tree_add_watch_directory(child);
 
-		recursive_watch_subdirectories(child, child_path_fs, depth);
+		inotify_scanner->Enqueue(*child);
 		g_free(child_path_fs);
 	}
 
 	closedir(dir);
+	g_free(path_fs);
 }
 
-G_GNUC_PURE
-static unsigned
-watch_directory_depth(const WatchDirectory *d)
+void
+InotifyScanner::OnTimeout()
 {
-	assert(d != NULL);
-
-	unsigned depth = 0;
-	while ((d = d->parent) != NULL)
-		++depth;
+	for (unsigned n = 0; n < INOTIFY_SCAN_CHUNK && !queue.empty(); ++n) {
+		WatchDirectory *directory =
+			tree_find_watch_directory(queue.front());
+		queue.pop_front();
+
+		if (directory != NULL)
+			/* else: was removed meanwhile */
+			watch_subdirectories(directory);
+	}
 
-	return depth;
+	if (!queue.empty())
+		Schedule(0);
+	else
+		g_debug("watching %u directories",
+			(unsigned)inotify_directories.size());
 }
 
 static void
 mpd_inotify_callback(int wd, unsigned mask,
-		     G_GNUC_UNUSED const char *name, G_GNUC_UNUSED void *ctx)
+		     const char *name, G_GNUC_UNUSED void *ctx)
 {
 	WatchDirectory *directory;
 	char *uri_fs;
@@ -271,19 +382,7 @@ mpd_inotify_callback(int wd, unsigned mask,
 	    (mask & IN_ISDIR) != 0) {
 		/* a sub directory was changed: register those in
 		   inotify */
-		const char *root = mapper_get_music_directory_fs().c_str();
-		const char *path_fs;
-		char *allocated = NULL;
-
-		if (uri_fs != NULL)
-			path_fs = allocated =
-				g_strconcat(root, "/", uri_fs, NULL);
-		else
-			path_fs = root;
-
-		recursive_watch_subdirectories(directory, path_fs,
-					       watch_directory_depth(directory));
-		g_free(allocated);
+		inotify_scanner->Enqueue(*directory);
 	}
 
 	if ((mask & (IN_CLOSE_WRITE|IN_MOVE|IN_DELETE)) != 0 ||
@@ -292,15 +391,29 @@ mpd_inotify_callback(int wd, unsigned mask,
 	    (watch_directory_depth(directory) == inotify_max_depth &&
 	     (mask & (IN_CREATE|IN_ISDIR)) == (IN_CREATE|IN_ISDIR))) {
 		/* a file was changed, or a directory was
-		   moved/deleted: queue a database update */
-
-		if (uri_fs != nullptr) {
-			const std::string uri_utf8 = Path::ToUTF8(uri_fs);
+		   moved/deleted: queue a database update of just
+		   that item (or of the whole directory if inotify
+		   didn't tell us its name) */
+
+		char *child_fs = nullptr;
+		if (name != nullptr && !skip_path(name))
+			child_fs = uri_fs != nullptr
+				? g_strconcat(uri_fs, "/", name, NULL)
+				: g_strdup(name);
+
+		const char *update_fs = child_fs != nullptr
+			? child_fs
+			: uri_fs;
+
+		if (update_fs != nullptr) {
+			const std::string uri_utf8 = Path::ToUTF8(update_fs);
 			if (!uri_utf8.empty())
 				inotify_queue->Enqueue(uri_utf8.c_str());
 		}
 		else
 			inotify_queue->Enqueue("");
+
+		g_free(child_fs);
 	}
 
 	g_free(uri_fs);
@@ -343,7 +456,11 @@ mpd_inotify_init(unsigned max_depth)
 
 	tree_add_watch_directory(inotify_root);
 
-	recursive_watch_subdirectories(inotify_root, path.c_str(), 0);
+	/* the sub directories are registered from the main loop,
+	   which allows MPD to start serving clients before this is
+	   finished */
+	inotify_scanner = new InotifyScanner(*main_loop);
+	inotify_scanner->Enqueue(*inotify_root);
 
 	inotify_queue = new InotifyQueue(*main_loop);
 
@@ -357,6 +474,7 @@ mpd_inotify_finish(void)
 		return;
 
 	delete inotify_queue;
+	delete inotify_scanner;
 	delete inotify_source;
 	delete inotify_root;
 	inotify_directories.clear();
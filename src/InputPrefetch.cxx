@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "InputPrefetch.hxx"
+#include "InputStream.hxx"
+#include "ThreadScheduling.hxx"
+
+#include <glib.h>
+
+#include <assert.h>
+
+#include <algorithm>
+#include <iterator>
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "input_prefetch"
+
+InputPrefetch::~InputPrefetch()
+{
+	if (thread != nullptr) {
+		mutex.lock();
+		quit = true;
+		cond.broadcast();
+		mutex.unlock();
+
+		g_thread_join(thread);
+	}
+
+	for (const auto &item : items)
+		input_stream_close(item.is);
+}
+
+gpointer
+InputPrefetch::ThreadFunc(gpointer ctx)
+{
+	InputPrefetch &prefetch = *(InputPrefetch *)ctx;
+
+	thread_scheduling_apply(THREAD_CLASS_DECODER);
+
+	prefetch.Run();
+	return nullptr;
+}
+
+inline bool
+InputPrefetch::StartThread()
+{
+	assert(thread == nullptr);
+
+#if GLIB_CHECK_VERSION(2,32,0)
+	thread = g_thread_new("prefetch", ThreadFunc, this);
+#else
+	GError *error = nullptr;
+	thread = g_thread_create(ThreadFunc, this, true, &error);
+	if (thread == nullptr) {
+		g_warning("Failed to spawn prefetch thread: %s",
+			  error->message);
+		g_error_free(error);
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+inline void
+InputPrefetch::Run()
+{
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (!dirty) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		dirty = false;
+
+		std::list<Item> obsolete;
+		for (auto i = items.begin(), end = items.end(); i != end;) {
+			auto next = std::next(i);
+			if (std::find(uris.begin(), uris.end(),
+				      i->uri) == uris.end())
+				obsolete.splice(obsolete.end(), items, i);
+			i = next;
+		}
+
+		/* open at most one stream per iteration, so changes
+		   to the list are picked up quickly */
+		for (const auto &uri : uris) {
+			if (std::find_if(items.begin(), items.end(),
+					 [&uri](const Item &item) {
+						 return item.uri == uri;
+					 }) == items.end()) {
+				opening = uri;
+				break;
+			}
+		}
+
+		mutex.unlock();
+
+		for (const auto &item : obsolete) {
+			g_debug("closing %s", item.uri.c_str());
+			input_stream_close(item.is);
+		}
+
+		struct input_stream *is = nullptr;
+		if (!opening.empty()) {
+			g_debug("opening %s", opening.c_str());
+
+			GError *error = nullptr;
+			is = input_stream_open(opening.c_str(),
+					       stream_mutex, stream_cond,
+					       &error);
+			if (is == nullptr && error != nullptr) {
+				g_warning("%s", error->message);
+				g_error_free(error);
+			}
+		}
+
+		mutex.lock();
+
+		if (!opening.empty()) {
+			if (is != nullptr)
+				/* if the list has been modified
+				   meanwhile, the next iteration
+				   closes this stream again */
+				items.push_back(Item(opening, is));
+			else
+				/* don't retry this URI until the
+				   list changes again */
+				uris.remove(opening);
+
+			opening.clear();
+			cond.broadcast();
+
+			/* look for more missing URIs */
+			dirty = true;
+		}
+	}
+}
+
+void
+InputPrefetch::Update(std::list<std::string> &&_uris)
+{
+	const ScopeLock protect(mutex);
+
+	if (thread == nullptr && (_uris.empty() || !StartThread()))
+		return;
+
+	uris = std::move(_uris);
+	dirty = true;
+	cond.broadcast();
+}
+
+void
+InputPrefetch::Clear()
+{
+	mutex.lock();
+	uris.clear();
+	std::list<Item> obsolete;
+	obsolete.swap(items);
+	mutex.unlock();
+
+	for (const auto &item : obsolete)
+		input_stream_close(item.is);
+}
+
+struct input_stream *
+InputPrefetch::Take(const char *uri)
+{
+	const ScopeLock protect(mutex);
+
+	while (opening == uri)
+		cond.wait(mutex);
+
+	/* don't open it again */
+	auto u = std::find(uris.begin(), uris.end(), uri);
+	if (u != uris.end())
+		uris.erase(u);
+
+	for (auto i = items.begin(), end = items.end(); i != end; ++i) {
+		if (i->uri == uri) {
+			struct input_stream *is = i->is;
+			items.erase(i);
+			return is;
+		}
+	}
+
+	return nullptr;
+}
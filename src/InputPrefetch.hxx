@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_PREFETCH_HXX
+#define MPD_INPUT_PREFETCH_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "gcc.h"
+
+#include <glib.h>
+
+#include <list>
+#include <string>
+
+struct input_stream;
+
+/**
+ * Opens the input streams of songs which are going to be played
+ * soon, so the plugin (e.g. "curl") can connect to the server and
+ * fill its buffer while the current song is still playing.  When
+ * the decoder gets to such a song, it adopts the prefetched stream
+ * instead of opening a new one.
+ *
+ * Opening a stream may block for a long time (e.g. a file on a
+ * network file system, or a "mms" server), therefore it is done by a
+ * helper thread, which is started on demand.  The caller of Update()
+ * only submits the list of URIs and returns immediately.
+ *
+ * The streams are opened with the mutex and the cond of the
+ * #decoder_control, so the decoder thread can use them just like
+ * the streams it opens by itself.  Memory usage is bounded by the
+ * number of streams times the buffer size of the input plugin.
+ */
+class InputPrefetch {
+	/**
+	 * The mutex and the cond passed to input_stream_open().
+	 */
+	Mutex &stream_mutex;
+	Cond &stream_cond;
+
+	/**
+	 * Protects all of the following attributes.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Wakes up the helper thread, and signals the completion of
+	 * an open to Take().
+	 */
+	Cond cond;
+
+	struct Item {
+		std::string uri;
+
+		struct input_stream *is;
+
+		Item(const std::string &_uri, struct input_stream *_is)
+			:uri(_uri), is(_is) {}
+	};
+
+	GThread *thread;
+
+	bool quit;
+
+	/**
+	 * Has #uris been modified since the helper thread has looked
+	 * at it?
+	 */
+	bool dirty;
+
+	/**
+	 * The URIs which shall be prefetched.
+	 */
+	std::list<std::string> uris;
+
+	/**
+	 * The URI which is being opened by the helper thread right
+	 * now, or an empty string.
+	 */
+	std::string opening;
+
+	/**
+	 * The prefetched streams.
+	 */
+	std::list<Item> items;
+
+public:
+	InputPrefetch(Mutex &_mutex, Cond &_cond)
+		:stream_mutex(_mutex), stream_cond(_cond),
+		 thread(nullptr), quit(false), dirty(false) {}
+
+	~InputPrefetch();
+
+	InputPrefetch(const InputPrefetch &) = delete;
+	InputPrefetch &operator=(const InputPrefetch &) = delete;
+
+	/**
+	 * Submits a new list of URIs.  The helper thread opens
+	 * streams for all URIs which don't have one yet, and closes
+	 * the streams whose URI is not in the list anymore.  This
+	 * method does not block.
+	 *
+	 * The caller must not lock the stream mutex.
+	 */
+	void Update(std::list<std::string> &&uris);
+
+	/**
+	 * Closes all prefetched streams.
+	 *
+	 * The caller must not lock the stream mutex.
+	 */
+	void Clear();
+
+	/**
+	 * Removes the prefetched stream for the specified URI from
+	 * this object, and returns it.  The caller is responsible for
+	 * closing it.  If the helper thread is opening this URI right
+	 * now, this method waits for it to finish.
+	 *
+	 * The caller must not lock the stream mutex.
+	 *
+	 * @return the stream or nullptr if this URI was not
+	 * prefetched
+	 */
+	struct input_stream *Take(const char *uri);
+
+private:
+	bool StartThread();
+
+	void Run();
+
+	static gpointer ThreadFunc(gpointer ctx);
+};
+
+#endif
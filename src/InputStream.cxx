@@ -106,6 +106,14 @@ input_stream_lock_wait_ready(struct input_stream *is)
 	input_stream_wait_ready(is);
 }
 
+const char *
+input_stream_get_uri(const struct input_stream *is)
+{
+	assert(is != NULL);
+
+	return is->uri.c_str();
+}
+
 const char *
 input_stream_get_mime_type(const struct input_stream *is)
 {
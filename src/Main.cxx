@@ -53,6 +53,8 @@
 #include "ZeroconfGlue.hxx"
 #include "DecoderList.hxx"
 #include "AudioConfig.hxx"
+#include "PipelineStats.hxx"
+#include "ThreadScheduling.hxx"
 
 extern "C" {
 #include "daemon.h"
@@ -281,6 +283,35 @@ static void winsock_init(void)
 #endif
 }
 
+/**
+ * Parses a "buffer_before_play" style percentage and converts it to
+ * a number of chunks.
+ *
+ * @param default_chunks the return value if the option is not set
+ */
+static unsigned
+parse_buffer_percent(enum ConfigOption option, unsigned default_chunks,
+		     unsigned buffered_chunks)
+{
+	const struct config_param *param = config_get_param(option);
+	if (param == NULL)
+		return default_chunks;
+
+	char *test;
+	float perc = strtod(param->value, &test);
+	if (*test != '%' || perc < 0 || perc > 100) {
+		MPD_ERROR("buffered before play \"%s\" is not a positive "
+			  "percentage and less than 100 percent, line %i",
+			  param->value, param->line);
+	}
+
+	unsigned chunks = (perc / 100) * buffered_chunks;
+	if (chunks > buffered_chunks)
+		chunks = buffered_chunks;
+
+	return chunks;
+}
+
 /**
  * Initialize the decoder and player core, including the music pipe.
  */
@@ -290,9 +321,7 @@ initialize_decoder_and_player(void)
 	const struct config_param *param;
 	char *test;
 	size_t buffer_size;
-	float perc;
 	unsigned buffered_chunks;
-	unsigned buffered_before_play;
 
 	param = config_get_param(CONF_AUDIO_BUFFER_SIZE);
 	if (param != NULL) {
@@ -311,29 +340,51 @@ initialize_decoder_and_player(void)
 	if (buffered_chunks >= 1 << 15)
 		MPD_ERROR("buffer size \"%li\" is too big\n", (long)buffer_size);
 
-	param = config_get_param(CONF_BUFFER_BEFORE_PLAY);
-	if (param != NULL) {
-		perc = strtod(param->value, &test);
-		if (*test != '%' || perc < 0 || perc > 100) {
-			MPD_ERROR("buffered before play \"%s\" is not a positive "
-				  "percentage and less than 100 percent, line %i",
-				  param->value, param->line);
-		}
-	} else
-		perc = DEFAULT_BUFFER_BEFORE_PLAY;
-
-	buffered_before_play = (perc / 100) * buffered_chunks;
-	if (buffered_before_play > buffered_chunks)
-		buffered_before_play = buffered_chunks;
+	const unsigned buffered_before_play =
+		parse_buffer_percent(CONF_BUFFER_BEFORE_PLAY,
+				     (DEFAULT_BUFFER_BEFORE_PLAY / 100.0) *
+				     buffered_chunks,
+				     buffered_chunks);
+
+	/* without both adaptive bounds, they default to the fixed
+	   value, which disables adaptive buffering; if only one bound
+	   is configured, the other one is open (empty or full
+	   buffer) */
+	const bool have_min =
+		config_get_param(CONF_BUFFER_BEFORE_PLAY_MIN) != NULL;
+	const bool have_max =
+		config_get_param(CONF_BUFFER_BEFORE_PLAY_MAX) != NULL;
+	const unsigned buffered_before_play_min =
+		parse_buffer_percent(CONF_BUFFER_BEFORE_PLAY_MIN,
+				     have_max ? 0 : buffered_before_play,
+				     buffered_chunks);
+	const unsigned buffered_before_play_max =
+		parse_buffer_percent(CONF_BUFFER_BEFORE_PLAY_MAX,
+				     have_min
+				     ? buffered_chunks : buffered_before_play,
+				     buffered_chunks);
+	if (buffered_before_play_min > buffered_before_play_max)
+		MPD_ERROR("buffer_before_play_min is larger than "
+			  "buffer_before_play_max");
 
 	const unsigned max_length =
 		config_get_positive(CONF_MAX_PLAYLIST_LENGTH,
 				    DEFAULT_PLAYLIST_MAX_LENGTH);
 
+	const unsigned prefetch_songs =
+		config_get_unsigned(CONF_INPUT_PREFETCH, 0);
+
+	const bool lock_buffer =
+		config_get_bool(CONF_AUDIO_BUFFER_LOCK, false);
+
 	instance->partition = new Partition(*instance,
 					    max_length,
 					    buffered_chunks,
-					    buffered_before_play);
+					    buffered_before_play,
+					    buffered_before_play_min,
+					    buffered_before_play_max,
+					    prefetch_songs,
+					    lock_buffer);
 }
 
 /**
@@ -460,6 +511,12 @@ int mpd_main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (!thread_scheduling_global_init(&error)) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+
 	decoder_plugin_init_all();
 	update_global_init();
 
@@ -513,6 +570,8 @@ int mpd_main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	pipeline_stats_init(*main_loop);
+
 	audio_output_all_set_replay_gain_mode(replay_gain_get_real_mode(instance->partition->playlist.queue.random));
 
 	success = config_get_bool(CONF_AUTO_UPDATE, false);
@@ -553,11 +612,15 @@ int mpd_main(int argc, char *argv[])
 		delete state_file;
 	}
 
+	pipeline_stats_deinit();
+
 	instance->partition->pc.Kill();
 	ZeroconfDeinit();
 	listen_global_finish();
 	delete instance->client_list;
 
+	update_global_flush();
+
 	start = clock();
 	DatabaseGlobalDeinit();
 	g_debug("db_finish took %f seconds",
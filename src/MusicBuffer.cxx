@@ -24,7 +24,10 @@
 #include "util/SliceBuffer.hxx"
 #include "mpd_error.h"
 
+#include <glib.h>
+
 #include <assert.h>
+#include <errno.h>
 
 struct music_buffer : public SliceBuffer<music_chunk>  {
 	/** a mutex which protects #available */
@@ -43,6 +46,14 @@ music_buffer_new(unsigned num_chunks)
 	return new music_buffer(num_chunks);
 }
 
+void
+music_buffer_lock(struct music_buffer *buffer)
+{
+	if (!buffer->Lock())
+		g_warning("Failed to lock the audio buffer into memory: %s",
+			  g_strerror(errno));
+}
+
 void
 music_buffer_free(struct music_buffer *buffer)
 {
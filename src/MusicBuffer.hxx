@@ -34,6 +34,14 @@ struct music_buffer;
 struct music_buffer *
 music_buffer_new(unsigned num_chunks);
 
+/**
+ * Locks the #music_buffer into RAM, so playback doesn't stall when
+ * the kernel has paged it out.  Failures are logged, but are not
+ * fatal.
+ */
+void
+music_buffer_lock(struct music_buffer *buffer);
+
 /**
  * Frees the #music_buffer object
  */
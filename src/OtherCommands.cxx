@@ -44,6 +44,7 @@ extern "C" {
 #include "ClientFile.hxx"
 #include "ClientInternal.hxx"
 #include "Idle.hxx"
+#include "PipelineStats.hxx"
 
 #ifdef ENABLE_SQLITE
 #include "StickerDatabase.hxx"
@@ -237,6 +238,14 @@ handle_stats(Client *client,
 	return COMMAND_RETURN_OK;
 }
 
+enum command_return
+handle_pipelinestats(Client *client,
+		     G_GNUC_UNUSED int argc, G_GNUC_UNUSED char *argv[])
+{
+	pipeline_stats_print(client);
+	return COMMAND_RETURN_OK;
+}
+
 enum command_return
 handle_ping(G_GNUC_UNUSED Client *client,
 	    G_GNUC_UNUSED int argc, G_GNUC_UNUSED char *argv[])
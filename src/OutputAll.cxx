@@ -372,6 +372,14 @@ chunk_is_consumed_in(const struct audio_output *ao,
 
 /**
  * Has this chunk been consumed by all audio outputs?
+ *
+ * The outputs are checked without locking as long as the answer can
+ * be derived from the atomic #audio_output::chunk attribute: an
+ * output which has advanced past the specified chunk will never
+ * touch it again, and an output which is still playing it (and it's
+ * not the tail of the pipe) has obviously not consumed it.  Only the
+ * remaining cases (the output has not started yet or is closed, or
+ * it is at the tail of the pipe) need the output's mutex.
  */
 static bool
 chunk_is_consumed(const struct music_chunk *chunk)
@@ -379,6 +387,16 @@ chunk_is_consumed(const struct music_chunk *chunk)
 	for (unsigned i = 0; i < num_audio_outputs; ++i) {
 		struct audio_output *ao = audio_outputs[i];
 
+		const struct music_chunk *current =
+			ao->chunk.load(std::memory_order_acquire);
+		if (current != NULL && current != chunk)
+			/* the output has already moved on */
+			continue;
+
+		if (current == chunk && chunk->next != NULL)
+			/* the output is still playing this chunk */
+			return false;
+
 		const ScopeLock protect(ao->mutex);
 		if (!chunk_is_consumed_in(ao, chunk))
 			return false;
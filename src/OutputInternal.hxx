@@ -24,9 +24,12 @@
 #include "pcm/pcm_buffer.h"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "PipelineStats.hxx"
 
 #include <glib.h>
 
+#include <atomic>
+
 #include <time.h>
 
 class Filter;
@@ -233,13 +236,32 @@ struct audio_output {
 	 * chunks before this one may be returned to the
 	 * #music_buffer, because they are not going to be used by
 	 * this output anymore.
+	 *
+	 * This attribute is only modified while #mutex is locked,
+	 * but it is atomic, so the player thread may peek at it
+	 * without locking (see audio_output_all_check()).  The
+	 * output thread must read the "next" pointer of the old
+	 * chunk before it advances this attribute.
 	 */
-	const struct music_chunk *chunk;
+	std::atomic<const struct music_chunk *> chunk;
 
 	/**
 	 * Has the output finished playing #chunk?
 	 */
 	bool chunk_finished;
+
+	/**
+	 * Microseconds spent in ao_filter_chunk() per chunk,
+	 * including replay gain and cross-fading.  Written by the
+	 * output thread.
+	 */
+	StatHistogram filter_time;
+
+	/**
+	 * Microseconds spent in each ao_plugin_play() call.  Written
+	 * by the output thread.
+	 */
+	StatHistogram play_time;
 };
 
 /**
@@ -29,6 +29,7 @@
 #include "PlayerControl.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
+#include "ThreadScheduling.hxx"
 
 #include "mpd_error.h"
 #include "gcc.h"
@@ -443,7 +444,9 @@ ao_play_chunk(struct audio_output *ao, const struct music_chunk *chunk)
 	/* workaround -Wmaybe-uninitialized false positive */
 	size = 0;
 #endif
+	const gint64 filter_start = g_get_monotonic_time();
 	const char *data = (const char *)ao_filter_chunk(ao, chunk, &size);
+	ao->filter_time.AddSince(filter_start);
 	if (data == NULL) {
 		ao_close(ao, false);
 
@@ -460,7 +463,9 @@ ao_play_chunk(struct audio_output *ao, const struct music_chunk *chunk)
 			break;
 
 		ao->mutex.unlock();
+		const gint64 play_start = g_get_monotonic_time();
 		nbytes = ao_plugin_play(ao, data, size, &error);
+		ao->play_time.AddSince(play_start);
 		ao->mutex.lock();
 		if (nbytes == 0) {
 			/* play()==0 means failure */
@@ -491,9 +496,10 @@ ao_play_chunk(struct audio_output *ao, const struct music_chunk *chunk)
 static const struct music_chunk *
 ao_next_chunk(struct audio_output *ao)
 {
-	return ao->chunk != NULL
+	const struct music_chunk *chunk = ao->chunk;
+	return chunk != NULL
 		/* continue the previous play() call */
-		? ao->chunk->next
+		? chunk->next
 		/* get the first chunk from the pipe */
 		: music_pipe_peek(ao->pipe);
 }
@@ -577,6 +583,8 @@ static gpointer audio_output_task(gpointer arg)
 {
 	struct audio_output *ao = (struct audio_output *)arg;
 
+	thread_scheduling_apply(THREAD_CLASS_OUTPUT);
+
 	ao->mutex.lock();
 
 	while (1) {
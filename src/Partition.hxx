@@ -39,9 +39,15 @@ struct Partition {
 	Partition(Instance &_instance,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
-		  unsigned buffered_before_play)
+		  unsigned buffered_before_play,
+		  unsigned buffered_before_play_min,
+		  unsigned buffered_before_play_max,
+		  unsigned prefetch_songs,
+		  bool lock_buffer)
 		:instance(_instance), playlist(max_length),
-		 pc(buffer_chunks, buffered_before_play) {
+		 pc(buffer_chunks, buffered_before_play,
+		    buffered_before_play_min, buffered_before_play_max,
+		    prefetch_songs, lock_buffer) {
 	}
 
 	void ClearQueue() {
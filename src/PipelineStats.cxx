@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PipelineStats.hxx"
+#include "OutputAll.hxx"
+#include "OutputInternal.hxx"
+#include "input/FileInputPlugin.hxx"
+#include "Client.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "conf.h"
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "pipeline_stats"
+
+PipelineStats pipeline_stats;
+
+void
+StatHistogram::Print(Client *client, const char *name) const
+{
+	client_printf(client,
+		      "%s_count: %u\n"
+		      "%s_avg: %u\n"
+		      "%s_max: %u\n",
+		      name, GetCount(),
+		      name, GetAverage(),
+		      name, GetMax());
+
+	unsigned n = N_BUCKETS;
+	while (n > 0 && buckets[n - 1].load(std::memory_order_relaxed) == 0)
+		--n;
+
+	GString *s = g_string_sized_new(64);
+	for (unsigned i = 0; i < n; ++i)
+		g_string_append_printf(s, i > 0 ? " %u" : "%u",
+				       buckets[i].load(std::memory_order_relaxed));
+
+	client_printf(client, "%s_histogram: %s\n", name, s->str);
+	g_string_free(s, true);
+}
+
+void
+pipeline_stats_print(Client *client)
+{
+	pipeline_stats.decode_time.Print(client, "decode");
+	pipeline_stats.pipe_chunks.Print(client, "pipe");
+	client_printf(client, "underruns: %u\n",
+		      pipeline_stats.underruns.load(std::memory_order_relaxed));
+	file_input_stall_time.Print(client, "input_stall");
+
+	const unsigned n = audio_output_count();
+	for (unsigned i = 0; i < n; ++i) {
+		const struct audio_output *ao = audio_output_get(i);
+
+		client_printf(client, "outputid: %u\n", i);
+		ao->filter_time.Print(client, "filter");
+		ao->play_time.Print(client, "play");
+	}
+}
+
+/**
+ * Logs a one-line summary of the statistics periodically.
+ */
+class PipelineStatsLogger final : private TimeoutMonitor {
+	const unsigned interval;
+
+public:
+	PipelineStatsLogger(EventLoop &_loop, unsigned _interval)
+		:TimeoutMonitor(_loop), interval(_interval) {
+		ScheduleSeconds(interval);
+	}
+
+private:
+	virtual void OnTimeout() override {
+		GString *s = g_string_sized_new(256);
+		g_string_append_printf(s,
+				       "decode avg=%uus max=%uus, "
+				       "pipe avg=%u chunks, underruns=%u, "
+				       "input stall avg=%uus max=%uus",
+				       pipeline_stats.decode_time.GetAverage(),
+				       pipeline_stats.decode_time.GetMax(),
+				       pipeline_stats.pipe_chunks.GetAverage(),
+				       pipeline_stats.underruns.load(std::memory_order_relaxed),
+				       file_input_stall_time.GetAverage(),
+				       file_input_stall_time.GetMax());
+
+		const unsigned n = audio_output_count();
+		for (unsigned i = 0; i < n; ++i) {
+			const struct audio_output *ao = audio_output_get(i);
+			if (!ao->enabled)
+				continue;
+
+			g_string_append_printf(s,
+					       "; \"%s\": filter avg=%uus max=%uus"
+					       ", play avg=%uus max=%uus",
+					       ao->name,
+					       ao->filter_time.GetAverage(),
+					       ao->filter_time.GetMax(),
+					       ao->play_time.GetAverage(),
+					       ao->play_time.GetMax());
+		}
+
+		g_message("%s", s->str);
+		g_string_free(s, true);
+
+		ScheduleSeconds(interval);
+	}
+};
+
+static PipelineStatsLogger *pipeline_stats_logger;
+
+void
+pipeline_stats_init(EventLoop &loop)
+{
+	const unsigned interval =
+		config_get_unsigned(CONF_PIPELINE_STATS_INTERVAL, 0);
+	if (interval > 0)
+		pipeline_stats_logger = new PipelineStatsLogger(loop, interval);
+}
+
+void
+pipeline_stats_deinit()
+{
+	delete pipeline_stats_logger;
+	pipeline_stats_logger = nullptr;
+}
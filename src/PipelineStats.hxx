@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PIPELINE_STATS_HXX
+#define MPD_PIPELINE_STATS_HXX
+
+#include "gcc.h"
+
+#include <glib.h>
+
+#include <atomic>
+
+#include <stdint.h>
+
+class Client;
+class EventLoop;
+
+/**
+ * A lock-free histogram with power-of-two buckets: bucket 0 counts
+ * the value 0, bucket n (n > 0) counts values in the range
+ * [2^(n-1), 2^n), and the last bucket counts everything beyond.
+ *
+ * Each histogram is usually written by only one thread (the thread
+ * which runs the measured stage), but Add() may be called by several
+ * threads concurrently.  It may be read by any thread at any time.
+ * Readers may see a snapshot which is slightly inconsistent, which is
+ * good enough for statistics.
+ */
+class StatHistogram {
+public:
+	static constexpr unsigned N_BUCKETS = 20;
+
+private:
+	std::atomic<unsigned> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<unsigned> max;
+	std::atomic<unsigned> buckets[N_BUCKETS];
+
+public:
+	StatHistogram():count(0), sum(0), max(0) {
+		for (auto &i : buckets)
+			i.store(0, std::memory_order_relaxed);
+	}
+
+	StatHistogram(const StatHistogram &) = delete;
+	StatHistogram &operator=(const StatHistogram &) = delete;
+
+	/**
+	 * Adds one value.
+	 */
+	void Add(unsigned value) {
+		unsigned bucket = 0;
+		for (unsigned i = value; i != 0 && bucket < N_BUCKETS - 1;
+		     i >>= 1)
+			++bucket;
+
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+
+		unsigned old_max = max.load(std::memory_order_relaxed);
+		while (value > old_max &&
+		       !max.compare_exchange_weak(old_max, value,
+						  std::memory_order_relaxed)) {}
+	}
+
+	/**
+	 * Adds the time elapsed since the specified
+	 * g_get_monotonic_time() value, in microseconds.
+	 */
+	void AddSince(gint64 start) {
+		Add(unsigned(g_get_monotonic_time() - start));
+	}
+
+	gcc_pure
+	unsigned GetCount() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	unsigned GetAverage() const {
+		const unsigned n = GetCount();
+		return n > 0
+			? unsigned(sum.load(std::memory_order_relaxed) / n)
+			: 0;
+	}
+
+	gcc_pure
+	unsigned GetMax() const {
+		return max.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Sends the histogram to the client as the attributes
+	 * "NAME_count", "NAME_avg", "NAME_max" and "NAME_histogram";
+	 * the latter is a space separated list of bucket counters,
+	 * without the trailing empty buckets.
+	 */
+	void Print(Client *client, const char *name) const;
+};
+
+/**
+ * Counters which describe the health of the playback pipeline,
+ * from the decoder to the audio outputs.  The per-output counters
+ * are in struct audio_output.
+ */
+struct PipelineStats {
+	/**
+	 * Microseconds the decoder plugin spent between two
+	 * decoder_data() calls.  Written by the decoder thread.
+	 */
+	StatHistogram decode_time;
+
+	/**
+	 * The number of chunks in the #music_pipe each time the
+	 * player thread sends a chunk to the outputs.  Written by the
+	 * player thread.
+	 */
+	StatHistogram pipe_chunks;
+
+	/**
+	 * How often the player thread had to send silence because
+	 * the decoder didn't provide data in time.
+	 */
+	std::atomic<unsigned> underruns;
+
+	PipelineStats():underruns(0) {}
+};
+
+extern PipelineStats pipeline_stats;
+
+/**
+ * Starts logging a summary of the statistics periodically, if
+ * configured with "pipeline_stats_interval".
+ */
+void
+pipeline_stats_init(EventLoop &loop);
+
+void
+pipeline_stats_deinit();
+
+/**
+ * Sends the global and the per-output statistics to the client.
+ */
+void
+pipeline_stats_print(Client *client);
+
+#endif
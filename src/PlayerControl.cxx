@@ -25,6 +25,7 @@
 #include "Main.hxx"
 
 #include <cmath>
+#include <utility>
 
 #include <assert.h>
 #include <stdio.h>
@@ -33,15 +34,23 @@ static void
 pc_enqueue_song_locked(struct player_control *pc, struct song *song);
 
 player_control::player_control(unsigned _buffer_chunks,
-			       unsigned _buffered_before_play)
+			       unsigned _buffered_before_play,
+			       unsigned _buffered_before_play_min,
+			       unsigned _buffered_before_play_max,
+			       unsigned _prefetch_songs,
+			       bool _lock_buffer)
 	:buffer_chunks(_buffer_chunks),
 	 buffered_before_play(_buffered_before_play),
+	 buffered_before_play_min(_buffered_before_play_min),
+	 buffered_before_play_max(_buffered_before_play_max),
 	 thread(nullptr),
 	 command(PLAYER_COMMAND_NONE),
 	 state(PLAYER_STATE_STOP),
 	 error_type(PLAYER_ERROR_NONE),
 	 error(nullptr),
 	 next_song(nullptr),
+	 prefetch_songs(_prefetch_songs),
+	 lock_buffer(_lock_buffer),
 	 cross_fade_seconds(0),
 	 mixramp_db(0),
 #if defined(__GLIBCXX__) && !defined(_GLIBCXX_USE_C99_MATH_TR1)
@@ -263,11 +272,13 @@ pc_enqueue_song_locked(struct player_control *pc, struct song *song)
 }
 
 void
-player_control::EnqueueSong(struct song *song)
+player_control::EnqueueSong(struct song *song,
+			    std::list<std::string> &&_prefetch_uris)
 {
 	assert(song != NULL);
 
 	Lock();
+	prefetch_uris = std::move(_prefetch_uris);
 	pc_enqueue_song_locked(this, song);
 	Unlock();
 }
@@ -26,6 +26,9 @@
 
 #include <glib.h>
 
+#include <list>
+#include <string>
+
 #include <stdint.h>
 
 struct decoder_control;
@@ -94,6 +97,13 @@ struct player_control {
 
 	unsigned int buffered_before_play;
 
+	/**
+	 * The bounds for adapting #buffered_before_play at runtime
+	 * (see #AdaptiveBuffer).  If both are equal, the threshold is
+	 * constant.
+	 */
+	const unsigned buffered_before_play_min, buffered_before_play_max;
+
 	/** the handle of the player thread, or NULL if the player
 	    thread isn't running */
 	GThread *thread;
@@ -141,6 +151,26 @@ struct player_control {
 	 */
 	struct song *next_song;
 
+	/**
+	 * The number of upcoming songs whose input streams are
+	 * opened before the decoder needs them (see #InputPrefetch).
+	 * 0 disables this feature.
+	 */
+	const unsigned prefetch_songs;
+
+	/**
+	 * Lock the #music_buffer into RAM, so it never gets paged
+	 * out (see music_buffer_lock()).
+	 */
+	const bool lock_buffer;
+
+	/**
+	 * The URIs of upcoming songs which shall be prefetched.  This
+	 * is submitted together with #next_song, and the player
+	 * thread passes it to the #InputPrefetch object.
+	 */
+	std::list<std::string> prefetch_uris;
+
 	double seek_where;
 	float cross_fade_seconds;
 	float mixramp_db;
@@ -157,7 +187,11 @@ struct player_control {
 	bool border_pause;
 
 	player_control(unsigned buffer_chunks,
-		       unsigned buffered_before_play);
+		       unsigned buffered_before_play,
+		       unsigned buffered_before_play_min,
+		       unsigned buffered_before_play_max,
+		       unsigned prefetch_songs,
+		       bool lock_buffer);
 	~player_control();
 
 	/**
@@ -286,8 +320,11 @@ struct player_control {
 	/**
 	 * @param song the song to be queued; the given instance will be owned
 	 * and freed by the player
+	 * @param prefetch_uris the URIs of upcoming songs whose input
+	 * streams shall be opened in advance (see #prefetch_songs)
 	 */
-	void EnqueueSong(struct song *song);
+	void EnqueueSong(struct song *song,
+			 std::list<std::string> &&prefetch_uris);
 
 	/**
 	 * Makes the player thread seek the specified song to a position.
@@ -33,6 +33,9 @@
 #include "tag.h"
 #include "Idle.hxx"
 #include "GlobalEvents.hxx"
+#include "PipelineStats.hxx"
+#include "ThreadScheduling.hxx"
+#include "AdaptiveBuffer.hxx"
 
 #include <cmath>
 
@@ -52,6 +55,13 @@ struct player {
 
 	struct decoder_control *dc;
 
+	/**
+	 * Chooses the buffered_before_play threshold; it lives as
+	 * long as the player thread, so it remembers the behaviour of
+	 * previous songs.
+	 */
+	AdaptiveBuffer &adaptive;
+
 	struct music_pipe *pipe;
 
 	/**
@@ -59,6 +69,19 @@ struct player {
 	 */
 	bool buffering;
 
+	/**
+	 * Has there been an underrun in the current song?
+	 */
+	bool underrun;
+
+	/**
+	 * The number of chunks in #pipe when buffering was
+	 * complete, and the lowest number seen since then.  The
+	 * difference tells #adaptive how deep the buffer was drained
+	 * during this song.
+	 */
+	unsigned buffered_level, low_level;
+
 	/**
 	 * true if the decoder is starting and did not provide data
 	 * yet
@@ -124,9 +147,12 @@ struct player {
 	 */
 	float elapsed_time;
 
-	player(player_control *_pc, decoder_control *_dc)
-		:pc(_pc), dc(_dc),
+	player(player_control *_pc, decoder_control *_dc,
+	       AdaptiveBuffer &_adaptive)
+		:pc(_pc), dc(_dc), adaptive(_adaptive),
 		 buffering(false),
+		 underrun(false),
+		 buffered_level(0), low_level(0),
 		 decoder_starting(false),
 		 paused(false),
 		 queued(true),
@@ -141,6 +167,39 @@ struct player {
 
 static struct music_buffer *player_buffer;
 
+/**
+ * Is the current song a remote stream?  Those are buffered
+ * separately by #AdaptiveBuffer.
+ */
+gcc_pure
+static bool
+player_song_is_remote(const struct player *player)
+{
+	return player->song != NULL && !song_is_file(player->song);
+}
+
+/**
+ * The number of chunks which must be decoded before playback of the
+ * current song starts or resumes.
+ */
+gcc_pure
+static unsigned
+player_buffered_before_play(const struct player *player)
+{
+	return player->adaptive.Get(player_song_is_remote(player));
+}
+
+/**
+ * Remember the buffer level when buffering is complete, the base
+ * for measuring how deep it gets drained.
+ */
+static void
+player_reset_buffer_level(struct player *player)
+{
+	player->buffered_level = player->low_level =
+		music_pipe_size(player->pipe);
+}
+
 static void
 player_command_finished_locked(struct player_control *pc)
 {
@@ -555,6 +614,24 @@ static bool player_seek_decoder(struct player *player)
 	return true;
 }
 
+/**
+ * Passes the URIs which were submitted together with the queued song
+ * to the decoder's #InputPrefetch object.  This does not block; the
+ * streams are opened by the prefetch thread.
+ *
+ * Player lock must be held before calling.
+ */
+static void
+player_update_prefetch(struct player *player)
+{
+	struct player_control *pc = player->pc;
+
+	std::list<std::string> uris;
+	uris.swap(pc->prefetch_uris);
+
+	player->dc->prefetch.Update(std::move(uris));
+}
+
 /**
  * Player lock must be held before calling.
  */
@@ -584,6 +661,8 @@ static void player_process_command(struct player *player)
 
 		player->queued = true;
 		player_command_finished_locked(pc);
+
+		player_update_prefetch(player);
 		break;
 
 	case PLAYER_COMMAND_PAUSE:
@@ -732,6 +811,14 @@ play_next_chunk(struct player *player)
 		   another chunk */
 		return true;
 
+	const unsigned pipe_size = music_pipe_size(player->pipe);
+	pipeline_stats.pipe_chunks.Add(pipe_size);
+	if (pipe_size < player->low_level &&
+	    /* the pipe drains at the end of the song; that is not
+	       a sign of a slow decoder */
+	    player_dc_at_current_song(player) && !dc->LockIsIdle())
+		player->low_level = pipe_size;
+
 	unsigned cross_fade_position;
 	struct music_chunk *chunk = NULL;
 	if (player->xfade == XFADE_ENABLED &&
@@ -850,7 +937,7 @@ play_next_chunk(struct player *player)
 	   larger block at a time */
 	dc->Lock();
 	if (!dc->IsIdle() &&
-	    music_pipe_size(dc->pipe) <= (pc->buffered_before_play +
+	    music_pipe_size(dc->pipe) <= (player_buffered_before_play(player) +
 					 music_buffer_size(player_buffer) * 3) / 4)
 		dc->Signal();
 	dc->Unlock();
@@ -872,6 +959,11 @@ player_song_border(struct player *player)
 {
 	player->xfade = XFADE_UNKNOWN;
 
+	if (!player->underrun && player->buffered_level > 0)
+		player->adaptive.Settle(player_song_is_remote(player),
+					player->buffered_level -
+					player->low_level);
+
 	char *uri = song_get_uri(player->song);
 	g_message("played \"%s\"", uri);
 	g_free(uri);
@@ -884,6 +976,9 @@ player_song_border(struct player *player)
 	if (!player_wait_for_decoder(player))
 		return false;
 
+	player->underrun = false;
+	player_reset_buffer_level(player);
+
 	struct player_control *const pc = player->pc;
 	pc->Lock();
 
@@ -906,9 +1001,10 @@ player_song_border(struct player *player)
  * basically a state machine, which multiplexes data between the
  * decoder thread and the output threads.
  */
-static void do_play(struct player_control *pc, struct decoder_control *dc)
+static void do_play(struct player_control *pc, struct decoder_control *dc,
+		    AdaptiveBuffer &adaptive)
 {
-	player player(pc, dc);
+	player player(pc, dc, adaptive);
 
 	pc->Unlock();
 
@@ -926,6 +1022,10 @@ static void do_play(struct player_control *pc, struct decoder_control *dc)
 		return;
 	}
 
+	/* with adaptive buffering, fill the buffer before the song
+	   starts, too, not only after seeking */
+	player.buffering = adaptive.IsEnabled();
+
 	pc->Lock();
 	pc->state = PLAYER_STATE_PLAY;
 
@@ -951,7 +1051,8 @@ static void do_play(struct player_control *pc, struct decoder_control *dc)
 			   until the buffer is large enough, to
 			   prevent stuttering on slow machines */
 
-			if (music_pipe_size(player.pipe) < pc->buffered_before_play &&
+			if (music_pipe_size(player.pipe) <
+			    player_buffered_before_play(&player) &&
 			    !dc->LockIsIdle()) {
 				/* not enough decoded buffer space yet */
 
@@ -970,6 +1071,7 @@ static void do_play(struct player_control *pc, struct decoder_control *dc)
 			} else {
 				/* buffering is complete */
 				player.buffering = false;
+				player_reset_buffer_level(&player);
 			}
 		}
 
@@ -1021,7 +1123,7 @@ static void do_play(struct player_control *pc, struct decoder_control *dc)
 						&dc->out_audio_format,
 						&player.play_audio_format,
 						music_buffer_size(player_buffer) -
-						pc->buffered_before_play);
+						player_buffered_before_play(&player));
 			if (player.cross_fade_chunks > 0) {
 				player.xfade = XFADE_ENABLED;
 				player.cross_fading = false;
@@ -1068,7 +1170,21 @@ static void do_play(struct player_control *pc, struct decoder_control *dc)
 			/* the decoder is too busy and hasn't provided
 			   new PCM data in time: send silence (if the
 			   output pipe is empty) */
-			if (!player_send_silence(&player))
+			++pipeline_stats.underruns;
+
+			if (adaptive.IsEnabled()) {
+				/* raise the threshold for this kind
+				   of song, and refill the buffer
+				   instead of stuttering; the
+				   buffering code sends silence
+				   meanwhile */
+				if (!player.underrun) {
+					player.underrun = true;
+					adaptive.Grow(player_song_is_remote(&player));
+				}
+
+				player.buffering = true;
+			} else if (!player_send_silence(&player))
 				break;
 		}
 
@@ -1108,10 +1224,18 @@ player_task(gpointer arg)
 {
 	struct player_control *pc = (struct player_control *)arg;
 
+	thread_scheduling_apply(THREAD_CLASS_PLAYER);
+
 	struct decoder_control *dc = new decoder_control();
 	decoder_thread_start(dc);
 
 	player_buffer = music_buffer_new(pc->buffer_chunks);
+	if (pc->lock_buffer)
+		music_buffer_lock(player_buffer);
+
+	AdaptiveBuffer adaptive(pc->buffered_before_play,
+				pc->buffered_before_play_min,
+				pc->buffered_before_play_max);
 
 	pc->Lock();
 
@@ -1121,12 +1245,13 @@ player_task(gpointer arg)
 		case PLAYER_COMMAND_QUEUE:
 			assert(pc->next_song != NULL);
 
-			do_play(pc, dc);
+			do_play(pc, dc, adaptive);
 			break;
 
 		case PLAYER_COMMAND_STOP:
 			pc->Unlock();
 			audio_output_all_cancel();
+			dc->prefetch.Clear();
 			pc->Lock();
 
 			/* fall through */
@@ -1154,6 +1279,8 @@ player_task(gpointer arg)
 			   music_buffer */
 			music_buffer_free(player_buffer);
 			player_buffer = music_buffer_new(pc->buffer_chunks);
+			if (pc->lock_buffer)
+				music_buffer_lock(player_buffer);
 #endif
 
 			break;
@@ -49,6 +49,35 @@ playlist::TagChanged()
 	idle_add(IDLE_PLAYLIST);
 }
 
+/**
+ * Collects the URIs of the remote songs which will be played next,
+ * beginning with the specified one.  Local files are skipped,
+ * because opening them is cheap.
+ */
+static std::list<std::string>
+playlist_prefetch_uris(const struct playlist *playlist,
+		       const struct player_control *pc, unsigned order)
+{
+	std::list<std::string> uris;
+
+	for (unsigned i = 0; i < pc->prefetch_songs; ++i) {
+		const struct song *song = playlist->queue.GetOrder(order);
+		if (!song_is_file(song)) {
+			char *uri = song_get_uri(song);
+			uris.push_back(uri);
+			g_free(uri);
+		}
+
+		int next = playlist->queue.GetNextOrder(order);
+		if (next < 0 || (unsigned)next == order)
+			break;
+
+		order = next;
+	}
+
+	return uris;
+}
+
 /**
  * Queue a song, addressed by its order number.
  */
@@ -69,7 +98,7 @@ playlist_queue_song_order(struct playlist *playlist, struct player_control *pc,
 	g_debug("queue song %i:\"%s\"", playlist->queued, uri);
 	g_free(uri);
 
-	pc->EnqueueSong(song);
+	pc->EnqueueSong(song, playlist_prefetch_uris(playlist, pc, order));
 }
 
 /**
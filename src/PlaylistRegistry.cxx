@@ -217,7 +217,7 @@ playlist_list_open_stream_mime2(struct input_stream *is, const char *mime)
 		    string_array_contains(plugin->mime_types, mime)) {
 			/* rewind the stream, so each plugin gets a
 			   fresh start */
-			input_stream_seek(is, 0, SEEK_SET, NULL);
+			input_stream_lock_seek(is, 0, SEEK_SET, NULL);
 
 			playlist = playlist_plugin_open_stream(plugin, is);
 			if (playlist != NULL)
@@ -262,7 +262,7 @@ playlist_list_open_stream_suffix(struct input_stream *is, const char *suffix)
 		    string_array_contains(plugin->suffixes, suffix)) {
 			/* rewind the stream, so each plugin gets a
 			   fresh start */
-			input_stream_seek(is, 0, SEEK_SET, NULL);
+			input_stream_lock_seek(is, 0, SEEK_SET, NULL);
 
 			playlist = playlist_plugin_open_stream(plugin, is);
 			if (playlist != NULL)
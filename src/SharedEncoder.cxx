@@ -0,0 +1,935 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedEncoder.hxx"
+#include "encoder_plugin.h"
+#include "audio_format.h"
+#include "conf.h"
+#include "ConfigData.hxx"
+#include "tag.h"
+#include "Page.hxx"
+#include "thread/Mutex.hxx"
+
+#include <glib.h>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "shared_encoder"
+
+/**
+ * The maximum number of pages queued for one output.  If an output
+ * doesn't read its data, it fails instead of losing data silently.
+ */
+static constexpr size_t SHARED_ENCODER_MAX_PAGES = 1024;
+
+struct SharedEncoder;
+
+struct SharedEncoderGroup {
+	const std::string name;
+
+	/**
+	 * The real encoder.  Protected by #mutex.
+	 */
+	struct encoder *const encoder;
+
+	/**
+	 * The number of #SharedEncoder objects referring to this
+	 * group.  Only accessed from the main thread.
+	 */
+	unsigned refcount;
+
+	Mutex mutex;
+
+	/**
+	 * The members which receive the encoded data.  The real
+	 * encoder is open while this list is not empty.  A member
+	 * which has called encoder_end() while others are still
+	 * playing is removed from this list, but remains open until
+	 * it has read its queue.
+	 */
+	std::list<SharedEncoder *> open_members;
+
+	/**
+	 * The audio format passed to encoder_open() and the one
+	 * returned by it.  Only valid while #open_members is not
+	 * empty.
+	 */
+	struct audio_format in_format, out_format;
+
+	/**
+	 * The data returned by the encoder right after it was opened
+	 * or after the last tag; it is sent to every output which
+	 * joins later.  May be nullptr.
+	 */
+	Page *header;
+
+	/**
+	 * The last tag passed to encoder_tag(); used to restart the
+	 * stream when a member ends.  May be nullptr.
+	 */
+	struct tag *tag;
+
+	/**
+	 * The number of PCM bytes which have been submitted to the
+	 * encoder.  All members receive the same PCM data, and each
+	 * of them counts the bytes it has written; only the part
+	 * beyond this position is encoded.  Therefore it doesn't
+	 * matter which member is ahead, and none of them has to take
+	 * over when another one closes.
+	 */
+	uint64_t position;
+
+	/**
+	 * The member which has called encoder_pre_tag() on the real
+	 * encoder and has not yet called encoder_tag(), or nullptr.
+	 */
+	SharedEncoder *tagging;
+
+	/**
+	 * PCM data which was written while #tagging was set; it is
+	 * submitted when the tag is finished.
+	 */
+	std::vector<char> pending;
+
+	/**
+	 * The #position of the last tag.  Only valid if #has_tag is
+	 * set.  A tag at or before this position has already been
+	 * applied by another member.
+	 */
+	uint64_t tag_position;
+
+	bool has_tag;
+
+	/**
+	 * The #position of the last encoder_flush() call.  Only valid
+	 * if #has_flush is set.
+	 */
+	uint64_t flush_position;
+
+	bool has_flush;
+
+	/**
+	 * Has encoder_end() been called on the real encoder?  No
+	 * new members may join until it has been closed.
+	 */
+	bool ended;
+
+	/**
+	 * The encoder settings and the audio format of the first
+	 * member's configuration block.  All other members must
+	 * have the same ones.
+	 */
+	const std::map<std::string, std::string> settings;
+
+	SharedEncoderGroup(const char *_name, struct encoder *_encoder,
+			   std::map<std::string, std::string> &&_settings)
+		:name(_name), encoder(_encoder), refcount(0),
+		 header(nullptr), tag(nullptr),
+		 position(0), tagging(nullptr),
+		 tag_position(0), has_tag(false),
+		 flush_position(0), has_flush(false),
+		 ended(false), settings(std::move(_settings)) {}
+
+	~SharedEncoderGroup() {
+		assert(refcount == 0);
+		assert(open_members.empty());
+		assert(header == nullptr);
+		assert(tag == nullptr);
+
+		encoder_finish(encoder);
+	}
+
+	SharedEncoderGroup(const SharedEncoderGroup &) = delete;
+	SharedEncoderGroup &operator=(const SharedEncoderGroup &) = delete;
+
+	/**
+	 * Does the real encoder support tags, i.e. can it end the
+	 * current stream and begin a new one?
+	 */
+	bool HasTags() const {
+		return encoder->plugin->tag != nullptr;
+	}
+
+	/**
+	 * Submits PCM data to the real encoder, or queues it while a
+	 * tag is in progress.  Caller must lock the mutex.
+	 */
+	bool Write(const void *data, size_t length, GError **error_r);
+
+	/**
+	 * Reads everything the encoder has to offer into one
+	 * #Page.  Caller must lock the mutex.
+	 *
+	 * @return the page or nullptr if the encoder had no data
+	 */
+	Page *ReadPage();
+
+	/**
+	 * Moves all pending data from the encoder to the queues of
+	 * all open members.  Caller must lock the mutex.
+	 */
+	void Drain();
+
+	/**
+	 * Sends a tag to the real encoder, which begins a new stream,
+	 * replaces the #header, and submits the PCM data which was
+	 * queued meanwhile.  Caller must lock the mutex.
+	 *
+	 * @param tag the new tag; nullptr repeats the last one
+	 */
+	bool FinishTag(const struct tag *tag, GError **error_r);
+
+	/**
+	 * Closes the real encoder and resets the state.  Caller must
+	 * lock the mutex.
+	 */
+	void Close();
+};
+
+struct SharedEncoder {
+	/** the base class */
+	struct encoder encoder;
+
+	SharedEncoderGroup *const group;
+
+	struct QueuedPage {
+		Page *page;
+
+		/**
+		 * Is this the header of a new stream (see
+		 * SharedEncoderGroup::header)?
+		 */
+		bool header;
+	};
+
+	/**
+	 * Encoded data which has not been read yet by this output.
+	 * Protected by SharedEncoderGroup::mutex.
+	 */
+	std::deque<QueuedPage> queue;
+
+	/**
+	 * The number of bytes of the first page in #queue which
+	 * have already been read.
+	 */
+	size_t position;
+
+	/**
+	 * The number of PCM bytes written by this output; see
+	 * SharedEncoderGroup::position.
+	 */
+	uint64_t pcm_position;
+
+	/**
+	 * Has this output called encoder_end() while other members
+	 * were still playing?  If so, it has been removed from
+	 * SharedEncoderGroup::open_members.
+	 */
+	bool ended;
+
+	/**
+	 * Set if the #queue has overflowed, because this output
+	 * doesn't read its data.  All further calls fail until the
+	 * output is closed.
+	 */
+	bool failed;
+
+	SharedEncoder(SharedEncoderGroup *_group);
+
+	~SharedEncoder() {
+		assert(queue.empty());
+	}
+
+	SharedEncoder(const SharedEncoder &) = delete;
+	SharedEncoder &operator=(const SharedEncoder &) = delete;
+
+	void Push(Page *page, bool header=false) {
+		if (failed)
+			return;
+
+		if (queue.size() >= SHARED_ENCODER_MAX_PAGES) {
+			g_warning("\"%s\": output doesn't read its data, "
+				  "%u pages queued",
+				  group->name.c_str(), unsigned(queue.size()));
+			ClearQueue();
+			failed = true;
+			return;
+		}
+
+		page->Ref();
+		queue.push_back({page, header});
+	}
+
+	/**
+	 * Is the next data in the #queue a stream header?
+	 */
+	bool IsAtHeader() const {
+		return !queue.empty() && queue.front().header &&
+			position == 0;
+	}
+
+	void ClearQueue() {
+		for (const auto &i : queue)
+			i.page->Unref();
+		queue.clear();
+		position = 0;
+	}
+
+	/**
+	 * Returns false and sets an error if this member has failed.
+	 */
+	bool Check(GError **error_r) const;
+};
+
+/**
+ * All groups, indexed by name.  Only accessed from the main thread.
+ */
+static std::map<std::string, SharedEncoderGroup *> shared_encoder_groups;
+
+static inline GQuark
+shared_encoder_quark(void)
+{
+	return g_quark_from_static_string("shared_encoder");
+}
+
+bool
+SharedEncoder::Check(GError **error_r) const
+{
+	if (!failed)
+		return true;
+
+	g_set_error(error_r, shared_encoder_quark(), 0,
+		    "Queue of shared encoder \"%s\" has overflowed",
+		    group->name.c_str());
+	return false;
+}
+
+bool
+SharedEncoderGroup::Write(const void *data, size_t length,
+			  GError **error_r)
+{
+	if (tagging != nullptr) {
+		const char *p = (const char *)data;
+		pending.insert(pending.end(), p, p + length);
+		return true;
+	}
+
+	return encoder_write(encoder, data, length, error_r);
+}
+
+Page *
+SharedEncoderGroup::ReadPage()
+{
+	char buffer[32768];
+	size_t size = 0;
+
+	do {
+		size_t nbytes = encoder_read(encoder, buffer + size,
+					     sizeof(buffer) - size);
+		if (nbytes == 0)
+			break;
+
+		size += nbytes;
+	} while (size < sizeof(buffer));
+
+	return size > 0
+		? Page::Copy(buffer, size)
+		: nullptr;
+}
+
+void
+SharedEncoderGroup::Drain()
+{
+	Page *page;
+	while ((page = ReadPage()) != nullptr) {
+		for (SharedEncoder *member : open_members)
+			member->Push(page);
+
+		page->Unref();
+	}
+}
+
+bool
+SharedEncoderGroup::FinishTag(const struct tag *new_tag, GError **error_r)
+{
+	assert(tagging != nullptr);
+
+	tagging = nullptr;
+
+	if (new_tag != nullptr) {
+		if (tag != nullptr)
+			tag_free(tag);
+		tag = tag_dup(new_tag);
+	}
+
+	struct tag *empty = nullptr;
+	if (tag == nullptr)
+		empty = tag_new();
+
+	bool success = encoder_tag(encoder, tag != nullptr ? tag : empty,
+				   error_r);
+
+	if (empty != nullptr)
+		tag_free(empty);
+
+	/* the first data generated by the encoder now is the header
+	   of the new stream */
+	Page *page = ReadPage();
+	if (page != nullptr) {
+		if (header != nullptr)
+			header->Unref();
+		header = page;
+
+		for (SharedEncoder *member : open_members)
+			member->Push(page, true);
+	}
+
+	if (success && !pending.empty())
+		success = encoder_write(encoder, pending.data(),
+					pending.size(), error_r);
+
+	pending.clear();
+	return success;
+}
+
+void
+SharedEncoderGroup::Close()
+{
+	assert(open_members.empty());
+
+	if (tagging != nullptr)
+		FinishTag(nullptr, nullptr);
+
+	if (header != nullptr) {
+		header->Unref();
+		header = nullptr;
+	}
+
+	if (tag != nullptr) {
+		tag_free(tag);
+		tag = nullptr;
+	}
+
+	position = 0;
+	has_tag = false;
+	has_flush = false;
+
+	encoder_close(encoder);
+}
+
+static void
+shared_encoder_finish(struct encoder *_encoder)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	delete encoder;
+
+	assert(group->refcount > 0);
+	if (--group->refcount == 0) {
+		shared_encoder_groups.erase(group->name);
+		delete group;
+	}
+}
+
+static bool
+shared_encoder_open(struct encoder *_encoder,
+		    struct audio_format *audio_format,
+		    GError **error_r)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (group->open_members.empty()) {
+		group->in_format = *audio_format;
+		if (!encoder_open(group->encoder, audio_format, error_r))
+			return false;
+
+		group->out_format = *audio_format;
+		group->ended = false;
+
+		assert(group->header == nullptr);
+		group->header = group->ReadPage();
+	} else if (group->ended) {
+		g_set_error(error_r, shared_encoder_quark(), 0,
+			    "Shared encoder \"%s\" is being closed",
+			    group->name.c_str());
+		return false;
+	} else if (audio_format_equals(audio_format, &group->in_format) ||
+		   audio_format_equals(audio_format, &group->out_format)) {
+		*audio_format = group->out_format;
+	} else {
+		struct audio_format_string s;
+		g_set_error(error_r, shared_encoder_quark(), 0,
+			    "Shared encoder \"%s\" is already open with "
+			    "audio format %s",
+			    group->name.c_str(),
+			    audio_format_to_string(&group->in_format, &s));
+		return false;
+	}
+
+	assert(encoder->queue.empty());
+
+	/* if a tag is in progress, the new header will be sent to
+	   all members when it's finished */
+	if (group->header != nullptr && group->tagging == nullptr)
+		encoder->Push(group->header, true);
+
+	/* the new member starts at the current position of the
+	   stream */
+	encoder->pcm_position = group->position;
+	encoder->ended = false;
+	encoder->failed = false;
+
+	group->open_members.push_back(encoder);
+	return true;
+}
+
+static void
+shared_encoder_close(struct encoder *_encoder)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (group->tagging == encoder)
+		/* this member has ended the stream; begin the new
+		   one for the others */
+		group->FinishTag(nullptr, nullptr);
+
+	encoder->ClearQueue();
+
+	if (encoder->ended)
+		/* already removed from the list by
+		   shared_encoder_end() */
+		return;
+
+	group->open_members.remove(encoder);
+
+	if (group->open_members.empty())
+		group->Close();
+}
+
+static bool
+shared_encoder_end(struct encoder *_encoder, GError **error_r)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (!encoder->Check(error_r))
+		return false;
+
+	assert(!encoder->ended);
+
+	if (group->tagging == encoder &&
+	    !group->FinishTag(nullptr, error_r))
+		return false;
+
+	if (group->open_members.size() == 1) {
+		/* this is the last member: end the real stream */
+		assert(group->open_members.front() == encoder);
+
+		group->ended = true;
+		return encoder_end(group->encoder, error_r);
+	}
+
+	/* the others are still using the encoder: give this member
+	   the rest of the stream, and detach it */
+
+	bool success = true;
+	if (group->tagging != nullptr) {
+		/* another member has just ended the stream (in
+		   encoder_pre_tag()), and the end of it has been
+		   queued for all members already */
+	} else if (group->HasTags()) {
+		/* end the stream, and begin a new one with the same
+		   tag for the others */
+		success = encoder_pre_tag(group->encoder, error_r);
+		if (success) {
+			group->tagging = encoder;
+			group->Drain();
+		}
+	} else {
+		success = encoder_flush(group->encoder, error_r);
+		group->Drain();
+	}
+
+	group->open_members.remove(encoder);
+	encoder->ended = true;
+
+	if (group->tagging == encoder && !group->FinishTag(nullptr, error_r))
+		success = false;
+
+	return success;
+}
+
+static bool
+shared_encoder_flush(struct encoder *_encoder, GError **error_r)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (!encoder->Check(error_r))
+		return false;
+
+	/* flush only once per position, no matter how many members
+	   ask for it */
+	if (encoder->ended || group->tagging != nullptr ||
+	    (group->has_flush && group->flush_position == group->position))
+		return true;
+
+	group->flush_position = group->position;
+	group->has_flush = true;
+	return encoder_flush(group->encoder, error_r);
+}
+
+static bool
+shared_encoder_pre_tag(struct encoder *_encoder, GError **error_r)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (!encoder->Check(error_r))
+		return false;
+
+	/* all members send the same tags at the same position; only
+	   the first one is passed to the real encoder */
+	if (encoder->ended || group->tagging != nullptr ||
+	    (group->has_tag && encoder->pcm_position <= group->tag_position))
+		return true;
+
+	if (!encoder_pre_tag(group->encoder, error_r))
+		return false;
+
+	group->tagging = encoder;
+	group->tag_position = encoder->pcm_position;
+	group->has_tag = true;
+
+	/* move the end of the stream to all members */
+	group->Drain();
+	return true;
+}
+
+static bool
+shared_encoder_tag(struct encoder *_encoder, const struct tag *tag,
+		   GError **error_r)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	return group->tagging != encoder ||
+		group->FinishTag(tag, error_r);
+}
+
+static bool
+shared_encoder_write(struct encoder *_encoder,
+		     const void *data, size_t length,
+		     GError **error_r)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (!encoder->Check(error_r))
+		return false;
+
+	if (encoder->ended)
+		return true;
+
+	/* the other members play the same data; submit only the
+	   part which none of them has submitted yet */
+	const uint64_t start = encoder->pcm_position;
+	const uint64_t end = start + length;
+	encoder->pcm_position = end;
+
+	if (end <= group->position)
+		return true;
+
+	const size_t skip = start < group->position
+		? size_t(group->position - start)
+		: 0;
+	group->position = end;
+
+	return group->Write((const char *)data + skip, length - skip,
+			    error_r);
+}
+
+static size_t
+shared_encoder_read(struct encoder *_encoder, void *dest, size_t length)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup *group = encoder->group;
+
+	const ScopeLock protect(group->mutex);
+
+	if (!group->open_members.empty())
+		group->Drain();
+
+	if (encoder->queue.empty())
+		return 0;
+
+	const Page *page = encoder->queue.front().page;
+	assert(encoder->position < page->size);
+
+	size_t nbytes = page->size - encoder->position;
+	if (nbytes > length)
+		nbytes = length;
+
+	memcpy(dest, page->data + encoder->position, nbytes);
+	encoder->position += nbytes;
+
+	if (encoder->position == page->size) {
+		encoder->queue.front().page->Unref();
+		encoder->queue.pop_front();
+		encoder->position = 0;
+	}
+
+	return nbytes;
+}
+
+static const char *
+shared_encoder_get_mime_type(struct encoder *_encoder)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+
+	return encoder_get_mime_type(encoder->group->encoder);
+}
+
+static const struct encoder_plugin shared_encoder_plugin = {
+	"shared",
+	nullptr,
+	shared_encoder_finish,
+	shared_encoder_open,
+	shared_encoder_close,
+	shared_encoder_end,
+	shared_encoder_flush,
+	shared_encoder_pre_tag,
+	shared_encoder_tag,
+	shared_encoder_write,
+	shared_encoder_read,
+	shared_encoder_get_mime_type,
+};
+
+/**
+ * Same as #shared_encoder_plugin, but without tag support.  Some
+ * outputs check whether the encoder plugin supports tags, and send
+ * them differently if not; so the proxy must not pretend to support
+ * tags if the real encoder doesn't.
+ */
+static const struct encoder_plugin shared_encoder_plugin_no_tags = {
+	"shared",
+	nullptr,
+	shared_encoder_finish,
+	shared_encoder_open,
+	shared_encoder_close,
+	shared_encoder_end,
+	shared_encoder_flush,
+	nullptr,
+	nullptr,
+	shared_encoder_write,
+	shared_encoder_read,
+	shared_encoder_get_mime_type,
+};
+
+SharedEncoder::SharedEncoder(SharedEncoderGroup *_group)
+	:group(_group), position(0), pcm_position(0),
+	 ended(false), failed(false)
+{
+	encoder_struct_init(&encoder,
+			    group->encoder->plugin->tag != nullptr
+			    ? &shared_encoder_plugin
+			    : &shared_encoder_plugin_no_tags);
+}
+
+bool
+shared_encoder_is_shared(const struct encoder *encoder)
+{
+	return encoder->plugin == &shared_encoder_plugin ||
+		encoder->plugin == &shared_encoder_plugin_no_tags;
+}
+
+/**
+ * Returns the #SharedEncoder for the specified encoder object, or
+ * nullptr if it is not shared.
+ */
+static SharedEncoder *
+shared_encoder_cast(struct encoder *encoder)
+{
+	return shared_encoder_is_shared(encoder)
+		? (SharedEncoder *)encoder
+		: nullptr;
+}
+
+bool
+shared_encoder_at_header(struct encoder *_encoder)
+{
+	SharedEncoder *encoder = shared_encoder_cast(_encoder);
+	if (encoder == nullptr)
+		return false;
+
+	SharedEncoderGroup *group = encoder->group;
+	const ScopeLock protect(group->mutex);
+
+	if (!group->open_members.empty())
+		group->Drain();
+
+	return encoder->IsAtHeader();
+}
+
+Page *
+shared_encoder_read_header(struct encoder *_encoder)
+{
+	SharedEncoder *encoder = shared_encoder_cast(_encoder);
+	if (encoder == nullptr)
+		return nullptr;
+
+	SharedEncoderGroup *group = encoder->group;
+	const ScopeLock protect(group->mutex);
+
+	if (!group->open_members.empty())
+		group->Drain();
+
+	if (!encoder->IsAtHeader())
+		return nullptr;
+
+	/* pass the reference to the caller */
+	Page *page = encoder->queue.front().page;
+	encoder->queue.pop_front();
+	return page;
+}
+
+/**
+ * Creates the real encoder with encoder_init(), and collects the
+ * settings it has used from the configuration block, plus the audio
+ * format of the output.
+ */
+static struct encoder *
+shared_encoder_init_real(const struct encoder_plugin *plugin,
+			 const struct config_param *param,
+			 std::map<std::string, std::string> &settings,
+			 GError **error_r)
+{
+	std::vector<bool> was_used;
+	if (param != nullptr)
+		for (const auto &bp : param->block_params)
+			was_used.push_back(bp.used);
+
+	struct encoder *encoder = encoder_init(plugin, param, error_r);
+	if (encoder == nullptr || param == nullptr)
+		return encoder;
+
+	for (size_t i = 0; i < was_used.size(); ++i) {
+		const block_param &bp = param->block_params[i];
+		if (bp.used && !was_used[i])
+			settings[bp.name] = bp.value;
+	}
+
+	const char *format = config_get_block_string(param, "format",
+						     nullptr);
+	if (format != nullptr)
+		settings["format"] = format;
+
+	return encoder;
+}
+
+struct encoder *
+shared_encoder_init(const struct encoder_plugin *plugin,
+		    const struct config_param *param,
+		    GError **error_r)
+{
+	const char *name = config_get_block_string(param, "shared_encoder",
+						   nullptr);
+	if (name == nullptr)
+		return encoder_init(plugin, param, error_r);
+
+	SharedEncoderGroup *group;
+
+	auto i = shared_encoder_groups.find(name);
+	if (i != shared_encoder_groups.end()) {
+		group = i->second;
+
+		if (group->encoder->plugin != plugin) {
+			g_set_error(error_r, shared_encoder_quark(), 0,
+				    "Shared encoder \"%s\" uses the \"%s\" "
+				    "plugin",
+				    name, group->encoder->plugin->name);
+			return nullptr;
+		}
+
+		/* parse this member's settings with a temporary
+		   encoder, so typos are reported and differences
+		   are not ignored silently */
+		std::map<std::string, std::string> settings;
+		struct encoder *tmp = shared_encoder_init_real(plugin, param,
+							       settings,
+							       error_r);
+		if (tmp == nullptr)
+			return nullptr;
+
+		encoder_finish(tmp);
+
+		if (settings != group->settings) {
+			g_set_error(error_r, shared_encoder_quark(), 0,
+				    "Outputs sharing the encoder \"%s\" "
+				    "have different encoder or \"format\" "
+				    "settings (line %d)",
+				    name, param->line);
+			return nullptr;
+		}
+	} else {
+		std::map<std::string, std::string> settings;
+		struct encoder *encoder =
+			shared_encoder_init_real(plugin, param, settings,
+						 error_r);
+		if (encoder == nullptr)
+			return nullptr;
+
+		group = new SharedEncoderGroup(name, encoder,
+					       std::move(settings));
+		shared_encoder_groups.insert(std::make_pair(group->name,
+							    group));
+	}
+
+	++group->refcount;
+
+	SharedEncoder *encoder = new SharedEncoder(group);
+	return &encoder->encoder;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * Allows several outputs to share one encoder instance.  All outputs
+ * which specify the same "shared_encoder" name in their configuration
+ * block feed one encoder; the encoded data is distributed to all of
+ * them as reference counted #Page objects.  The encoder settings and
+ * the "format" setting of all these outputs must be equal, or MPD
+ * refuses to start.
+ *
+ * Each output keeps its own filter chain (e.g. replay gain and
+ * software volume), but there is only one encoded stream: all
+ * members are expected to play the same PCM data, and each one
+ * counts the bytes it has written.  Only data beyond the furthest
+ * position is submitted to the encoder, so it doesn't matter which
+ * output is ahead.  These counters are not synchronized when an
+ * output drops data (cancel) or plays silence while paused; after
+ * that, closing the output which is ahead may skip or repeat a bit
+ * of audio for the others.  Tags are applied once, by the first
+ * member which reaches them.
+ *
+ * The stream header which the encoder generates after opening and
+ * after each tag is queued for every member at the position where
+ * it belongs; shared_encoder_read_header() lets an output keep it
+ * separately.
+ *
+ * A member which ends its stream while others keep playing receives
+ * the end of the current stream (with the end-of-stream marker, if
+ * the encoder supports tags); the others continue with a new stream.
+ */
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+#include "gerror.h"
+#include "gcc.h"
+
+struct encoder;
+struct encoder_plugin;
+struct config_param;
+class Page;
+
+/**
+ * Creates a new encoder object, like encoder_init().  If the
+ * configuration block contains the "shared_encoder" setting, the
+ * returned object is a proxy for an encoder which is shared with
+ * other outputs.
+ *
+ * The returned object must be freed with encoder_finish() in the
+ * main thread.
+ */
+struct encoder *
+shared_encoder_init(const struct encoder_plugin *plugin,
+		    const struct config_param *param,
+		    GError **error_r);
+
+/**
+ * Was this encoder object created by shared_encoder_init() with a
+ * "shared_encoder" setting?
+ */
+gcc_pure
+bool
+shared_encoder_is_shared(const struct encoder *encoder);
+
+/**
+ * Is the data returned by the next encoder_read() call the header of
+ * a new stream?  Always false for encoders which are not shared.
+ */
+bool
+shared_encoder_at_header(struct encoder *encoder);
+
+/**
+ * If the next data of this encoder is the header of a new stream,
+ * removes it and returns it, instead of returning it with
+ * encoder_read().  This works no matter which member has applied the
+ * tag which began the stream.
+ *
+ * @return the header page (to be released with Page::Unref()), or
+ * nullptr if the next data is not a header or the encoder is not
+ * shared
+ */
+Page *
+shared_encoder_read_header(struct encoder *encoder);
+
+#endif
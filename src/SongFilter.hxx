@@ -34,6 +34,7 @@ struct tag_item;
 struct song;
 
 class SongFilter {
+public:
 	class Item {
 		uint8_t tag;
 
@@ -61,6 +62,18 @@ class SongFilter {
 			return tag;
 		}
 
+		bool GetFoldCase() const {
+			return fold_case;
+		}
+
+		/**
+		 * Returns the value to be matched; if #fold_case is
+		 * set, it is already case-folded.
+		 */
+		const char *GetValue() const {
+			return value;
+		}
+
 		gcc_pure gcc_nonnull(2)
 		bool StringMatch(const char *s) const;
 
@@ -74,6 +87,7 @@ class SongFilter {
 		bool Match(const song &song) const;
 	};
 
+private:
 	std::list<Item> items;
 
 public:
@@ -95,6 +109,10 @@ public:
 
 	gcc_pure
 	bool Match(const song &song) const;
+
+	const std::list<Item> &GetItems() const {
+		return items;
+	}
 };
 
 /**
@@ -32,6 +32,7 @@ extern "C" {
 #include "input_stream.h"
 #include "decoder_plugin.h"
 #include "DecoderList.hxx"
+#include "TagCache.hxx"
 
 extern "C" {
 #include "tag_ape.h"
@@ -118,6 +119,14 @@ song_file_update(struct song *song)
 
 	song->mtime = st.st_mtime;
 
+	if (song_in_database(song)) {
+		/* maybe this file was scanned before under a
+		   different name */
+		song->tag = tag_cache_lookup(st);
+		if (song->tag != NULL)
+			return true;
+	}
+
 	Mutex mutex;
 	Cond cond;
 
@@ -166,6 +175,9 @@ song_file_update(struct song *song)
 		tag_scan_fallback(path_fs.c_str(), &full_tag_handler,
 				  song->tag);
 
+	if (song->tag != NULL && song_in_database(song))
+		tag_cache_store(st, *song->tag);
+
 	return song->tag != NULL;
 }
 
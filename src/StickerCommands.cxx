@@ -30,6 +30,8 @@
 #include "CommandError.hxx"
 #include "protocol/Result.hxx"
 
+#include <vector>
+
 #include <string.h>
 
 struct sticker_song_find_data {
@@ -102,6 +104,39 @@ handle_sticker_song(Client *client, int argc, char *argv[])
 			return COMMAND_RETURN_ERROR;
 		}
 
+		return COMMAND_RETURN_OK;
+	/* set song uri1 uri2 ... key value */
+	} else if (argc > 6 && strcmp(argv[1], "set") == 0) {
+		const char *name = argv[argc - 2], *value = argv[argc - 1];
+
+		/* look up all songs first, so a typo in one URI
+		   doesn't leave the others half-done */
+		std::vector<song *> songs;
+		for (int i = 3; i < argc - 2; ++i) {
+			song *song = db->GetSong(argv[i], &error);
+			if (song == nullptr) {
+				for (auto s : songs)
+					db->ReturnSong(s);
+				return print_error(client, error);
+			}
+
+			songs.push_back(song);
+		}
+
+		/* the sticker library collects these in one
+		   transaction */
+		bool ret = true;
+		for (auto s : songs) {
+			ret = ret && sticker_song_set_value(s, name, value);
+			db->ReturnSong(s);
+		}
+
+		if (!ret) {
+			command_error(client, ACK_ERROR_SYSTEM,
+				      "failed to set sticker value");
+			return COMMAND_RETURN_ERROR;
+		}
+
 		return COMMAND_RETURN_OK;
 	/* delete song song_id [key] */
 	} else if ((argc == 4 || argc == 5) &&
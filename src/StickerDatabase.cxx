@@ -20,9 +20,12 @@
 #include "config.h"
 #include "StickerDatabase.hxx"
 #include "Idle.hxx"
+#include "Main.hxx"
+#include "event/TimeoutMonitor.hxx"
 
 #include <string>
 #include <map>
+#include <unordered_map>
 
 #include <glib.h>
 #include <sqlite3.h>
@@ -40,18 +43,16 @@ struct sticker {
 };
 
 enum sticker_sql {
-	STICKER_SQL_GET,
 	STICKER_SQL_LIST,
 	STICKER_SQL_UPDATE,
 	STICKER_SQL_INSERT,
 	STICKER_SQL_DELETE,
 	STICKER_SQL_DELETE_VALUE,
 	STICKER_SQL_FIND,
+	STICKER_SQL_FIND_RANGE,
 };
 
 static const char *const sticker_sql[] = {
-	//[STICKER_SQL_GET] =
-	"SELECT value FROM sticker WHERE type=? AND uri=? AND name=?",
 	//[STICKER_SQL_LIST] =
 	"SELECT name,value FROM sticker WHERE type=? AND uri=?",
 	//[STICKER_SQL_UPDATE] =
@@ -63,7 +64,9 @@ static const char *const sticker_sql[] = {
 	//[STICKER_SQL_DELETE_VALUE] =
 	"DELETE FROM sticker WHERE type=? AND uri=? AND name=?",
 	//[STICKER_SQL_FIND] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri>=?",
+	//[STICKER_SQL_FIND_RANGE] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri>=? AND uri<?",
 };
 
 static const char sticker_sql_create[] =
@@ -75,11 +78,72 @@ static const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name ON sticker(type, name, uri);"
 	"";
 
+/**
+ * Modifications are collected in one transaction which is committed
+ * after this many milliseconds.  This reduces the number of fsync()
+ * calls when a client sets many stickers in a row.
+ */
+static constexpr unsigned STICKER_COMMIT_DELAY_MS = 1000;
+
+/**
+ * Commit the pending transaction early when it has accumulated this
+ * many modifications.
+ */
+static constexpr unsigned STICKER_COMMIT_MAX_PENDING = 1024;
+
+/**
+ * How long [ms] may SQLite wait for a lock held by another process
+ * before a statement fails with SQLITE_BUSY?  This blocks the main
+ * thread, so keep it short.
+ */
+static constexpr int STICKER_BUSY_TIMEOUT_MS = 1000;
+
+/**
+ * The maximum number of objects in #sticker_cache.  When it is full,
+ * the whole cache is discarded.
+ */
+static constexpr size_t STICKER_CACHE_MAX = 65536;
+
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[G_N_ELEMENTS(sticker_sql)];
 
+/**
+ * The number of modifications in the current transaction, or 0 if
+ * there is no open transaction.
+ */
+static unsigned sticker_pending;
+
+/**
+ * A copy of the stickers of recently used objects, including those
+ * which have no stickers at all (which are the majority).  The key
+ * is the type and the URI, separated by a null byte.  All
+ * modifications are applied to the cache as well, so it never needs
+ * to be invalidated, except when a transaction fails.
+ */
+static std::unordered_map<std::string, sticker> sticker_cache;
+
+static void
+sticker_commit(void);
+
+class StickerCommitTimer final : private TimeoutMonitor {
+public:
+	StickerCommitTimer(EventLoop &_loop):TimeoutMonitor(_loop) {}
+
+	using TimeoutMonitor::Schedule;
+	using TimeoutMonitor::Cancel;
+
+private:
+	virtual void OnTimeout() override {
+		sticker_commit();
+	}
+};
+
+static StickerCommitTimer *sticker_commit_timer;
+
 static GQuark
 sticker_quark(void)
 {
@@ -122,6 +186,21 @@ sticker_global_init(const char *path, GError **error_r)
 		return false;
 	}
 
+	/* let SQLite wait for locks held by other processes instead
+	   of failing immediately; SQLITE_BUSY after that is an
+	   error */
+
+	sqlite3_busy_timeout(sticker_db, STICKER_BUSY_TIMEOUT_MS);
+
+	/* the write-ahead log makes commits cheaper and lets readers
+	   in other processes run concurrently with our transactions;
+	   failure is not fatal, SQLite versions older than 3.7 just
+	   keep the rollback journal */
+
+	sqlite3_exec(sticker_db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+	sqlite3_exec(sticker_db, "PRAGMA synchronous=NORMAL",
+		     NULL, NULL, NULL);
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create, NULL, NULL, NULL);
@@ -142,6 +221,8 @@ sticker_global_init(const char *path, GError **error_r)
 			return false;
 	}
 
+	sticker_commit_timer = new StickerCommitTimer(*main_loop);
+
 	return true;
 }
 
@@ -152,6 +233,12 @@ sticker_global_finish(void)
 		/* not configured */
 		return;
 
+	sticker_commit();
+	delete sticker_commit_timer;
+	sticker_commit_timer = NULL;
+
+	sticker_cache.clear();
+
 	for (unsigned i = 0; i < G_N_ELEMENTS(sticker_stmt); ++i) {
 		assert(sticker_stmt[i] != NULL);
 
@@ -167,65 +254,73 @@ sticker_enabled(void)
 	return sticker_db != NULL;
 }
 
-char *
-sticker_load_value(const char *type, const char *uri, const char *name)
+/**
+ * Commits the pending transaction (if any).
+ */
+static void
+sticker_commit(void)
 {
-	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_GET];
-	int ret;
-	char *value;
-
-	assert(sticker_enabled());
-	assert(type != NULL);
-	assert(uri != NULL);
-	assert(name != NULL);
-
-	if (*name == 0)
-		return NULL;
+	if (sticker_pending == 0)
+		return;
 
-	sqlite3_reset(stmt);
+	if (sticker_commit_timer != NULL)
+		sticker_commit_timer->Cancel();
 
-	ret = sqlite3_bind_text(stmt, 1, type, -1, NULL);
+	int ret = sqlite3_exec(sticker_db, "COMMIT", NULL, NULL, NULL);
 	if (ret != SQLITE_OK) {
-		g_warning("sqlite3_bind_text() failed: %s",
+		g_warning("Failed to commit sticker transaction: %s",
 			  sqlite3_errmsg(sticker_db));
-		return NULL;
-	}
 
-	ret = sqlite3_bind_text(stmt, 2, uri, -1, NULL);
-	if (ret != SQLITE_OK) {
-		g_warning("sqlite3_bind_text() failed: %s",
-			  sqlite3_errmsg(sticker_db));
-		return NULL;
-	}
+		/* a COMMIT which failed (e.g. with SQLITE_BUSY)
+		   leaves the transaction open; discard it, or the
+		   next BEGIN would fail and all further
+		   modifications would end up in this transaction */
+		if (!sqlite3_get_autocommit(sticker_db))
+			sqlite3_exec(sticker_db, "ROLLBACK",
+				     NULL, NULL, NULL);
+
+		/* the cache contains the modifications which were
+		   just rolled back */
+		sticker_cache.clear();
+	} else
+		g_debug("committed %u modifications", sticker_pending);
+
+	sticker_pending = 0;
+}
 
-	ret = sqlite3_bind_text(stmt, 3, name, -1, NULL);
-	if (ret != SQLITE_OK) {
-		g_warning("sqlite3_bind_text() failed: %s",
-			  sqlite3_errmsg(sticker_db));
-		return NULL;
-	}
+/**
+ * Called before a modification: opens a new transaction if there is
+ * none yet, and schedules its commit.
+ */
+static void
+sticker_begin_modify(void)
+{
+	assert(sticker_enabled());
 
-	do {
-		ret = sqlite3_step(stmt);
-	} while (ret == SQLITE_BUSY);
-
-	if (ret == SQLITE_ROW) {
-		/* record found */
-		value = g_strdup((const char*)sqlite3_column_text(stmt, 0));
-	} else if (ret == SQLITE_DONE) {
-		/* no record found */
-		value = NULL;
-	} else {
-		/* error */
-		g_warning("sqlite3_step() failed: %s",
-			  sqlite3_errmsg(sticker_db));
-		return NULL;
+	if (sticker_pending == 0) {
+		int ret = sqlite3_exec(sticker_db, "BEGIN", NULL, NULL, NULL);
+		if (ret != SQLITE_OK) {
+			/* fall back to autocommit */
+			g_warning("Failed to begin sticker transaction: %s",
+				  sqlite3_errmsg(sticker_db));
+			return;
+		}
+
+		sticker_commit_timer->Schedule(STICKER_COMMIT_DELAY_MS);
 	}
 
-	sqlite3_reset(stmt);
-	sqlite3_clear_bindings(stmt);
+	++sticker_pending;
+}
 
-	return value;
+/**
+ * Called after a modification: commits the transaction early if it
+ * has grown too large.
+ */
+static void
+sticker_end_modify(void)
+{
+	if (sticker_pending >= STICKER_COMMIT_MAX_PENDING)
+		sticker_commit();
 }
 
 static bool
@@ -268,9 +363,6 @@ sticker_list_values(std::map<std::string, std::string> &table,
 			break;
 		case SQLITE_DONE:
 			break;
-		case SQLITE_BUSY:
-			/* no op */
-			break;
 		default:
 			g_warning("sqlite3_step() failed: %s",
 				  sqlite3_errmsg(sticker_db));
@@ -284,6 +376,83 @@ sticker_list_values(std::map<std::string, std::string> &table,
 	return true;
 }
 
+static std::string
+sticker_cache_key(const char *type, const char *uri)
+{
+	std::string key(type);
+	key.push_back(0);
+	key.append(uri);
+	return key;
+}
+
+/**
+ * Returns the cached sticker of an object, loading it from the
+ * database if it is not in the cache yet.
+ *
+ * @return the sticker (possibly empty) or nullptr on error
+ */
+static const sticker *
+sticker_cache_get(const char *type, const char *uri)
+{
+	std::string key = sticker_cache_key(type, uri);
+
+	auto i = sticker_cache.find(key);
+	if (i != sticker_cache.end())
+		return &i->second;
+
+	sticker s;
+	if (!sticker_list_values(s.table, type, uri))
+		return nullptr;
+
+	if (sticker_cache.size() >= STICKER_CACHE_MAX)
+		sticker_cache.clear();
+
+	return &sticker_cache.insert(std::make_pair(std::move(key),
+						    std::move(s)))
+		.first->second;
+}
+
+/**
+ * Returns the cached sticker of an object, or nullptr if it is not
+ * in the cache.
+ */
+static sticker *
+sticker_cache_lookup(const char *type, const char *uri)
+{
+	auto i = sticker_cache.find(sticker_cache_key(type, uri));
+	return i != sticker_cache.end()
+		? &i->second
+		: nullptr;
+}
+
+static void
+sticker_cache_remove(const char *type, const char *uri)
+{
+	sticker_cache.erase(sticker_cache_key(type, uri));
+}
+
+char *
+sticker_load_value(const char *type, const char *uri, const char *name)
+{
+	assert(sticker_enabled());
+	assert(type != NULL);
+	assert(uri != NULL);
+	assert(name != NULL);
+
+	if (*name == 0)
+		return NULL;
+
+	const sticker *s = sticker_cache_get(type, uri);
+	if (s == nullptr)
+		return NULL;
+
+	auto i = s->table.find(name);
+	if (i == s->table.end())
+		return NULL;
+
+	return g_strdup(i->second.c_str());
+}
+
 static bool
 sticker_update_value(const char *type, const char *uri,
 		     const char *name, const char *value)
@@ -329,9 +498,7 @@ sticker_update_value(const char *type, const char *uri,
 		return false;
 	}
 
-	do {
-		ret = sqlite3_step(stmt);
-	} while (ret == SQLITE_BUSY);
+	ret = sqlite3_step(stmt);
 
 	if (ret != SQLITE_DONE) {
 		g_warning("sqlite3_step() failed: %s",
@@ -393,9 +560,7 @@ sticker_insert_value(const char *type, const char *uri,
 		return false;
 	}
 
-	do {
-		ret = sqlite3_step(stmt);
-	} while (ret == SQLITE_BUSY);
+	ret = sqlite3_step(stmt);
 
 	if (ret != SQLITE_DONE) {
 		g_warning("sqlite3_step() failed: %s",
@@ -424,8 +589,19 @@ sticker_store_value(const char *type, const char *uri,
 	if (*name == 0)
 		return false;
 
-	return sticker_update_value(type, uri, name, value) ||
+	sticker_begin_modify();
+	bool success = sticker_update_value(type, uri, name, value) ||
 		sticker_insert_value(type, uri, name, value);
+	sticker_end_modify();
+
+	if (success) {
+		sticker *s = sticker_cache_lookup(type, uri);
+		if (s != nullptr)
+			s->table[name] = value;
+	} else
+		sticker_cache_remove(type, uri);
+
+	return success;
 }
 
 bool
@@ -438,6 +614,10 @@ sticker_delete(const char *type, const char *uri)
 	assert(type != NULL);
 	assert(uri != NULL);
 
+	sticker_cache_remove(type, uri);
+
+	sticker_begin_modify();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, NULL);
@@ -454,9 +634,7 @@ sticker_delete(const char *type, const char *uri)
 		return false;
 	}
 
-	do {
-		ret = sqlite3_step(stmt);
-	} while (ret == SQLITE_BUSY);
+	ret = sqlite3_step(stmt);
 
 	if (ret != SQLITE_DONE) {
 		g_warning("sqlite3_step() failed: %s",
@@ -467,6 +645,8 @@ sticker_delete(const char *type, const char *uri)
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	sticker_end_modify();
+
 	idle_add(IDLE_STICKER);
 	return true;
 }
@@ -481,6 +661,8 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 	assert(type != NULL);
 	assert(uri != NULL);
 
+	sticker_begin_modify();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, NULL);
@@ -504,9 +686,7 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 		return false;
 	}
 
-	do {
-		ret = sqlite3_step(stmt);
-	} while (ret == SQLITE_BUSY);
+	ret = sqlite3_step(stmt);
 
 	if (ret != SQLITE_DONE) {
 		g_warning("sqlite3_step() failed: %s",
@@ -519,6 +699,12 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	sticker *s = sticker_cache_lookup(type, uri);
+	if (s != nullptr)
+		s->table.erase(name);
+
+	sticker_end_modify();
+
 	idle_add(IDLE_STICKER);
 	return ret > 0;
 }
@@ -552,16 +738,40 @@ sticker_foreach(const struct sticker *sticker,
 struct sticker *
 sticker_load(const char *type, const char *uri)
 {
-	sticker s;
-
-	if (!sticker_list_values(s.table, type, uri))
+	const sticker *s = sticker_cache_get(type, uri);
+	if (s == nullptr)
 		return NULL;
 
-	if (s.table.empty())
+	if (s->table.empty())
 		/* don't return empty sticker objects */
 		return NULL;
 
-	return new sticker(std::move(s));
+	return new sticker(*s);
+}
+
+/**
+ * Calculates the smallest string which is larger than all strings
+ * beginning with the specified prefix, to be used as the upper bound
+ * of a range query.
+ *
+ * @return false if there is no such bound (the prefix is empty or
+ * consists only of 0xff bytes)
+ */
+static bool
+sticker_prefix_end(const char *prefix, std::string &end)
+{
+	end = prefix;
+
+	while (!end.empty()) {
+		unsigned char last = end.back();
+		end.pop_back();
+		if (last != 0xff) {
+			end.push_back(last + 1);
+			return true;
+		}
+	}
+
+	return false;
 }
 
 bool
@@ -570,7 +780,6 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 			  gpointer user_data),
 	     gpointer user_data)
 {
-	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_FIND];
 	int ret;
 
 	assert(type != NULL);
@@ -578,6 +787,18 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 	assert(func != NULL);
 	assert(sticker_enabled());
 
+	if (base_uri == NULL)
+		base_uri = "";
+
+	/* a range query on "uri" can use the index, unlike the LIKE
+	   operator; note that it compares bytes, while LIKE ignored
+	   the case of ASCII letters */
+	std::string end;
+	const bool bounded = sticker_prefix_end(base_uri, end);
+	sqlite3_stmt *const stmt = bounded
+		? sticker_stmt[STICKER_SQL_FIND_RANGE]
+		: sticker_stmt[STICKER_SQL_FIND];
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, NULL);
@@ -587,23 +808,30 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 		return false;
 	}
 
-	if (base_uri == NULL)
-		base_uri = "";
-
-	ret = sqlite3_bind_text(stmt, 2, base_uri, -1, NULL);
+	ret = sqlite3_bind_text(stmt, 2, name, -1, NULL);
 	if (ret != SQLITE_OK) {
 		g_warning("sqlite3_bind_text() failed: %s",
 			  sqlite3_errmsg(sticker_db));
 		return false;
 	}
 
-	ret = sqlite3_bind_text(stmt, 3, name, -1, NULL);
+	ret = sqlite3_bind_text(stmt, 3, base_uri, -1, NULL);
 	if (ret != SQLITE_OK) {
 		g_warning("sqlite3_bind_text() failed: %s",
 			  sqlite3_errmsg(sticker_db));
 		return false;
 	}
 
+	if (bounded) {
+		ret = sqlite3_bind_text(stmt, 4, end.data(), end.length(),
+					NULL);
+		if (ret != SQLITE_OK) {
+			g_warning("sqlite3_bind_text() failed: %s",
+				  sqlite3_errmsg(sticker_db));
+			return false;
+		}
+	}
+
 	do {
 		ret = sqlite3_step(stmt);
 		switch (ret) {
@@ -614,9 +842,6 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 			break;
 		case SQLITE_DONE:
 			break;
-		case SQLITE_BUSY:
-			/* no op */
-			break;
 		default:
 			g_warning("sqlite3_step() failed: %s",
 				  sqlite3_errmsg(sticker_db));
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagCache.hxx"
+#include "SongSave.hxx"
+#include "TextFile.hxx"
+#include "ConfigGlobal.hxx"
+#include "ConfigOption.hxx"
+#include "song.h"
+#include "tag.h"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+
+#include <glib.h>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "tag_cache"
+
+#define TAG_CACHE_FORMAT "tag_cache_format: 1"
+
+/**
+ * The maximum number of files in the cache.  The tag items are
+ * shared with the database through the tag pool, so an entry costs
+ * little more than its key and the item array.
+ */
+static constexpr size_t TAG_CACHE_MAX = 128 * 1024;
+
+/**
+ * tag_cache_save() rewrites the whole file, so after a database
+ * update it does that only if at least 1/N of the entries were
+ * modified.  The rest is saved at shutdown.
+ */
+static constexpr size_t TAG_CACHE_SAVE_FRACTION = 16;
+
+struct TagCacheKey {
+	dev_t device;
+	ino_t inode;
+	off_t size;
+	time_t mtime;
+
+	TagCacheKey() = default;
+
+	explicit TagCacheKey(const struct stat &st)
+		:device(st.st_dev), inode(st.st_ino),
+		 size(st.st_size), mtime(st.st_mtime) {}
+
+	bool operator==(const TagCacheKey &other) const {
+		return inode == other.inode && device == other.device &&
+			size == other.size && mtime == other.mtime;
+	}
+
+	struct Hash {
+		gcc_pure
+		size_t operator()(const TagCacheKey &key) const {
+			size_t hash = (size_t)key.inode;
+			hash = hash * 31 + (size_t)key.device;
+			hash = hash * 31 + (size_t)key.size;
+			hash = hash * 31 + (size_t)key.mtime;
+			return hash;
+		}
+	};
+};
+
+typedef std::unordered_map<TagCacheKey, struct tag *,
+			   TagCacheKey::Hash> TagCacheMap;
+
+static TagCacheMap tag_cache_map;
+
+/**
+ * The keys in insertion order, for evicting the oldest entries.  It
+ * may contain keys which were removed from #tag_cache_map meanwhile.
+ */
+static std::deque<TagCacheKey> tag_cache_order;
+
+/**
+ * The path of the cache file (file system charset), or nullptr.
+ */
+static char *tag_cache_path;
+
+/**
+ * The number of modifications since the cache was loaded or saved.
+ */
+static size_t tag_cache_modified;
+
+static GQuark
+tag_cache_quark(void)
+{
+	return g_quark_from_static_string("tag_cache");
+}
+
+/**
+ * Removes stale and duplicate keys from #tag_cache_order.
+ */
+static void
+tag_cache_compact_order(void)
+{
+	std::unordered_set<TagCacheKey, TagCacheKey::Hash> seen;
+	std::deque<TagCacheKey> order;
+
+	for (const auto &key : tag_cache_order)
+		if (tag_cache_map.find(key) != tag_cache_map.end() &&
+		    seen.insert(key).second)
+			order.push_back(key);
+
+	tag_cache_order.swap(order);
+}
+
+/**
+ * Inserts a new entry, evicting the oldest entries if the cache is
+ * full.  Takes over the ownership of the tag object.
+ */
+static void
+tag_cache_insert(const TagCacheKey &key, struct tag *tag)
+{
+	auto result = tag_cache_map.insert(std::make_pair(key, tag));
+	if (!result.second) {
+		tag_free(result.first->second);
+		result.first->second = tag;
+		return;
+	}
+
+	tag_cache_order.push_back(key);
+
+	while (tag_cache_map.size() > TAG_CACHE_MAX) {
+		assert(!tag_cache_order.empty());
+
+		auto i = tag_cache_map.find(tag_cache_order.front());
+		tag_cache_order.pop_front();
+
+		if (i != tag_cache_map.end()) {
+			tag_free(i->second);
+			tag_cache_map.erase(i);
+		}
+	}
+
+	if (tag_cache_order.size() > 2 * TAG_CACHE_MAX)
+		tag_cache_compact_order();
+}
+
+static void
+tag_cache_clear(void)
+{
+	for (const auto &i : tag_cache_map)
+		tag_free(i.second);
+
+	tag_cache_map.clear();
+	tag_cache_order.clear();
+}
+
+static bool
+tag_cache_load(TextFile &file, GError **error_r)
+{
+	char *line = file.ReadLine();
+	if (line == NULL || strcmp(line, TAG_CACHE_FORMAT) != 0) {
+		g_set_error(error_r, tag_cache_quark(), 0,
+			    "Unrecognized tag cache format");
+		return false;
+	}
+
+	while ((line = file.ReadLine()) != NULL) {
+		if (!g_str_has_prefix(line, SONG_BEGIN)) {
+			g_set_error(error_r, tag_cache_quark(), 0,
+				    "Malformed line in tag cache: %s", line);
+			return false;
+		}
+
+		const char *name = line + sizeof(SONG_BEGIN) - 1;
+
+		unsigned long long device, inode, size;
+		long long mtime;
+		if (sscanf(name, "%llx:%llx:%llx:%llx",
+			   &device, &inode, &size, &mtime) != 4) {
+			g_set_error(error_r, tag_cache_quark(), 0,
+				    "Malformed key in tag cache: %s", name);
+			return false;
+		}
+
+		TagCacheKey key;
+		key.device = (dev_t)device;
+		key.inode = (ino_t)inode;
+		key.size = (off_t)size;
+		key.mtime = (time_t)mtime;
+
+		struct song *song = song_load(file, NULL, name, error_r);
+		if (song == NULL)
+			return false;
+
+		if (song->tag != NULL) {
+			tag_cache_insert(key, song->tag);
+			song->tag = NULL;
+		}
+
+		song_free(song);
+	}
+
+	return true;
+}
+
+void
+tag_cache_global_init(void)
+{
+	GError *error = NULL;
+	tag_cache_path = config_dup_path(CONF_TAG_CACHE_FILE, &error);
+	if (tag_cache_path == NULL) {
+		if (error != NULL) {
+			g_warning("%s", error->message);
+			g_error_free(error);
+		}
+
+		return;
+	}
+
+	TextFile file(Path::FromFS(tag_cache_path));
+	if (file.HasFailed()) {
+		if (errno != ENOENT)
+			g_warning("Failed to open %s: %s",
+				  tag_cache_path, g_strerror(errno));
+		return;
+	}
+
+	if (!tag_cache_load(file, &error)) {
+		g_warning("Failed to load %s: %s",
+			  tag_cache_path, error->message);
+		g_error_free(error);
+		tag_cache_clear();
+		return;
+	}
+
+	g_debug("loaded %u entries",
+		(unsigned)tag_cache_map.size());
+}
+
+void
+tag_cache_global_finish(void)
+{
+	tag_cache_clear();
+
+	g_free(tag_cache_path);
+	tag_cache_path = NULL;
+}
+
+struct tag *
+tag_cache_lookup(const struct stat &st)
+{
+	auto i = tag_cache_map.find(TagCacheKey(st));
+	if (i == tag_cache_map.end())
+		return NULL;
+
+	return tag_dup(i->second);
+}
+
+void
+tag_cache_store(const struct stat &st, const struct tag &tag)
+{
+	tag_cache_insert(TagCacheKey(st), tag_dup(&tag));
+	++tag_cache_modified;
+}
+
+void
+tag_cache_seed(const struct stat &st, const struct tag &tag)
+{
+	/* don't let seeding evict entries, or a library larger than
+	   the cache would replace its entries on every update */
+	if (tag_cache_map.size() >= TAG_CACHE_MAX)
+		return;
+
+	const TagCacheKey key(st);
+	if (tag_cache_map.find(key) != tag_cache_map.end())
+		return;
+
+	tag_cache_insert(key, tag_dup(&tag));
+	++tag_cache_modified;
+}
+
+void
+tag_cache_remove(const struct stat &st)
+{
+	auto i = tag_cache_map.find(TagCacheKey(st));
+	if (i != tag_cache_map.end()) {
+		tag_free(i->second);
+		tag_cache_map.erase(i);
+		++tag_cache_modified;
+	}
+}
+
+static void
+tag_cache_save_internal(FILE *fp)
+{
+	fprintf(fp, "%s\n", TAG_CACHE_FORMAT);
+
+	for (const auto &i : tag_cache_map) {
+		const TagCacheKey &key = i.first;
+
+		char name[96];
+		g_snprintf(name, sizeof(name), "%llx:%llx:%llx:%llx",
+			   (unsigned long long)key.device,
+			   (unsigned long long)key.inode,
+			   (unsigned long long)key.size,
+			   (long long)key.mtime);
+
+		/* borrow the tag for song_save() */
+		struct song *song = song_remote_new(name);
+		song->tag = i.second;
+		song_save(fp, song);
+		song->tag = NULL;
+		song_free(song);
+	}
+}
+
+bool
+tag_cache_save(bool force, GError **error_r)
+{
+	if (tag_cache_path == NULL || tag_cache_modified == 0)
+		return true;
+
+	if (!force &&
+	    tag_cache_modified * TAG_CACHE_SAVE_FRACTION < tag_cache_map.size())
+		return true;
+
+	/* write to a temporary file and rename it, so a crash doesn't
+	   leave a truncated cache */
+	char *tmp = g_strconcat(tag_cache_path, ".tmp", NULL);
+	const Path tmp_fs = Path::FromFS(tmp);
+	g_free(tmp);
+
+	FILE *fp = FOpen(tmp_fs, FOpenMode::WriteText);
+	if (fp == NULL) {
+		g_set_error(error_r, tag_cache_quark(), errno,
+			    "Failed to create %s: %s",
+			    tmp_fs.c_str(), g_strerror(errno));
+		return false;
+	}
+
+	tag_cache_save_internal(fp);
+
+	const bool failed = ferror(fp);
+	if (fclose(fp) != 0 || failed) {
+		g_set_error(error_r, tag_cache_quark(), errno,
+			    "Failed to write %s: %s",
+			    tmp_fs.c_str(), g_strerror(errno));
+		RemoveFile(tmp_fs);
+		return false;
+	}
+
+	if (!RenameFile(tmp_fs, Path::FromFS(tag_cache_path))) {
+		g_set_error(error_r, tag_cache_quark(), errno,
+			    "Failed to rename %s: %s",
+			    tmp_fs.c_str(), g_strerror(errno));
+		RemoveFile(tmp_fs);
+		return false;
+	}
+
+	g_debug("saved %u entries", (unsigned)tag_cache_map.size());
+	tag_cache_modified = 0;
+	return true;
+}
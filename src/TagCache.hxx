@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A cache of tags which were scanned by the decoder plugins, keyed
+ * by the identity of the file (device, inode, size and modification
+ * time).  When a file is renamed or moved within the same file
+ * system, the database update finds the new name, but the file's
+ * identity is unchanged, and its tags are copied from this cache
+ * instead of being scanned again.
+ *
+ * The cache is optionally saved to the file configured with
+ * "tag_cache_file", so it survives restarts.
+ *
+ * Except for tag_cache_global_init() and tag_cache_global_finish(),
+ * these functions may only be called from the update thread.
+ */
+
+#ifndef MPD_TAG_CACHE_HXX
+#define MPD_TAG_CACHE_HXX
+
+#include "gerror.h"
+
+#include <sys/stat.h>
+
+struct tag;
+
+/**
+ * Loads the configured cache file (if any).  Errors are logged, but
+ * not fatal.
+ */
+void
+tag_cache_global_init(void);
+
+void
+tag_cache_global_finish(void);
+
+/**
+ * Looks up the tags of a file.
+ *
+ * @return a copy of the tags (to be freed with tag_free()) or NULL
+ * if the file is not in the cache
+ */
+struct tag *
+tag_cache_lookup(const struct stat &st);
+
+/**
+ * Stores the tags of a file in the cache, replacing an older entry.
+ */
+void
+tag_cache_store(const struct stat &st, const struct tag &tag);
+
+/**
+ * Adds the tags of a song which is already in the database, unless
+ * the file is in the cache already or the cache is full.  This makes
+ * renames of files which were scanned before the cache existed
+ * cheap.
+ */
+void
+tag_cache_seed(const struct stat &st, const struct tag &tag);
+
+/**
+ * Removes a file from the cache.  This is used by "rescan", which
+ * must read the tags from the file again.
+ */
+void
+tag_cache_remove(const struct stat &st);
+
+/**
+ * Writes the cache to the configured file if it was modified since
+ * it was loaded or last saved.
+ *
+ * @param force if false, the file is only written if a noticeable
+ * part of the cache was modified
+ * @return true on success or if there is no cache file
+ */
+bool
+tag_cache_save(bool force, GError **error_r);
+
+#endif
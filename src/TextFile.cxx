@@ -23,6 +23,38 @@
 #include <assert.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+
+static inline char *
+ReadString(gzFile file, char *buffer, size_t size)
+{
+	return gzgets(file, buffer, size);
+}
+
+static bool
+HasError(gzFile file)
+{
+	int errnum;
+	gzerror(file, &errnum);
+	return errnum < 0;
+}
+
+#else
+
+static inline char *
+ReadString(FILE *file, char *buffer, size_t size)
+{
+	return fgets(buffer, size, file);
+}
+
+static inline bool
+HasError(FILE *file)
+{
+	return ferror(file);
+}
+
+#endif
+
 char *
 TextFile::ReadLine()
 {
@@ -34,10 +66,10 @@ TextFile::ReadLine()
 	assert(buffer->allocated_len >= step);
 
 	while (buffer->len < max_length) {
-		p = fgets(buffer->str + length,
-			  buffer->allocated_len - length, file);
+		p = ReadString(file, buffer->str + length,
+			       buffer->allocated_len - length);
 		if (p == NULL) {
-			if (length == 0 || ferror(file))
+			if (length == 0 || HasError(file))
 				return NULL;
 			break;
 		}
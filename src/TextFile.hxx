@@ -26,24 +26,44 @@
 
 #include <glib.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * Reads a text file line by line.  If MPD was compiled with zlib,
+ * gzip compressed files are decompressed transparently.
+ */
 class TextFile {
 	static constexpr size_t max_length = 512 * 1024;
 	static constexpr size_t step = 1024;
 
+#ifdef HAVE_ZLIB
+	const gzFile file;
+#else
 	FILE *const file;
+#endif
 
 	GString *const buffer;
 
 public:
 	TextFile(const Path &path_fs)
+#ifdef HAVE_ZLIB
+		:file(gzopen(path_fs.c_str(), "rb")),
+#else
 		:file(FOpen(path_fs, FOpenMode::ReadText)),
+#endif
 		 buffer(g_string_sized_new(step)) {}
 
 	TextFile(const TextFile &other) = delete;
 
 	~TextFile() {
 		if (file != nullptr)
+#ifdef HAVE_ZLIB
+			gzclose(file);
+#else
 			fclose(file);
+#endif
 
 		g_string_free(buffer, true);
 	}
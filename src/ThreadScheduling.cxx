@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ThreadScheduling.hxx"
+#include "ConfigGlobal.hxx"
+#include "ConfigData.hxx"
+#include "ConfigOption.hxx"
+#include "ConfigQuark.hxx"
+
+#ifndef WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "thread"
+
+enum thread_policy {
+	/**
+	 * Don't change the scheduling policy.
+	 */
+	THREAD_POLICY_DEFAULT,
+
+	THREAD_POLICY_OTHER,
+	THREAD_POLICY_BATCH,
+	THREAD_POLICY_IDLE,
+	THREAD_POLICY_FIFO,
+	THREAD_POLICY_RR,
+};
+
+struct thread_scheduling {
+	enum thread_policy policy;
+
+	/**
+	 * The real-time priority for #THREAD_POLICY_FIFO and
+	 * #THREAD_POLICY_RR.
+	 */
+	int priority;
+
+	bool nice_set;
+	int nice;
+
+	/**
+	 * A bit mask of CPU numbers this thread may run on; 0 means
+	 * "don't change".
+	 */
+	guint64 cpus;
+};
+
+static const char *const thread_class_names[N_THREAD_CLASSES] = {
+	"decoder",
+	"player",
+	"output",
+	"update",
+};
+
+static struct thread_scheduling thread_scheduling[N_THREAD_CLASSES];
+
+/**
+ * Was there any "thread" block?  If not, thread_scheduling_apply()
+ * doesn't touch anything.
+ */
+static bool thread_scheduling_configured;
+
+#ifndef WIN32
+
+/**
+ * The scheduling of the main thread at startup.  A new thread
+ * inherits the scheduling of the thread which created it, e.g. the
+ * decoder thread would run with the real-time policy of the player
+ * thread.  Therefore, attributes which are not configured for a
+ * class are reset to these values.
+ */
+static struct {
+	int policy;
+	struct sched_param param;
+
+#ifdef __linux__
+	int nice;
+	cpu_set_t cpus;
+#endif
+} thread_scheduling_initial;
+
+static void
+save_initial_scheduling(void)
+{
+	auto &initial = thread_scheduling_initial;
+
+	if (pthread_getschedparam(pthread_self(), &initial.policy,
+				  &initial.param) != 0) {
+		initial.policy = SCHED_OTHER;
+		memset(&initial.param, 0, sizeof(initial.param));
+	}
+
+#ifdef __linux__
+	errno = 0;
+	initial.nice = getpriority(PRIO_PROCESS, 0);
+	if (errno != 0)
+		initial.nice = 0;
+
+	if (pthread_getaffinity_np(pthread_self(), sizeof(initial.cpus),
+				   &initial.cpus) != 0) {
+		CPU_ZERO(&initial.cpus);
+		for (unsigned i = 0; i < CPU_SETSIZE; ++i)
+			CPU_SET(i, &initial.cpus);
+	}
+#endif
+}
+
+#endif
+
+static bool
+parse_thread_class(const char *name, enum thread_class *c_r)
+{
+	for (unsigned i = 0; i < N_THREAD_CLASSES; ++i) {
+		if (strcmp(name, thread_class_names[i]) == 0) {
+			*c_r = (enum thread_class)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+parse_thread_policy(const char *name, enum thread_policy *policy_r)
+{
+	static const struct {
+		const char *name;
+		enum thread_policy policy;
+	} policies[] = {
+		{ "other", THREAD_POLICY_OTHER },
+		{ "batch", THREAD_POLICY_BATCH },
+		{ "idle", THREAD_POLICY_IDLE },
+		{ "fifo", THREAD_POLICY_FIFO },
+		{ "rr", THREAD_POLICY_RR },
+	};
+
+	for (const auto &i : policies) {
+		if (strcmp(name, i.name) == 0) {
+			*policy_r = i.policy;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Parses a comma separated list of CPU numbers and ranges,
+ * e.g. "0,2-3".
+ */
+static bool
+parse_cpu_list(const char *s, guint64 *cpus_r)
+{
+	guint64 cpus = 0;
+
+	while (true) {
+		char *endptr;
+		unsigned long first = strtoul(s, &endptr, 10), last = first;
+		if (endptr == s)
+			return false;
+
+		s = endptr;
+		if (*s == '-') {
+			++s;
+			last = strtoul(s, &endptr, 10);
+			if (endptr == s || last < first)
+				return false;
+			s = endptr;
+		}
+
+		if (last >= 64)
+			return false;
+
+		for (unsigned long i = first; i <= last; ++i)
+			cpus |= guint64(1) << i;
+
+		while (*s == ' ')
+			++s;
+
+		if (*s == 0)
+			break;
+
+		if (*s != ',')
+			return false;
+
+		++s;
+		while (*s == ' ')
+			++s;
+	}
+
+	*cpus_r = cpus;
+	return true;
+}
+
+static bool
+thread_scheduling_configure(const struct config_param *param,
+			    GError **error_r)
+{
+	const char *name = config_get_block_string(param, "name", nullptr);
+	if (name == nullptr) {
+		g_set_error(error_r, config_quark(), 0,
+			    "Missing \"name\" in thread block at line %d",
+			    param->line);
+		return false;
+	}
+
+	enum thread_class c;
+	if (!parse_thread_class(name, &c)) {
+		g_set_error(error_r, config_quark(), 0,
+			    "Unknown thread \"%s\" at line %d",
+			    name, param->line);
+		return false;
+	}
+
+	struct thread_scheduling &ts = thread_scheduling[c];
+	thread_scheduling_configured = true;
+
+	const char *value = config_get_block_string(param, "policy", nullptr);
+	if (value != nullptr && !parse_thread_policy(value, &ts.policy)) {
+		g_set_error(error_r, config_quark(), 0,
+			    "Unknown scheduling policy \"%s\" at line %d",
+			    value, param->line);
+		return false;
+	}
+
+	const bool realtime = ts.policy == THREAD_POLICY_FIFO ||
+		ts.policy == THREAD_POLICY_RR;
+
+	ts.priority = config_get_block_unsigned(param, "priority",
+						realtime ? 1 : 0);
+	if (realtime ? (ts.priority < 1 || ts.priority > 99)
+	    : ts.priority != 0) {
+		g_set_error(error_r, config_quark(), 0,
+			    "\"priority\" must be 1..99 and requires policy "
+			    "\"fifo\" or \"rr\" at line %d",
+			    param->line);
+		return false;
+	}
+
+	value = config_get_block_string(param, "nice", nullptr);
+	if (value != nullptr) {
+		char *endptr;
+		long nice = strtol(value, &endptr, 10);
+		if (endptr == value || *endptr != 0 ||
+		    nice < -20 || nice > 19) {
+			g_set_error(error_r, config_quark(), 0,
+				    "Invalid nice value \"%s\" at line %d",
+				    value, param->line);
+			return false;
+		}
+
+		ts.nice_set = true;
+		ts.nice = nice;
+	}
+
+	value = config_get_block_string(param, "cpu_affinity", nullptr);
+	if (value != nullptr && !parse_cpu_list(value, &ts.cpus)) {
+		g_set_error(error_r, config_quark(), 0,
+			    "Invalid CPU list \"%s\" at line %d",
+			    value, param->line);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+thread_scheduling_global_init(GError **error_r)
+{
+	const struct config_param *param = nullptr;
+	while ((param = config_get_next_param(CONF_THREAD, param)) != nullptr)
+		if (!thread_scheduling_configure(param, error_r))
+			return false;
+
+#ifndef WIN32
+	if (thread_scheduling_configured)
+		save_initial_scheduling();
+#endif
+
+	return true;
+}
+
+#ifndef WIN32
+
+static bool
+apply_policy(enum thread_policy policy, int priority)
+{
+	int native;
+	switch (policy) {
+	case THREAD_POLICY_DEFAULT:
+		return true;
+
+	case THREAD_POLICY_OTHER:
+		native = SCHED_OTHER;
+		break;
+
+	case THREAD_POLICY_BATCH:
+#ifdef SCHED_BATCH
+		native = SCHED_BATCH;
+		break;
+#else
+		errno = ENOSYS;
+		return false;
+#endif
+
+	case THREAD_POLICY_IDLE:
+#ifdef SCHED_IDLE
+		native = SCHED_IDLE;
+		break;
+#else
+		errno = ENOSYS;
+		return false;
+#endif
+
+	case THREAD_POLICY_FIFO:
+		native = SCHED_FIFO;
+		break;
+
+	case THREAD_POLICY_RR:
+		native = SCHED_RR;
+		break;
+
+	default:
+		assert(false);
+		return true;
+	}
+
+	struct sched_param sp;
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = priority;
+
+	int result = pthread_setschedparam(pthread_self(), native, &sp);
+	if (result != 0) {
+		errno = result;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Resets the attributes which are not configured for this thread
+ * class to the values of the main thread at startup, undoing what
+ * was inherited from the creating thread.
+ */
+static void
+restore_initial_scheduling(const struct thread_scheduling &ts,
+			   const char *name)
+{
+	const auto &initial = thread_scheduling_initial;
+
+	if (ts.policy == THREAD_POLICY_DEFAULT) {
+		int policy;
+		struct sched_param sp;
+		if (pthread_getschedparam(pthread_self(), &policy, &sp) == 0 &&
+		    (policy != initial.policy ||
+		     sp.sched_priority != initial.param.sched_priority)) {
+			int result = pthread_setschedparam(pthread_self(),
+							   initial.policy,
+							   &initial.param);
+			if (result != 0)
+				g_warning("failed to reset the scheduling "
+					  "policy of the %s thread: %s",
+					  name, g_strerror(result));
+		}
+	}
+
+#ifdef __linux__
+	if (!ts.nice_set) {
+		errno = 0;
+		int nice = getpriority(PRIO_PROCESS, 0);
+		if (errno == 0 && nice != initial.nice &&
+		    setpriority(PRIO_PROCESS, 0, initial.nice) < 0)
+			g_warning("failed to reset the nice value of the %s "
+				  "thread: %s", name, g_strerror(errno));
+	}
+
+	if (ts.cpus == 0) {
+		int result = pthread_setaffinity_np(pthread_self(),
+						    sizeof(initial.cpus),
+						    &initial.cpus);
+		if (result != 0)
+			g_warning("failed to reset the CPU affinity of the %s "
+				  "thread: %s", name, g_strerror(result));
+	}
+#else
+	(void)name;
+#endif
+}
+
+#endif
+
+void
+thread_scheduling_apply(enum thread_class c)
+{
+	assert(c < N_THREAD_CLASSES);
+
+	if (!thread_scheduling_configured)
+		return;
+
+	const struct thread_scheduling &ts = thread_scheduling[c];
+	const char *name = thread_class_names[c];
+
+#ifdef WIN32
+	if (ts.policy != THREAD_POLICY_DEFAULT || ts.nice_set || ts.cpus != 0)
+		g_warning("thread scheduling is not supported on this "
+			  "platform (%s)", name);
+#else
+	restore_initial_scheduling(ts, name);
+
+	if (!apply_policy(ts.policy, ts.priority))
+		g_warning("failed to set the scheduling policy of the %s "
+			  "thread: %s", name, g_strerror(errno));
+
+	if (ts.nice_set) {
+#ifdef __linux__
+		/* on Linux, the nice value is a per-thread attribute,
+		   and "who=0" refers to the calling thread */
+		if (setpriority(PRIO_PROCESS, 0, ts.nice) < 0)
+			g_warning("failed to set the nice value of the %s "
+				  "thread: %s", name, g_strerror(errno));
+#else
+		g_warning("per-thread nice values are not supported on "
+			  "this platform (%s)", name);
+#endif
+	}
+
+	if (ts.cpus != 0) {
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (unsigned i = 0; i < 64; ++i)
+			if (ts.cpus & (guint64(1) << i))
+				CPU_SET(i, &set);
+
+		int result = pthread_setaffinity_np(pthread_self(),
+						    sizeof(set), &set);
+		if (result != 0)
+			g_warning("failed to set the CPU affinity of the %s "
+				  "thread: %s", name, g_strerror(result));
+#else
+		g_warning("CPU affinity is not supported on this "
+			  "platform (%s)", name);
+#endif
+	}
+#endif
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_SCHEDULING_HXX
+#define MPD_THREAD_SCHEDULING_HXX
+
+#include "gcc.h"
+
+#include <glib.h>
+
+/**
+ * The classes of threads whose scheduling parameters can be
+ * configured with a "thread" block.
+ */
+enum thread_class {
+	THREAD_CLASS_DECODER,
+	THREAD_CLASS_PLAYER,
+	THREAD_CLASS_OUTPUT,
+	THREAD_CLASS_UPDATE,
+
+	N_THREAD_CLASSES,
+};
+
+/**
+ * Parses all "thread" blocks from the configuration.
+ *
+ * @return false on error
+ */
+bool
+thread_scheduling_global_init(GError **error_r);
+
+/**
+ * Applies the configured scheduling policy, priority, nice level
+ * and CPU affinity to the calling thread.  This is called by each
+ * thread right after it has been started.  Attributes which are not
+ * configured for this class are reset to those of the main thread at
+ * startup instead of being inherited from the creating thread.
+ * Failures (e.g. missing privileges) are logged, but are not fatal.
+ */
+void
+thread_scheduling_apply(enum thread_class c);
+
+#endif
@@ -22,10 +22,12 @@
 #include "UpdateQueue.hxx"
 #include "UpdateWalk.hxx"
 #include "UpdateRemove.hxx"
+#include "TagCache.hxx"
 #include "Mapper.hxx"
 #include "DatabaseSimple.hxx"
 #include "Idle.hxx"
 #include "GlobalEvents.hxx"
+#include "ThreadScheduling.hxx"
 
 extern "C" {
 #include "stats.h"
@@ -37,6 +39,8 @@ extern "C" {
 
 #include <glib.h>
 
+#include <atomic>
+
 #include <assert.h>
 
 #undef G_LOG_DOMAIN
@@ -59,56 +63,100 @@ static unsigned update_task_id;
 /* XXX this flag is passed to update_task() */
 static bool discard;
 
+/**
+ * Shall update_task() save the database and the tag cache?  This is
+ * only done by the last job in the queue.
+ */
+static bool save;
+
+/**
+ * Was the database modified by a job which did not save it?  Read
+ * by update_global_flush() while the update thread may be running.
+ */
+static std::atomic_bool unsaved;
+
 unsigned
 isUpdatingDB(void)
 {
 	return (progress != UPDATE_PROGRESS_IDLE) ? update_task_id : 0;
 }
 
-static void * update_task(void *_path)
+static void
+update_log_paths(const char *what, char *const*paths)
 {
-	const char *path = (const char *)_path;
-
-	if (path != NULL && *path != 0)
-		g_debug("starting: %s", path);
+	if (paths[0] != NULL && paths[1] != NULL)
+		g_debug("%s: %u paths", what, g_strv_length((char **)paths));
+	else if (paths[0] != NULL && *paths[0] != 0)
+		g_debug("%s: %s", what, paths[0]);
 	else
-		g_debug("starting");
+		g_debug("%s", what);
+}
+
+static void * update_task(void *_paths)
+{
+	char **paths = (char **)_paths;
+
+	thread_scheduling_apply(THREAD_CLASS_UPDATE);
+
+	update_log_paths("starting", paths);
 
-	modified = update_walk(path, discard);
+	for (char **p = paths; *p != NULL; ++p)
+		if (update_walk(*p, discard))
+			modified = true;
+
+	if (modified)
+		unsaved = true;
+
+	/* saving the database and the tag cache rewrites both files;
+	   postpone that until the last queued job is done */
+	if (save) {
+		if (unsaved || !db_exists()) {
+			GError *error = NULL;
+			if (!db_save(&error)) {
+				g_warning("Failed to save database: %s",
+					  error->message);
+				g_error_free(error);
+			}
+		}
 
-	if (modified || !db_exists()) {
 		GError *error = NULL;
-		if (!db_save(&error)) {
-			g_warning("Failed to save database: %s",
+		if (!tag_cache_save(false, &error)) {
+			g_warning("Failed to save tag cache: %s",
 				  error->message);
 			g_error_free(error);
 		}
+
+		unsaved = false;
 	}
 
-	if (path != NULL && *path != 0)
-		g_debug("finished: %s", path);
-	else
-		g_debug("finished");
-	g_free(_path);
+	update_log_paths("finished", paths);
+	g_strfreev(paths);
 
 	progress = UPDATE_PROGRESS_DONE;
 	GlobalEvents::Emit(GlobalEvents::UPDATE);
 	return NULL;
 }
 
+/**
+ * Starts the update thread.
+ *
+ * @param paths a NULL terminated list of paths, which is freed by
+ * the update thread
+ */
 static void
-spawn_update_task(const char *path)
+spawn_update_task(char **paths)
 {
 	assert(g_thread_self() == main_task);
 
 	progress = UPDATE_PROGRESS_RUNNING;
 	modified = false;
+	save = update_queue_is_empty();
 
 #if GLIB_CHECK_VERSION(2,32,0)
-	update_thr = g_thread_new("updadte", update_task, g_strdup(path));
+	update_thr = g_thread_new("updadte", update_task, paths);
 #else
 	GError *e = NULL;
-	update_thr = g_thread_create(update_task, g_strdup(path), TRUE, &e);
+	update_thr = g_thread_create(update_task, paths, TRUE, &e);
 	if (update_thr == NULL)
 		MPD_ERROR("Failed to spawn update task: %s", e->message);
 #endif
@@ -135,8 +183,45 @@ update_enqueue(const char *path, bool _discard)
 		return next_task_id > update_task_id_max ?  1 : next_task_id;
 	}
 
+	char **paths = g_new(char *, 2);
+	paths[0] = g_strdup(path != NULL ? path : "");
+	paths[1] = NULL;
+
 	discard = _discard;
-	spawn_update_task(path);
+	spawn_update_task(paths);
+
+	idle_add(IDLE_UPDATE);
+
+	return update_task_id;
+}
+
+unsigned
+update_enqueue_batch(const std::list<std::string> &uris)
+{
+	assert(g_thread_self() == main_task);
+	assert(!uris.empty());
+
+	if (!db_is_simple() || !mapper_has_music_directory())
+		return 0;
+
+	char **paths = g_new(char *, uris.size() + 1);
+	unsigned n = 0;
+	for (const auto &uri : uris)
+		paths[n++] = g_strdup(uri.c_str());
+	paths[n] = NULL;
+
+	if (progress != UPDATE_PROGRESS_IDLE) {
+		unsigned next_task_id =
+			update_queue_push_batch(paths, update_task_id);
+		g_strfreev(paths);
+		if (next_task_id == 0)
+			return 0;
+
+		return next_task_id > update_task_id_max ?  1 : next_task_id;
+	}
+
+	discard = false;
+	spawn_update_task(paths);
 
 	idle_add(IDLE_UPDATE);
 
@@ -148,7 +233,7 @@ update_enqueue(const char *path, bool _discard)
  */
 static void update_finished_event(void)
 {
-	char *path;
+	char **paths;
 
 	assert(progress == UPDATE_PROGRESS_DONE);
 
@@ -160,11 +245,10 @@ static void update_finished_event(void)
 		/* send "idle" events */
 		instance->DatabaseModified();
 
-	path = update_queue_shift(&discard);
-	if (path != NULL) {
-		/* schedule the next path */
-		spawn_update_task(path);
-		g_free(path);
+	paths = update_queue_shift(&discard);
+	if (paths != NULL) {
+		/* schedule the next job */
+		spawn_update_task(paths);
 	} else {
 		progress = UPDATE_PROGRESS_IDLE;
 
@@ -172,15 +256,57 @@ static void update_finished_event(void)
 	}
 }
 
+void
+update_global_flush(void)
+{
+	assert(g_thread_self() == main_task);
+
+	if (progress == UPDATE_PROGRESS_RUNNING && !unsaved)
+		/* nothing to save; don't wait for the running job,
+		   its modifications are lost anyway */
+		return;
+
+	if (progress != UPDATE_PROGRESS_IDLE) {
+		/* the database must not be saved while the update
+		   thread modifies it */
+		g_message("waiting for the database update to finish");
+		g_thread_join(update_thr);
+		progress = UPDATE_PROGRESS_IDLE;
+	}
+
+	if (unsaved) {
+		GError *error = NULL;
+		if (!db_save(&error)) {
+			g_warning("Failed to save database: %s",
+				  error->message);
+			g_error_free(error);
+		}
+
+		unsaved = false;
+	}
+}
+
 void update_global_init(void)
 {
 	GlobalEvents::Register(GlobalEvents::UPDATE, update_finished_event);
 
 	update_remove_global_init();
 	update_walk_global_init();
+	tag_cache_global_init();
 }
 
 void update_global_finish(void)
 {
+	if (progress == UPDATE_PROGRESS_IDLE) {
+		/* write what update_task() has postponed */
+		GError *error = NULL;
+		if (!tag_cache_save(true, &error)) {
+			g_warning("Failed to save tag cache: %s",
+				  error->message);
+			g_error_free(error);
+		}
+	}
+
+	tag_cache_global_finish();
 	update_walk_global_finish();
 }
@@ -20,10 +20,22 @@
 #ifndef MPD_UPDATE_GLUE_HXX
 #define MPD_UPDATE_GLUE_HXX
 
+#include <list>
+#include <string>
+
 void update_global_init(void);
 
 void update_global_finish(void);
 
+/**
+ * Saves the database if update jobs have modified it without saving
+ * (see update_enqueue_batch()).  If a job is still running, this
+ * waits for it to finish.  Called at shutdown, before the database
+ * is closed.
+ */
+void
+update_global_flush(void);
+
 unsigned
 isUpdatingDB(void);
 
@@ -37,4 +49,16 @@ isUpdatingDB(void);
 unsigned
 update_enqueue(const char *path, bool discard);
 
+/**
+ * Add a job which updates all of the specified paths, and saves the
+ * database only once at the end.  If the last queued job was added
+ * by this function as well, the paths are merged into it.
+ *
+ * @param uris a non-empty list of paths relative to the music
+ * directory
+ * @return the job id, or 0 on error
+ */
+unsigned
+update_enqueue_batch(const std::list<std::string> &uris);
+
 #endif
@@ -27,8 +27,19 @@
 
 /* make this dynamic?, or maybe this is big enough... */
 static struct {
-	char *path;
+	/**
+	 * A NULL terminated list of paths; "" is the whole music
+	 * directory.
+	 */
+	char **paths;
+
 	bool discard;
+
+	/**
+	 * May update_queue_push_batch() append more paths to this
+	 * job?
+	 */
+	bool batch;
 } update_queue[32];
 
 static size_t update_queue_length;
@@ -41,26 +52,86 @@ update_queue_push(const char *path, bool discard, unsigned base)
 	if (update_queue_length == G_N_ELEMENTS(update_queue))
 		return 0;
 
-	update_queue[update_queue_length].path = g_strdup(path);
+	char **paths = g_new(char *, 2);
+	paths[0] = g_strdup(path != NULL ? path : "");
+	paths[1] = NULL;
+
+	update_queue[update_queue_length].paths = paths;
 	update_queue[update_queue_length].discard = discard;
+	update_queue[update_queue_length].batch = false;
+
+	++update_queue_length;
+
+	return base + update_queue_length;
+}
+
+unsigned
+update_queue_push_batch(const char *const*paths, unsigned base)
+{
+	assert(update_queue_length <= G_N_ELEMENTS(update_queue));
+
+	if (update_queue_length > 0 &&
+	    update_queue[update_queue_length - 1].batch) {
+		/* append to the last job */
+		char **old = update_queue[update_queue_length - 1].paths;
+		const unsigned old_length = g_strv_length(old);
+		const unsigned n = g_strv_length((char **)paths);
+
+		char **merged = g_new(char *, old_length + n + 1);
+		unsigned length = 0;
+		for (unsigned i = 0; i < old_length; ++i)
+			merged[length++] = old[i];
+
+		for (unsigned i = 0; i < n; ++i) {
+			bool duplicate = false;
+			for (unsigned j = 0; j < old_length; ++j)
+				if (strcmp(old[j], paths[i]) == 0)
+					duplicate = true;
+
+			if (!duplicate)
+				merged[length++] = g_strdup(paths[i]);
+		}
+
+		merged[length] = NULL;
+
+		/* the strings have been moved to the new array */
+		g_free(old);
+		update_queue[update_queue_length - 1].paths = merged;
+
+		return base + update_queue_length;
+	}
+
+	if (update_queue_length == G_N_ELEMENTS(update_queue))
+		return 0;
+
+	update_queue[update_queue_length].paths =
+		g_strdupv((char **)paths);
+	update_queue[update_queue_length].discard = false;
+	update_queue[update_queue_length].batch = true;
 
 	++update_queue_length;
 
 	return base + update_queue_length;
 }
 
-char *
+char **
 update_queue_shift(bool *discard_r)
 {
-	char *path;
+	char **paths;
 
 	if (update_queue_length == 0)
 		return NULL;
 
-	path = update_queue[0].path;
+	paths = update_queue[0].paths;
 	*discard_r = update_queue[0].discard;
 
 	memmove(&update_queue[0], &update_queue[1],
 		--update_queue_length * sizeof(update_queue[0]));
-	return path;
+	return paths;
+}
+
+bool
+update_queue_is_empty(void)
+{
+	return update_queue_length == 0;
 }
@@ -21,11 +21,32 @@
 #define MPD_UPDATE_QUEUE_HXX
 
 #include "check.h"
+#include "gcc.h"
 
 unsigned
 update_queue_push(const char *path, bool discard, unsigned base);
 
-char *
+/**
+ * Adds a job which updates several paths.  If the last job in the
+ * queue was added by this function as well, the paths are appended
+ * to it instead.
+ *
+ * @param paths a NULL terminated list of paths
+ */
+unsigned
+update_queue_push_batch(const char *const*paths, unsigned base);
+
+/**
+ * Removes the first job from the queue.
+ *
+ * @return a NULL terminated list of paths (to be freed with
+ * g_strfreev()), or NULL if the queue is empty
+ */
+char **
 update_queue_shift(bool *discard_r);
 
+gcc_pure
+bool
+update_queue_is_empty(void);
+
 #endif
@@ -25,6 +25,8 @@
 #include "UpdateContainer.hxx"
 #include "DatabaseLock.hxx"
 #include "Directory.hxx"
+#include "DatabaseCounters.hxx"
+#include "TagCache.hxx"
 #include "song.h"
 #include "decoder_plugin.h"
 #include "DecoderList.hxx"
@@ -85,7 +87,27 @@ update_song_file2(Directory *directory,
 	} else if (st->st_mtime != song->mtime || walk_discard) {
 		g_message("updating %s/%s",
 			  directory->GetPath(), name);
-		if (!song_file_update(song)) {
+
+		if (walk_discard)
+			/* "rescan" means: really read the file again */
+			tag_cache_remove(*st);
+
+		/* the counters must forget the old tag before it is
+		   replaced */
+		db_lock();
+		DatabaseCounters *counters = directory->GetCounters();
+		if (counters != nullptr)
+			counters->Remove(*song);
+		db_unlock();
+
+		const bool success = song_file_update(song);
+
+		db_lock();
+		if (counters != nullptr)
+			counters->Add(*song);
+		db_unlock();
+
+		if (!success) {
 			g_debug("deleting unrecognized file %s/%s",
 				directory->GetPath(), name);
 			db_lock();
@@ -94,7 +116,10 @@ update_song_file2(Directory *directory,
 		}
 
 		modified = true;
-	}
+	} else if (song->tag != NULL)
+		/* unchanged; remember its tags in case the file gets
+		   renamed */
+		tag_cache_seed(*st, *song->tag);
 }
 
 bool
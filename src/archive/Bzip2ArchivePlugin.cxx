@@ -30,9 +30,19 @@
 #include "InputStream.hxx"
 #include "InputPlugin.hxx"
 #include "util/RefCount.hxx"
+#include "io_error.h"
+#include "gcc.h"
 
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <assert.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <glib.h>
 #include <bzlib.h>
@@ -42,17 +52,194 @@
 #define BZ2_bzDecompress bzDecompress
 #endif
 
+/**
+ * The position of one bzip2 block within the compressed file.
+ */
+struct Bzip2Block {
+	/**
+	 * The position of the block magic, in bits.
+	 */
+	uint64_t begin;
+
+	/**
+	 * The position of the next block magic or end-of-stream
+	 * marker, in bits.
+	 */
+	uint64_t end;
+
+	Bzip2Block(uint64_t _begin):begin(_begin), end(0) {}
+};
+
+/**
+ * An index of the blocks in a bzip2 file.  Each block can be
+ * decompressed independently, which allows seeking without
+ * decompressing everything from the start.
+ *
+ * The block boundaries within the compressed file are determined by
+ * scanning for the block magic.  The scan is incremental: it only
+ * proceeds as far as the blocks which are actually being read, so
+ * opening an archive doesn't read the whole file.  The uncompressed
+ * offset of each block is only known once its predecessor has been
+ * decompressed; these offsets are learned lazily while reading and
+ * seeking.
+ */
+class Bzip2Index {
+	RefCount ref;
+
+public:
+	/**
+	 * The size and modification time of the compressed file; used
+	 * to check whether the cached index is still valid.
+	 */
+	const goffset compressed_size;
+	const time_t mtime;
+
+private:
+	mutable Mutex mutex;
+
+	/**
+	 * The blocks found so far.  Protected by #mutex.
+	 */
+	std::vector<Bzip2Block> blocks;
+
+	/**
+	 * The uncompressed offset of each block.  Only the first
+	 * elements are known; the element after the last block is
+	 * the total uncompressed size.  Protected by #mutex.
+	 */
+	std::vector<goffset> offsets;
+
+	/**
+	 * The state of the block scanner: the last 64 bits which
+	 * were read, and the number of bits read so far.  Protected
+	 * by #mutex.
+	 */
+	uint64_t scan_window, scan_position;
+
+	/**
+	 * Is the scanner within a block, i.e. is the end of
+	 * blocks.back() not yet known?
+	 */
+	bool scan_in_block;
+
+	/**
+	 * Has the scanner reached the end of the compressed file?
+	 */
+	bool scan_complete;
+
+public:
+	Bzip2Index(goffset _compressed_size, time_t _mtime)
+		:compressed_size(_compressed_size), mtime(_mtime),
+		 scan_window(0), scan_position(0),
+		 scan_in_block(false), scan_complete(false) {
+		offsets.push_back(0);
+	}
+
+	void Ref() {
+		ref.Increment();
+	}
+
+	void Unref() {
+		if (ref.Decrement())
+			delete this;
+	}
+
+	/**
+	 * Looks up a block, and scans more of the compressed file if
+	 * its boundaries are not yet known.
+	 *
+	 * @param is the compressed file; the caller must not lock
+	 * its mutex
+	 * @return false on error or if there is no such block (i.e.
+	 * the end of the file); only in the former case, the #GError
+	 * is set
+	 */
+	bool GetBlock(struct input_stream *is, unsigned i,
+		      Bzip2Block &block_r, GError **error_r);
+
+	/**
+	 * Find the last block whose uncompressed offset is known and
+	 * not greater than the specified offset.
+	 *
+	 * @return the block number (which may be the number of
+	 * blocks if the offset is at the end of the uncompressed
+	 * data)
+	 */
+	unsigned FindBlock(goffset offset, goffset *block_offset_r) const {
+		const ScopeLock protect(mutex);
+
+		auto i = std::upper_bound(offsets.begin(), offsets.end(),
+					  offset);
+		assert(i != offsets.begin());
+		--i;
+
+		*block_offset_r = *i;
+		return i - offsets.begin();
+	}
+
+	/**
+	 * Remember the uncompressed offset of a block, after its
+	 * predecessor has been decompressed.
+	 */
+	void SetOffset(unsigned i, goffset offset) {
+		assert(i > 0);
+
+		const ScopeLock protect(mutex);
+
+		assert(i <= blocks.size());
+
+		if (i == offsets.size())
+			offsets.push_back(offset);
+		else
+			assert(i < offsets.size() && offsets[i] == offset);
+	}
+
+	/**
+	 * @return the total uncompressed size, or -1 if it is not yet
+	 * known
+	 */
+	goffset GetSize() const {
+		const ScopeLock protect(mutex);
+
+		return scan_complete && offsets.size() > blocks.size()
+			? offsets.back()
+			: -1;
+	}
+
+private:
+	/**
+	 * Reads the next chunk of the compressed file and scans it
+	 * for block magics and end-of-stream markers.  Caller must
+	 * lock #mutex.
+	 */
+	bool ScanMore(struct input_stream *is, GError **error_r);
+};
+
 class Bzip2ArchiveFile final : public ArchiveFile {
 public:
 	RefCount ref;
 
+	const std::string path;
+
 	char *const name;
 	struct input_stream *const istream;
 
-	Bzip2ArchiveFile(const char *path, input_stream *_is)
+	/**
+	 * The modification time of the compressed file.
+	 */
+	const time_t mtime;
+
+	/**
+	 * The block index, obtained by the first OpenStream() call.
+	 */
+	Bzip2Index *index;
+
+	Bzip2ArchiveFile(const char *_path, input_stream *_is,
+			 time_t _mtime)
 		:ArchiveFile(bz2_archive_plugin),
-		 name(g_path_get_basename(path)),
-		 istream(_is) {
+		 path(_path),
+		 name(g_path_get_basename(_path)),
+		 istream(_is), mtime(_mtime), index(nullptr) {
 		// remove .bz2 suffix
 		size_t len = strlen(name);
 		if (len > 4)
@@ -60,6 +247,9 @@ public:
 	}
 
 	~Bzip2ArchiveFile() {
+		if (index != nullptr)
+			index->Unref();
+
 		input_stream_close(istream);
 	}
 
@@ -75,6 +265,12 @@ public:
 		delete this;
 	}
 
+	/**
+	 * Obtains the block index from the cache, or creates a new
+	 * (empty) one.
+	 */
+	Bzip2Index &GetIndex();
+
 	virtual void Close() override {
 		Unref();
 	}
@@ -93,18 +289,50 @@ struct Bzip2InputStream {
 
 	Bzip2ArchiveFile *archive;
 
+	Bzip2Index &index;
+
 	bool eof;
 
+	/**
+	 * The block which is currently being decompressed into
+	 * #bzstream.
+	 */
+	unsigned current_block;
+
+	/**
+	 * Is #bzstream initialized with #current_block?
+	 */
+	bool block_open;
+
 	bz_stream bzstream;
 
-	char buffer[5000];
+	/**
+	 * The current block, converted to a standalone bzip2 stream.
+	 */
+	std::vector<char> block_buffer;
 
-	Bzip2InputStream(Bzip2ArchiveFile &context, const char *uri,
+	Bzip2InputStream(Bzip2ArchiveFile &context, Bzip2Index &index,
+			 const char *uri,
 			 Mutex &mutex, Cond &cond);
 	~Bzip2InputStream();
 
-	bool Open(GError **error_r);
+	void Open();
 	void Close();
+
+	/**
+	 * Looks up block #i in the index and opens it.
+	 *
+	 * @return false on error or if there is no such block (i.e.
+	 * the end of the file); only in the former case, the #GError
+	 * is set
+	 */
+	bool OpenBlock(unsigned i, GError **error_r);
+	void CloseBlock();
+
+	size_t Read(void *ptr, size_t length, GError **error_r);
+	bool Skip(goffset nbytes, GError **error_r);
+	bool SkipToEnd(GError **error_r);
+	bool Seek(goffset offset, GError **error_r);
 };
 
 extern const struct input_plugin bz2_inputplugin;
@@ -115,17 +343,305 @@ bz2_quark(void)
 	return g_quark_from_static_string("bz2");
 }
 
+static constexpr uint64_t BZ2_BLOCK_MAGIC = 0x314159265359ULL;
+static constexpr uint64_t BZ2_EOS_MAGIC = 0x177245385090ULL;
+static constexpr uint64_t BZ2_MAGIC_MASK = (1ULL << 48) - 1;
+
+/**
+ * The maximum number of indexes kept in #bz2_index_cache.
+ */
+static constexpr unsigned BZ2_INDEX_CACHE_SIZE = 16;
+
+/**
+ * The number of bytes read by one Bzip2Index::ScanMore() call.
+ */
+static constexpr size_t BZ2_SCAN_CHUNK = 65536;
+
+static Mutex bz2_index_cache_mutex;
+
+/**
+ * Block indexes of recently opened archives, the most recently used
+ * first.  The cache holds a reference to each index.  Protected by
+ * #bz2_index_cache_mutex.
+ */
+static std::list<std::pair<std::string, Bzip2Index *>> bz2_index_cache;
+
+/**
+ * Scan for block magics and end-of-stream markers.  Both are 48 bit
+ * values which are not aligned to byte boundaries.
+ */
+bool
+Bzip2Index::ScanMore(struct input_stream *is, GError **error_r)
+{
+	assert(!scan_complete);
+	assert(scan_position % 8 == 0);
+
+	unsigned char buffer[BZ2_SCAN_CHUNK];
+	size_t nbytes;
+
+	{
+		/* the stream is shared by all entries of the
+		   archive, and its plugin (e.g. "file" with
+		   read-ahead) expects the caller to hold the
+		   mutex */
+		const ScopeLock protect(is->mutex);
+
+		if (!input_stream_seek(is, scan_position / 8, SEEK_SET,
+				       error_r))
+			return false;
+
+		GError *error = nullptr;
+		nbytes = input_stream_read(is, buffer, sizeof(buffer),
+					   &error);
+		if (nbytes == 0 && error != nullptr) {
+			g_propagate_error(error_r, error);
+			return false;
+		}
+	}
+
+	if (nbytes == 0) {
+		/* end of file; a block without an end is reported
+		   by GetBlock() */
+		scan_complete = true;
+		return true;
+	}
+
+	for (size_t i = 0; i < nbytes; ++i) {
+		for (int bit = 7; bit >= 0; --bit) {
+			scan_window = (scan_window << 1) |
+				((buffer[i] >> bit) & 1);
+			++scan_position;
+
+			const uint64_t magic = scan_window & BZ2_MAGIC_MASK;
+			if (gcc_likely(magic != BZ2_BLOCK_MAGIC &&
+				       magic != BZ2_EOS_MAGIC) ||
+			    scan_position < 48)
+				continue;
+
+			if (scan_in_block)
+				blocks.back().end = scan_position - 48;
+
+			scan_in_block = magic == BZ2_BLOCK_MAGIC;
+			if (scan_in_block)
+				blocks.push_back(Bzip2Block(scan_position - 48));
+		}
+	}
+
+	return true;
+}
+
+bool
+Bzip2Index::GetBlock(struct input_stream *is, unsigned i,
+		     Bzip2Block &block_r, GError **error_r)
+{
+	const ScopeLock protect(mutex);
+
+	while (!scan_complete &&
+	       (i >= blocks.size() || blocks[i].end == 0))
+		if (!ScanMore(is, error_r))
+			return false;
+
+	if (i >= blocks.size())
+		return false;
+
+	if (blocks[i].end == 0) {
+		g_set_error(error_r, bz2_quark(), 0,
+			    "Truncated bzip2 file");
+		return false;
+	}
+
+	block_r = blocks[i];
+	return true;
+}
+
+Bzip2Index &
+Bzip2ArchiveFile::GetIndex()
+{
+	if (index != nullptr)
+		return *index;
+
+	const goffset size = input_stream_get_size(istream);
+
+	const ScopeLock protect(bz2_index_cache_mutex);
+
+	for (auto i = bz2_index_cache.begin(), end = bz2_index_cache.end();
+	     i != end; ++i) {
+		if (i->first != path)
+			continue;
+
+		if (i->second->compressed_size == size &&
+		    i->second->mtime == mtime) {
+			/* move to the front of the LRU list */
+			bz2_index_cache.splice(bz2_index_cache.begin(),
+					       bz2_index_cache, i);
+			index = i->second;
+			index->Ref();
+			return *index;
+		}
+
+		/* the file was modified */
+		i->second->Unref();
+		bz2_index_cache.erase(i);
+		break;
+	}
+
+	if (bz2_index_cache.size() >= BZ2_INDEX_CACHE_SIZE) {
+		/* evict the least recently used index */
+		bz2_index_cache.back().second->Unref();
+		bz2_index_cache.pop_back();
+	}
+
+	index = new Bzip2Index(size, mtime);
+	index->Ref();
+	bz2_index_cache.push_front(std::make_pair(path, index));
+	return *index;
+}
+
+static void
+bz2_finish(void)
+{
+	for (const auto &i : bz2_index_cache)
+		i.second->Unref();
+	bz2_index_cache.clear();
+}
+
+/**
+ * Appends bits to a byte buffer, most significant bit first.
+ */
+class Bzip2BitWriter {
+	std::vector<char> &buffer;
+	unsigned char current;
+	unsigned n;
+
+public:
+	Bzip2BitWriter(std::vector<char> &_buffer)
+		:buffer(_buffer), current(0), n(0) {}
+
+	void WriteBit(unsigned bit) {
+		current = (current << 1) | bit;
+		if (++n == 8) {
+			buffer.push_back(current);
+			current = 0;
+			n = 0;
+		}
+	}
+
+	void Write(uint64_t value, unsigned nbits) {
+		while (nbits-- > 0)
+			WriteBit(unsigned(value >> nbits) & 1);
+	}
+
+	void Flush() {
+		if (n > 0) {
+			buffer.push_back(current << (8 - n));
+			current = 0;
+			n = 0;
+		}
+	}
+};
+
+static inline unsigned
+bz2_get_bit(const unsigned char *p, uint64_t bit)
+{
+	return (p[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
 /* single archive handling allocation helpers */
 
-inline bool
-Bzip2InputStream::Open(GError **error_r)
+inline void
+Bzip2InputStream::Open()
+{
+	base.seekable = true;
+	base.size = index.GetSize();
+	base.ready = true;
+}
+
+inline void
+Bzip2InputStream::Close()
 {
+	CloseBlock();
+}
+
+/**
+ * Reads a block from the compressed file, and converts it to a
+ * standalone bzip2 stream (the same trick as bzip2recover): a stream
+ * header, the block (shifted to a byte boundary), and an
+ * end-of-stream marker with the block's CRC as the combined CRC.
+ */
+bool
+Bzip2InputStream::OpenBlock(unsigned i, GError **error_r)
+{
+	CloseBlock();
+
+	Bzip2Block block(0);
+	if (!index.GetBlock(archive->istream, i, block, error_r))
+		return false;
+
+	const goffset first_byte = block.begin / 8;
+	const size_t raw_size = (block.end + 7) / 8 - first_byte;
+	const uint64_t first_bit = block.begin % 8;
+	const uint64_t nbits = block.end - block.begin;
+
+	if (nbits < 80) {
+		g_set_error(error_r, bz2_quark(), 0,
+			    "Corrupt bzip2 block");
+		return false;
+	}
+
+	std::vector<unsigned char> raw(raw_size);
+
+	struct input_stream *is = archive->istream;
+	is->mutex.lock();
+	if (!input_stream_seek(is, first_byte, SEEK_SET, error_r)) {
+		is->mutex.unlock();
+		return false;
+	}
+
+	for (size_t fill = 0; fill < raw_size;) {
+		GError *error = nullptr;
+		size_t nbytes = input_stream_read(is, &raw[fill],
+						  raw_size - fill, &error);
+		if (nbytes == 0) {
+			is->mutex.unlock();
+			if (error != nullptr)
+				g_propagate_error(error_r, error);
+			else
+				g_set_error(error_r, bz2_quark(), 0,
+					    "Truncated bzip2 file");
+			return false;
+		}
+
+		fill += nbytes;
+	}
+
+	is->mutex.unlock();
+
+	/* the 32 bit CRC follows the block magic */
+	uint32_t crc = 0;
+	for (uint64_t bit = first_bit + 48; bit < first_bit + 80; ++bit)
+		crc = (crc << 1) | bz2_get_bit(raw.data(), bit);
+
+	block_buffer.clear();
+	block_buffer.reserve(raw_size + 16);
+	block_buffer.push_back('B');
+	block_buffer.push_back('Z');
+	block_buffer.push_back('h');
+	/* the maximum block size, which is safe for all blocks */
+	block_buffer.push_back('9');
+
+	Bzip2BitWriter writer(block_buffer);
+	for (uint64_t bit = first_bit; bit < first_bit + nbits; ++bit)
+		writer.WriteBit(bz2_get_bit(raw.data(), bit));
+	writer.Write(BZ2_EOS_MAGIC, 48);
+	writer.Write(crc, 32);
+	writer.Flush();
+
 	bzstream.bzalloc = nullptr;
 	bzstream.bzfree = nullptr;
 	bzstream.opaque = nullptr;
 
-	bzstream.next_in = (char *)buffer;
-	bzstream.avail_in = 0;
+	bzstream.next_in = block_buffer.data();
+	bzstream.avail_in = block_buffer.size();
 
 	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
 	if (ret != BZ_OK) {
@@ -134,14 +650,18 @@ Bzip2InputStream::Open(GError **error_r)
 		return false;
 	}
 
-	base.ready = true;
+	current_block = i;
+	block_open = true;
 	return true;
 }
 
-inline void
-Bzip2InputStream::Close()
+void
+Bzip2InputStream::CloseBlock()
 {
-	BZ2_bzDecompressEnd(&bzstream);
+	if (block_open) {
+		BZ2_bzDecompressEnd(&bzstream);
+		block_open = false;
+	}
 }
 
 /* archive open && listing routine */
@@ -155,21 +675,35 @@ bz2_open(const char *pathname, GError **error_r)
 	if (is == nullptr)
 		return nullptr;
 
-	return new Bzip2ArchiveFile(pathname, is);
+	struct stat st;
+	if (stat(pathname, &st) < 0) {
+		g_set_error(error_r, errno_quark(), errno,
+			    "Failed to stat %s: %s",
+			    pathname, g_strerror(errno));
+		input_stream_close(is);
+		return nullptr;
+	}
+
+	return new Bzip2ArchiveFile(pathname, is, st.st_mtime);
 }
 
 /* single archive handling */
 
-Bzip2InputStream::Bzip2InputStream(Bzip2ArchiveFile &_context, const char *uri,
+Bzip2InputStream::Bzip2InputStream(Bzip2ArchiveFile &_context,
+				   Bzip2Index &_index,
+				   const char *uri,
 				   Mutex &mutex, Cond &cond)
 	:base(bz2_inputplugin, uri, mutex, cond),
-	 archive(&_context), eof(false)
+	 archive(&_context), index(_index), eof(false),
+	 current_block(0), block_open(false)
 {
 	archive->Ref();
+	index.Ref();
 }
 
 Bzip2InputStream::~Bzip2InputStream()
 {
+	index.Unref();
 	archive->Unref();
 }
 
@@ -178,12 +712,11 @@ Bzip2ArchiveFile::OpenStream(const char *path,
 			     Mutex &mutex, Cond &cond,
 			     GError **error_r)
 {
-	Bzip2InputStream *bis = new Bzip2InputStream(*this, path, mutex, cond);
-	if (!bis->Open(error_r)) {
-		delete bis;
-		return NULL;
-	}
+	(void)error_r;
 
+	Bzip2InputStream *bis = new Bzip2InputStream(*this, GetIndex(), path,
+						     mutex, cond);
+	bis->Open();
 	return &bis->base;
 }
 
@@ -196,26 +729,68 @@ bz2_is_close(struct input_stream *is)
 	delete bis;
 }
 
-static bool
-bz2_fillbuffer(Bzip2InputStream *bis, GError **error_r)
+size_t
+Bzip2InputStream::Read(void *ptr, size_t length, GError **error_r)
 {
-	size_t count;
-	bz_stream *bzstream;
+	if (eof)
+		return 0;
 
-	bzstream = &bis->bzstream;
+	bzstream.next_out = (char *)ptr;
+	bzstream.avail_out = length;
 
-	if (bzstream->avail_in > 0)
-		return true;
+	do {
+		if (!block_open) {
+			GError *error = nullptr;
+			if (!OpenBlock(current_block, &error)) {
+				if (error != nullptr) {
+					g_propagate_error(error_r, error);
+					return 0;
+				}
+
+				eof = true;
+				break;
+			}
+
+			bzstream.next_out = (char *)ptr + length - bzstream.avail_out;
+		}
 
-	count = input_stream_read(bis->archive->istream,
-				  bis->buffer, sizeof(bis->buffer),
-				  error_r);
-	if (count == 0)
-		return false;
+		int bz_result = BZ2_bzDecompress(&bzstream);
 
-	bzstream->next_in = bis->buffer;
-	bzstream->avail_in = count;
-	return true;
+		if (bz_result == BZ_STREAM_END) {
+			/* this block is finished; now we know
+			   where the next one begins */
+			const goffset next_offset =
+				base.offset + length - bzstream.avail_out;
+			const unsigned avail_out = bzstream.avail_out;
+
+			index.SetOffset(current_block + 1, next_offset);
+			CloseBlock();
+			++current_block;
+
+			bzstream.avail_out = avail_out;
+			continue;
+		}
+
+		if (bz_result != BZ_OK) {
+			g_set_error(error_r, bz2_quark(), bz_result,
+				    "BZ2_bzDecompress() has failed");
+			return 0;
+		}
+
+		if (bzstream.avail_in == 0 && bzstream.avail_out > 0) {
+			g_set_error(error_r, bz2_quark(), 0,
+				    "Truncated bzip2 block");
+			return 0;
+		}
+	} while (bzstream.avail_out == length);
+
+	const size_t nbytes = length - bzstream.avail_out;
+	base.offset += nbytes;
+
+	if (eof && base.size < 0)
+		base.size = base.offset;
+
+	return nbytes;
 }
 
 static size_t
@@ -223,39 +798,119 @@ bz2_is_read(struct input_stream *is, void *ptr, size_t length,
 	    GError **error_r)
 {
 	Bzip2InputStream *bis = (Bzip2InputStream *)is;
-	bz_stream *bzstream;
-	int bz_result;
-	size_t nbytes = 0;
 
-	if (bis->eof)
-		return 0;
+	return bis->Read(ptr, length, error_r);
+}
+
+/**
+ * Decompress and discard data.
+ */
+bool
+Bzip2InputStream::Skip(goffset nbytes, GError **error_r)
+{
+	while (nbytes > 0) {
+		char buffer[16384];
+		size_t length = sizeof(buffer);
+		if ((goffset)length > nbytes)
+			length = nbytes;
+
+		GError *error = nullptr;
+		length = Read(buffer, length, &error);
+		if (length == 0) {
+			if (error != nullptr)
+				g_propagate_error(error_r, error);
+			else
+				g_set_error(error_r, bz2_quark(), 0,
+					    "Cannot seek beyond end of file");
+			return false;
+		}
 
-	bzstream = &bis->bzstream;
-	bzstream->next_out = (char *)ptr;
-	bzstream->avail_out = length;
+		nbytes -= length;
+	}
 
-	do {
-		if (!bz2_fillbuffer(bis, error_r))
-			return 0;
+	return true;
+}
 
-		bz_result = BZ2_bzDecompress(bzstream);
+/**
+ * Decompress and discard everything up to the end of the file, to
+ * learn the uncompressed size.
+ */
+bool
+Bzip2InputStream::SkipToEnd(GError **error_r)
+{
+	while (!eof) {
+		char buffer[16384];
+		if (Read(buffer, sizeof(buffer), error_r) == 0 && !eof)
+			return false;
+	}
 
-		if (bz_result == BZ_STREAM_END) {
-			bis->eof = true;
-			break;
-		}
+	return true;
+}
 
-		if (bz_result != BZ_OK) {
-			g_set_error(error_r, bz2_quark(), bz_result,
-				    "BZ2_bzDecompress() has failed");
-			return 0;
-		}
-	} while (bzstream->avail_out == length);
+bool
+Bzip2InputStream::Seek(goffset offset, GError **error_r)
+{
+	assert(offset >= 0);
 
-	nbytes = length - bzstream->avail_out;
-	is->offset += nbytes;
+	goffset block_offset;
+	unsigned i = index.FindBlock(offset, &block_offset);
 
-	return nbytes;
+	if (i == current_block && base.offset >= block_offset &&
+	    base.offset <= offset)
+		/* the offset is ahead of the current position within
+		   the current block: no need to start over */
+		return Skip(offset - base.offset, error_r);
+
+	GError *error = nullptr;
+	if (!OpenBlock(i, &error) && error != nullptr) {
+		g_propagate_error(error_r, error);
+		return false;
+	}
+
+	/* if there is no block #i, the offset is at the end of the
+	   last block */
+
+	current_block = i;
+	base.offset = block_offset;
+	eof = false;
+
+	return Skip(offset - block_offset, error_r);
+}
+
+static bool
+bz2_is_seek(struct input_stream *is, goffset offset, int whence,
+	    GError **error_r)
+{
+	Bzip2InputStream *bis = (Bzip2InputStream *)is;
+
+	switch (whence) {
+	case SEEK_SET:
+		break;
+
+	case SEEK_CUR:
+		offset += is->offset;
+		break;
+
+	case SEEK_END:
+		if (is->size < 0 && !bis->SkipToEnd(error_r))
+			return false;
+
+		assert(is->size >= 0);
+
+		offset += is->size;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (offset < 0) {
+		g_set_error(error_r, bz2_quark(), 0,
+			    "Invalid seek offset");
+		return false;
+	}
+
+	return bis->Seek(offset, error_r);
 }
 
 static bool
@@ -285,13 +940,13 @@ const struct input_plugin bz2_inputplugin = {
 	nullptr,
 	bz2_is_read,
 	bz2_is_eof,
-	nullptr,
+	bz2_is_seek,
 };
 
 const struct archive_plugin bz2_archive_plugin = {
 	"bz2",
 	nullptr,
-	nullptr,
+	bz2_finish,
 	bz2_open,
 	bz2_extensions,
 };
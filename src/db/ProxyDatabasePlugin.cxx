@@ -21,8 +21,11 @@
 #include "ProxyDatabasePlugin.hxx"
 #include "DatabasePlugin.hxx"
 #include "DatabaseSelection.hxx"
+#include "DatabaseHelpers.hxx"
+#include "SongFilter.hxx"
 #include "PlaylistVector.hxx"
 #include "Directory.hxx"
+#include "DatabaseLock.hxx"
 #include "gcc.h"
 #include "conf.h"
 
@@ -37,14 +40,37 @@ extern "C" {
 
 #include <cassert>
 #include <string>
-#include <list>
+
+#include <string.h>
 
 class ProxyDatabase : public Database {
 	std::string host;
 	unsigned port;
 
 	struct mpd_connection *connection;
-	Directory *root;
+
+	/**
+	 * Mirror the upstream database in memory?
+	 */
+	bool cache;
+
+	/**
+	 * A second connection which waits for "idle database"
+	 * events, to invalidate the mirror.  Only used if #cache is
+	 * enabled.
+	 */
+	mutable struct mpd_connection *idle_connection;
+
+	/**
+	 * The mirror of the upstream database.  Only used if #cache
+	 * is enabled.
+	 */
+	mutable Directory *root;
+
+	/**
+	 * Does #root reflect the current upstream database?
+	 */
+	mutable bool cache_valid;
 
 public:
 	static Database *Create(const struct config_param *param,
@@ -71,8 +97,40 @@ public:
 			      DatabaseStats &stats,
 			      GError **error_r) const override;
 
+	virtual bool CountSongs(const DatabaseSelection &selection,
+				unsigned &songs_r,
+				unsigned long &duration_r,
+				GError **error_r) const override;
+
 protected:
 	bool Configure(const struct config_param *param, GError **error_r);
+
+private:
+	/**
+	 * Check for upstream database changes, and rebuild the
+	 * mirror if necessary.
+	 *
+	 * @return true if the mirror can be used, false if the query
+	 * needs to be sent to the server
+	 */
+	bool CheckCache() const;
+
+	/**
+	 * Populate #root with one "listallinfo" request.
+	 */
+	bool LoadCache(GError **error_r) const;
+
+	/**
+	 * Stop using the mirror, e.g. because the idle connection
+	 * has failed.
+	 */
+	void DisableCache() const;
+
+	bool VisitCache(const DatabaseSelection &selection,
+			VisitDirectory visit_directory,
+			VisitSong visit_song,
+			VisitPlaylist visit_playlist,
+			GError **error_r) const;
 };
 
 G_GNUC_CONST
@@ -147,6 +205,7 @@ ProxyDatabase::Configure(const struct config_param *param, GError **)
 {
 	host = config_get_block_string(param, "host", "");
 	port = config_get_block_unsigned(param, "port", 0);
+	cache = config_get_block_bool(param, "cache", false);
 
 	return true;
 }
@@ -168,6 +227,23 @@ ProxyDatabase::Open(GError **error_r)
 	}
 
 	root = Directory::NewRoot();
+	cache_valid = false;
+	idle_connection = nullptr;
+
+	if (cache) {
+		idle_connection =
+			mpd_connection_new(host.empty() ? NULL : host.c_str(),
+					   port, 0);
+		if (idle_connection == nullptr ||
+		    !CheckError(idle_connection, error_r) ||
+		    !mpd_send_idle(idle_connection)) {
+			if (idle_connection != nullptr)
+				mpd_connection_free(idle_connection);
+			root->Free();
+			mpd_connection_free(connection);
+			return false;
+		}
+	}
 
 	return true;
 }
@@ -177,6 +253,9 @@ ProxyDatabase::Close()
 {
 	assert(connection != nullptr);
 
+	if (idle_connection != nullptr)
+		mpd_connection_free(idle_connection);
+
 	root->Free();
 	mpd_connection_free(connection);
 }
@@ -187,7 +266,21 @@ Convert(const struct mpd_song *song);
 struct song *
 ProxyDatabase::GetSong(const char *uri, GError **error_r) const
 {
-	// TODO: implement
+	if (CheckCache()) {
+		db_lock();
+		const struct song *song = root->LookupSong(uri);
+		struct song *song2 = song != nullptr
+			? song_dup_detached(song)
+			: nullptr;
+		db_unlock();
+
+		if (song2 == nullptr)
+			g_set_error(error_r, db_quark(), DB_NOT_FOUND,
+				    "No such song: %s", uri);
+
+		return song2;
+	}
+
 	// TODO: auto-reconnect
 
 	if (!mpd_send_list_meta(connection, uri)) {
@@ -226,32 +319,18 @@ ProxyDatabase::ReturnSong(struct song *song) const
 }
 
 static bool
-Visit(struct mpd_connection *connection, const char *uri,
-      bool recursive, VisitDirectory visit_directory, VisitSong visit_song,
-      VisitPlaylist visit_playlist, GError **error_r);
-
-static bool
-Visit(struct mpd_connection *connection,
-      bool recursive, const struct mpd_directory *directory,
-      VisitDirectory visit_directory, VisitSong visit_song,
-      VisitPlaylist visit_playlist, GError **error_r)
+Visit(const struct mpd_directory *directory,
+      VisitDirectory visit_directory, GError **error_r)
 {
-	const char *path = mpd_directory_get_path(directory);
-
-	if (visit_directory) {
-		Directory *d = Directory::NewGeneric(path, &detached_root);
-		bool success = visit_directory(*d, error_r);
-		d->Free();
-		if (!success)
-			return false;
-	}
+	if (!visit_directory)
+		return true;
 
-	if (recursive &&
-	    !Visit(connection, path, recursive,
-		   visit_directory, visit_song, visit_playlist, error_r))
-		return false;
+	const char *path = mpd_directory_get_path(directory);
 
-	return true;
+	Directory *d = Directory::NewGeneric(path, &detached_root);
+	bool success = visit_directory(*d, error_r);
+	d->Free();
+	return success;
 }
 
 static void
@@ -268,11 +347,13 @@ Copy(struct tag *tag, enum tag_type d_tag,
 	}
 }
 
-static song *
-Convert(const struct mpd_song *song)
+/**
+ * Copy the attributes of a libmpdclient song object to a MPD song
+ * object.
+ */
+static void
+CopyAttributes(struct song *s, const struct mpd_song *song)
 {
-	struct song *s = song_detached_new(mpd_song_get_uri(song));
-
 	s->mtime = mpd_song_get_last_modified(song);
 	s->start_ms = mpd_song_get_start(song) * 1000;
 	s->end_ms = mpd_song_get_end(song) * 1000;
@@ -286,19 +367,25 @@ Convert(const struct mpd_song *song)
 	tag_end_add(tag);
 
 	s->tag = tag;
+}
 
+static song *
+Convert(const struct mpd_song *song)
+{
+	struct song *s = song_detached_new(mpd_song_get_uri(song));
+	CopyAttributes(s, song);
 	return s;
 }
 
 static bool
-Visit(const struct mpd_song *song,
+Visit(const struct mpd_song *song, const DatabaseSelection &selection,
       VisitSong visit_song, GError **error_r)
 {
 	if (!visit_song)
 		return true;
 
 	struct song *s = Convert(song);
-	bool success = visit_song(*s, error_r);
+	bool success = !selection.Match(*s) || visit_song(*s, error_r);
 	song_free(s);
 
 	return success;
@@ -317,84 +404,391 @@ Visit(const struct mpd_playlist *playlist,
 	return visit_playlist(p, detached_root, error_r);
 }
 
-class ProxyEntity {
-	struct mpd_entity *entity;
+/**
+ * Check whether the song URI is within the base URI of the
+ * selection.  This is needed for results of "find" and "search",
+ * which always cover the whole database.
+ */
+gcc_pure
+static bool
+MatchBase(const DatabaseSelection &selection, const char *uri)
+{
+	const size_t length = strlen(selection.uri);
+	if (length > 0) {
+		if (memcmp(uri, selection.uri, length) != 0 ||
+		    uri[length] != '/')
+			return false;
 
-public:
-	explicit ProxyEntity(struct mpd_entity *_entity)
-		:entity(_entity) {}
+		uri += length + 1;
+	}
 
-	ProxyEntity(const ProxyEntity &other) = delete;
+	return selection.recursive || strchr(uri, '/') == nullptr;
+}
 
-	ProxyEntity(ProxyEntity &&other)
-		:entity(other.entity) {
-		other.entity = nullptr;
-	}
+/**
+ * Can the filter be translated to "find" or "search" constraints?
+ *
+ * @param exact_r on success, receives whether "find" (true) or
+ * "search" (false) must be used
+ */
+gcc_pure
+static bool
+CanSendFilter(const SongFilter &filter, bool *exact_r)
+{
+	bool first = true;
 
-	~ProxyEntity() {
-		if (entity != nullptr)
-			mpd_entity_free(entity);
+	for (const auto &item : filter.GetItems()) {
+		const unsigned tag = item.GetTag();
+		if (tag != LOCATE_TAG_FILE_TYPE &&
+		    tag != LOCATE_TAG_ANY_TYPE &&
+		    Convert(tag_type(tag)) == MPD_TAG_COUNT)
+			return false;
+
+		const bool exact = !item.GetFoldCase();
+		if (first) {
+			*exact_r = exact;
+			first = false;
+		} else if (exact != *exact_r)
+			/* libmpdclient can't mix "find" and "search"
+			   in one command */
+			return false;
 	}
 
-	ProxyEntity &operator=(const ProxyEntity &other) = delete;
+	return !first;
+}
+
+static bool
+SendConstraints(struct mpd_connection *connection, const SongFilter &filter)
+{
+	for (const auto &item : filter.GetItems()) {
+		const unsigned tag = item.GetTag();
+		const char *value = item.GetValue();
+
+		bool success;
+		if (tag == LOCATE_TAG_FILE_TYPE)
+			success = mpd_search_add_uri_constraint(connection,
+								MPD_OPERATOR_DEFAULT,
+								value);
+		else if (tag == LOCATE_TAG_ANY_TYPE)
+			success = mpd_search_add_any_tag_constraint(connection,
+								    MPD_OPERATOR_DEFAULT,
+								    value);
+		else
+			success = mpd_search_add_tag_constraint(connection,
+								MPD_OPERATOR_DEFAULT,
+								Convert(tag_type(tag)),
+								value);
 
-	operator const struct mpd_entity *() const {
-		return entity;
+		if (!success)
+			return false;
 	}
-};
 
-static std::list<ProxyEntity>
-ReceiveEntities(struct mpd_connection *connection)
-{
-	std::list<ProxyEntity> entities;
-	struct mpd_entity *entity;
-	while ((entity = mpd_recv_entity(connection)) != NULL)
-		entities.push_back(ProxyEntity(entity));
+	return true;
+}
 
+/**
+ * Finish a response which was (partially) passed to visitors.  If a
+ * visitor has failed, the rest of the response is discarded, and
+ * the visitor's error is returned.
+ */
+static bool
+FinishResponse(struct mpd_connection *connection, bool result,
+	       GError **error_r)
+{
 	mpd_response_finish(connection);
-	return entities;
+
+	if (!result) {
+		mpd_connection_clear_error(connection);
+		return false;
+	}
+
+	return CheckError(connection, error_r);
 }
 
+/**
+ * Let the server apply the filter with a "find" or "search" command,
+ * and pass the songs to the visitor while they are being received.
+ */
 static bool
-Visit(struct mpd_connection *connection, const char *uri,
-      bool recursive, VisitDirectory visit_directory, VisitSong visit_song,
-      VisitPlaylist visit_playlist, GError **error_r)
+SearchSongs(struct mpd_connection *connection,
+	    const DatabaseSelection &selection, bool exact,
+	    VisitSong visit_song,
+	    GError **error_r)
 {
-	if (!mpd_send_list_meta(connection, uri))
+	assert(selection.filter != nullptr);
+
+	if (!mpd_search_db_songs(connection, exact) ||
+	    !SendConstraints(connection, *selection.filter) ||
+	    !mpd_search_commit(connection))
 		return CheckError(connection, error_r);
 
-	std::list<ProxyEntity> entities(ReceiveEntities(connection));
-	if (!CheckError(connection, error_r))
-		return false;
+	bool result = true;
+	struct mpd_song *song;
+	while (result && (song = mpd_recv_song(connection)) != nullptr) {
+		if (MatchBase(selection, mpd_song_get_uri(song)))
+			result = Visit(song, selection, visit_song, error_r);
+
+		mpd_song_free(song);
+	}
 
-	for (const auto &entity : entities) {
+	return FinishResponse(connection, result, error_r);
+}
+
+/**
+ * List the directory with "lsinfo", or the whole tree below it with
+ * one "listallinfo" command, and pass the entities to the visitors
+ * while they are being received.
+ */
+static bool
+ListEntities(struct mpd_connection *connection,
+	     const DatabaseSelection &selection,
+	     VisitDirectory visit_directory, VisitSong visit_song,
+	     VisitPlaylist visit_playlist, GError **error_r)
+{
+	if (!(selection.recursive
+	      ? mpd_send_list_all_meta(connection, selection.uri)
+	      : mpd_send_list_meta(connection, selection.uri)))
+		return CheckError(connection, error_r);
+
+	bool result = true;
+	struct mpd_entity *entity;
+	while (result &&
+	       (entity = mpd_recv_entity(connection)) != nullptr) {
 		switch (mpd_entity_get_type(entity)) {
 		case MPD_ENTITY_TYPE_UNKNOWN:
 			break;
 
 		case MPD_ENTITY_TYPE_DIRECTORY:
-			if (!Visit(connection, recursive,
-				   mpd_entity_get_directory(entity),
-				   visit_directory, visit_song, visit_playlist,
-				   error_r))
-				return false;
+			result = Visit(mpd_entity_get_directory(entity),
+				       visit_directory, error_r);
 			break;
 
 		case MPD_ENTITY_TYPE_SONG:
-			if (!Visit(mpd_entity_get_song(entity), visit_song,
-				   error_r))
-				return false;
+			result = Visit(mpd_entity_get_song(entity), selection,
+				       visit_song, error_r);
 			break;
 
 		case MPD_ENTITY_TYPE_PLAYLIST:
-			if (!Visit(mpd_entity_get_playlist(entity),
-				   visit_playlist, error_r))
-				return false;
+			result = Visit(mpd_entity_get_playlist(entity),
+				       visit_playlist, error_r);
 			break;
 		}
+
+		mpd_entity_free(entity);
 	}
 
-	return CheckError(connection, error_r);
+	return FinishResponse(connection, result, error_r);
+}
+
+/**
+ * Look up a directory in the mirror, and create it (and its
+ * parents) if it does not exist yet.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static Directory *
+MakeDirectory(Directory &root, const char *path)
+{
+	Directory *directory = root.LookupDirectory(path);
+	if (directory != nullptr)
+		return directory;
+
+	const char *slash = strrchr(path, '/');
+	if (slash == nullptr)
+		return root.CreateChild(path);
+
+	const std::string parent_path(path, slash);
+	return MakeDirectory(root, parent_path.c_str())
+		->CreateChild(slash + 1);
+}
+
+/**
+ * Determine the parent directory of an entity in the mirror.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @param name_r receives the base name of the entity
+ */
+static Directory *
+MakeParent(Directory &root, const char *uri, const char **name_r)
+{
+	const char *slash = strrchr(uri, '/');
+	if (slash == nullptr) {
+		*name_r = uri;
+		return &root;
+	}
+
+	*name_r = slash + 1;
+
+	const std::string parent_path(uri, slash);
+	return MakeDirectory(root, parent_path.c_str());
+}
+
+bool
+ProxyDatabase::LoadCache(GError **error_r) const
+{
+	if (!mpd_send_list_all_meta(connection, ""))
+		return CheckError(connection, error_r);
+
+	/* the lock is held during the whole transfer; the mirror is
+	   the only database, and nobody else modifies it */
+	db_lock();
+
+	root->Free();
+	root = Directory::NewRoot();
+
+	unsigned n_songs = 0;
+	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(connection)) != nullptr) {
+		const char *name;
+
+		switch (mpd_entity_get_type(entity)) {
+		case MPD_ENTITY_TYPE_UNKNOWN:
+			break;
+
+		case MPD_ENTITY_TYPE_DIRECTORY:
+			MakeDirectory(*root,
+				      mpd_directory_get_path(mpd_entity_get_directory(entity)));
+			break;
+
+		case MPD_ENTITY_TYPE_SONG: {
+			const struct mpd_song *song =
+				mpd_entity_get_song(entity);
+			Directory *parent = MakeParent(*root,
+						       mpd_song_get_uri(song),
+						       &name);
+			if (parent->FindSong(name) != nullptr)
+				break;
+
+			struct song *s = song_file_new(name, parent);
+			CopyAttributes(s, song);
+			parent->AddSong(s);
+			++n_songs;
+			break;
+		}
+
+		case MPD_ENTITY_TYPE_PLAYLIST: {
+			const struct mpd_playlist *playlist =
+				mpd_entity_get_playlist(entity);
+			Directory *parent =
+				MakeParent(*root,
+					   mpd_playlist_get_path(playlist),
+					   &name);
+			parent->playlists.UpdateOrInsert(PlaylistInfo(name,
+								      mpd_playlist_get_last_modified(playlist)));
+			break;
+		}
+		}
+
+		mpd_entity_free(entity);
+	}
+
+	db_unlock();
+
+	mpd_response_finish(connection);
+	if (!CheckError(connection, error_r))
+		return false;
+
+	g_debug("loaded %u songs from the upstream database", n_songs);
+	return true;
+}
+
+void
+ProxyDatabase::DisableCache() const
+{
+	assert(idle_connection != nullptr);
+
+	mpd_connection_free(idle_connection);
+	idle_connection = nullptr;
+	cache_valid = false;
+
+	db_lock();
+	root->Free();
+	root = Directory::NewRoot();
+	db_unlock();
+}
+
+bool
+ProxyDatabase::CheckCache() const
+{
+	if (idle_connection == nullptr)
+		return false;
+
+	if (cache_valid) {
+		/* did the idle connection receive an event?  This
+		   doesn't block, and it doesn't cause network
+		   traffic */
+		GPollFD pfd;
+		pfd.fd = mpd_connection_get_fd(idle_connection);
+		pfd.events = G_IO_IN;
+		pfd.revents = 0;
+
+		if (g_poll(&pfd, 1, 0) > 0) {
+			const enum mpd_idle idle =
+				mpd_recv_idle(idle_connection, false);
+			if (idle == 0 || !mpd_send_idle(idle_connection)) {
+				GError *error = nullptr;
+				CheckError(idle_connection, &error);
+				g_warning("Lost the idle connection, disabling the cache: %s",
+					  error != nullptr
+					  ? error->message : "unknown error");
+				if (error != nullptr)
+					g_error_free(error);
+
+				DisableCache();
+				return false;
+			}
+
+			if (idle & MPD_IDLE_DATABASE)
+				cache_valid = false;
+		}
+
+		if (cache_valid)
+			return true;
+	}
+
+	GError *error = nullptr;
+	if (!LoadCache(&error)) {
+		g_warning("Failed to load the upstream database: %s",
+			  error->message);
+		g_error_free(error);
+		return false;
+	}
+
+	cache_valid = true;
+	return true;
+}
+
+bool
+ProxyDatabase::VisitCache(const DatabaseSelection &selection,
+			  VisitDirectory visit_directory,
+			  VisitSong visit_song,
+			  VisitPlaylist visit_playlist,
+			  GError **error_r) const
+{
+	ScopeDatabaseLock protect;
+
+	const Directory *directory = root->LookupDirectory(selection.uri);
+	if (directory == NULL) {
+		if (visit_song) {
+			song *song = root->LookupSong(selection.uri);
+			if (song != nullptr)
+				return !selection.Match(*song) ||
+					visit_song(*song, error_r);
+		}
+
+		g_set_error(error_r, db_quark(), DB_NOT_FOUND,
+			    "No such directory");
+		return false;
+	}
+
+	if (selection.recursive && visit_directory &&
+	    !visit_directory(*directory, error_r))
+		return false;
+
+	return directory->Walk(selection.recursive, selection.filter,
+			       visit_directory, visit_song, visit_playlist,
+			       error_r);
 }
 
 bool
@@ -404,12 +798,23 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitPlaylist visit_playlist,
 		     GError **error_r) const
 {
-	// TODO: match
+	if (CheckCache())
+		return VisitCache(selection, visit_directory, visit_song,
+				  visit_playlist, error_r);
+
 	// TODO: auto-reconnect
 
-	return ::Visit(connection, selection.uri, selection.recursive,
-		       visit_directory, visit_song, visit_playlist,
-		       error_r);
+	bool exact;
+	if (selection.filter != nullptr && !visit_directory &&
+	    !visit_playlist &&
+	    CanSendFilter(*selection.filter, &exact))
+		/* let the server do the filtering */
+		return SearchSongs(connection, selection, exact, visit_song,
+				   error_r);
+
+	return ListEntities(connection, selection,
+			    visit_directory, visit_song, visit_playlist,
+			    error_r);
 }
 
 bool
@@ -418,6 +823,10 @@ ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 			       VisitString visit_string,
 			       GError **error_r) const
 {
+	if (CheckCache())
+		return ::VisitUniqueTags(*this, selection, tag_type,
+					 visit_string, error_r);
+
 	enum mpd_tag_type tag_type2 = Convert(tag_type);
 	if (tag_type2 == MPD_TAG_COUNT) {
 		g_set_error_literal(error_r, libmpdclient_quark(), 0,
@@ -425,13 +834,20 @@ ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 		return false;
 	}
 
-	if (!mpd_search_db_tags(connection, tag_type2))
-		return CheckError(connection, error_r);
-
-	// TODO: match
-	(void)selection;
-
-	if (!mpd_search_commit(connection))
+	bool exact = true;
+	if (*selection.uri != 0 ||
+	    (selection.filter != nullptr &&
+	     (!CanSendFilter(*selection.filter, &exact) || !exact)))
+		/* "list" supports only exact matches on the whole
+		   database; collect the values from the (filtered)
+		   songs instead */
+		return ::VisitUniqueTags(*this, selection, tag_type,
+					 visit_string, error_r);
+
+	if (!mpd_search_db_tags(connection, tag_type2) ||
+	    (selection.filter != nullptr &&
+	     !SendConstraints(connection, *selection.filter)) ||
+	    !mpd_search_commit(connection))
 		return CheckError(connection, error_r);
 
 	bool result = true;
@@ -452,8 +868,12 @@ bool
 ProxyDatabase::GetStats(const DatabaseSelection &selection,
 			DatabaseStats &stats, GError **error_r) const
 {
-	// TODO: match
-	(void)selection;
+	if (*selection.uri != 0 || selection.filter != nullptr ||
+	    CheckCache())
+		/* the "stats" command covers only the whole
+		   database; and with the cache, everything is
+		   calculated locally */
+		return ::GetStats(*this, selection, stats, error_r);
 
 	struct mpd_stats *stats2 =
 		mpd_run_stats(connection);
@@ -469,6 +889,14 @@ ProxyDatabase::GetStats(const DatabaseSelection &selection,
 	return true;
 }
 
+bool
+ProxyDatabase::CountSongs(const DatabaseSelection &selection,
+			  unsigned &songs_r, unsigned long &duration_r,
+			  GError **error_r) const
+{
+	return ::CountSongs(*this, selection, songs_r, duration_r, error_r);
+}
+
 const DatabasePlugin proxy_db_plugin = {
 	"proxy",
 	ProxyDatabase::Create,
@@ -22,6 +22,7 @@
 #include "DatabaseSelection.hxx"
 #include "DatabaseHelpers.hxx"
 #include "Directory.hxx"
+#include "DatabaseCounters.hxx"
 #include "SongFilter.hxx"
 #include "DatabaseSave.hxx"
 #include "DatabaseLock.hxx"
@@ -30,6 +31,14 @@
 #include "conf.h"
 #include "fs/FileSystem.hxx"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+#define HAVE_GZ_STREAM
+#endif
+#endif
+
 #include <sys/types.h>
 #include <errno.h>
 
@@ -40,6 +49,91 @@ simple_db_quark(void)
 	return g_quark_from_static_string("simple_db");
 }
 
+/**
+ * The size of the stdio buffer used while saving the database.
+ */
+static constexpr size_t SAVE_BUFFER_SIZE = 256 * 1024;
+
+#ifdef HAVE_GZ_STREAM
+
+static int
+gz_stream_write_int(void *cookie, const char *data, int length)
+{
+	gzFile gz = (gzFile)cookie;
+
+	if (length <= 0)
+		return 0;
+
+	int nbytes = gzwrite(gz, data, length);
+	if (nbytes <= 0) {
+		errno = EIO;
+		return -1;
+	}
+
+	return nbytes;
+}
+
+#ifdef HAVE_FOPENCOOKIE
+static ssize_t
+gz_stream_write(void *cookie, const char *data, size_t length)
+{
+	return gz_stream_write_int(cookie, data, length);
+}
+#endif
+
+static int
+gz_stream_close(void *cookie)
+{
+	gzFile gz = (gzFile)cookie;
+
+	if (gzclose(gz) != Z_OK) {
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Create a gzip file and return a stdio stream which compresses
+ * everything written to it into that file.  This way, the database
+ * is compressed while it is being written, and no uncompressed copy
+ * is stored on disk.
+ */
+static FILE *
+gz_stream_open(const Path &path_fs)
+{
+	gzFile gz = gzopen(path_fs.c_str(), "wb");
+	if (gz == NULL)
+		return NULL;
+
+#ifdef HAVE_FOPENCOOKIE
+	cookie_io_functions_t io = {
+		nullptr, gz_stream_write, nullptr, gz_stream_close,
+	};
+
+	FILE *fp = fopencookie(gz, "w", io);
+#else
+	FILE *fp = funopen(gz, nullptr, gz_stream_write_int, nullptr,
+			   gz_stream_close);
+#endif
+	if (fp == NULL)
+		gzclose(gz);
+
+	return fp;
+}
+
+#elif defined(HAVE_ZLIB)
+
+/**
+ * Compress a file.  This is the fallback for platforms where
+ * gz_stream_open() is not available.
+ */
+static bool
+compress_file(const Path &src_path, const Path &dest_path, GError **error_r);
+
+#endif
+
 Database *
 SimpleDatabase::Create(const struct config_param *param, GError **error_r)
 {
@@ -78,6 +172,14 @@ SimpleDatabase::Configure(const struct config_param *param, GError **error_r)
 		return false;
 	}
 
+#ifdef HAVE_ZLIB
+	compress = config_get_block_bool(param, "compress", false);
+#else
+	if (config_get_block_bool(param, "compress", false))
+		g_warning("compression requires zlib, which was not "
+			  "enabled at compile time");
+#endif
+
 	return true;
 }
 
@@ -180,6 +282,7 @@ bool
 SimpleDatabase::Open(GError **error_r)
 {
 	root = Directory::NewRoot();
+	root->counters = new DatabaseCounters();
 	mtime = 0;
 
 #ifndef NDEBUG
@@ -197,6 +300,7 @@ SimpleDatabase::Open(GError **error_r)
 			return false;
 
 		root = Directory::NewRoot();
+		root->counters = new DatabaseCounters();
 	}
 
 	return true;
@@ -298,9 +402,63 @@ bool
 SimpleDatabase::GetStats(const DatabaseSelection &selection,
 			 DatabaseStats &stats, GError **error_r) const
 {
+	if (*selection.uri == 0 && selection.recursive &&
+	    selection.filter == nullptr) {
+		const ScopeDatabaseLock protect;
+		root->counters->GetStats(stats);
+		return true;
+	}
+
 	return ::GetStats(*this, selection, stats, error_r);
 }
 
+/**
+ * Can this filter be answered by DatabaseCounters::GetTagCount()?
+ * That is the case if it consists of one exact, non-empty tag
+ * value.
+ */
+gcc_pure
+static bool
+IsCountedFilter(const SongFilter &filter)
+{
+	const auto &items = filter.GetItems();
+	if (items.size() != 1)
+		return false;
+
+	const SongFilter::Item &item = items.front();
+	return item.GetTag() < TAG_NUM_OF_ITEM_TYPES &&
+		!item.GetFoldCase() && *item.GetValue() != 0;
+}
+
+bool
+SimpleDatabase::CountSongs(const DatabaseSelection &selection,
+			   unsigned &songs_r, unsigned long &duration_r,
+			   GError **error_r) const
+{
+	if (*selection.uri == 0 && selection.recursive &&
+	    (selection.filter == nullptr ||
+	     IsCountedFilter(*selection.filter))) {
+		const ScopeDatabaseLock protect;
+
+		if (selection.filter == nullptr) {
+			DatabaseStats stats;
+			root->counters->GetStats(stats);
+			songs_r = stats.song_count;
+			duration_r = stats.total_duration;
+		} else {
+			const SongFilter::Item &item =
+				selection.filter->GetItems().front();
+			root->counters->GetTagCount(tag_type(item.GetTag()),
+						    item.GetValue(),
+						    songs_r, duration_r);
+		}
+
+		return true;
+	}
+
+	return ::CountSongs(*this, selection, songs_r, duration_r, error_r);
+}
+
 bool
 SimpleDatabase::Save(GError **error_r)
 {
@@ -314,35 +472,158 @@ SimpleDatabase::Save(GError **error_r)
 
 	db_unlock();
 
+	/* the tree is written without holding the db_mutex: this
+	   method is called by the update thread, which is the only
+	   one which modifies the tree, so clients can continue to
+	   query the database meanwhile */
+
 	g_debug("writing DB");
 
-	FILE *fp = FOpen(path, FOpenMode::WriteText);
+	GTimer *timer = g_timer_new();
+
+	/* write to a temporary file which is renamed when it's
+	   complete, so a crash or a full disk doesn't destroy the
+	   old database */
+	char *tmp = g_strconcat(path.c_str(), ".tmp", NULL);
+	const Path tmp_path = Path::FromFS(tmp);
+	g_free(tmp);
+
+#ifdef HAVE_GZ_STREAM
+	FILE *fp = compress
+		? gz_stream_open(tmp_path)
+		: FOpen(tmp_path, FOpenMode::WriteText);
+#else
+	FILE *fp = FOpen(tmp_path, FOpenMode::WriteText);
+#endif
 	if (!fp) {
 		g_set_error(error_r, simple_db_quark(), errno,
 			    "unable to write to db file \"%s\": %s",
 			    path_utf8.c_str(), g_strerror(errno));
+		g_timer_destroy(timer);
 		return false;
 	}
 
+	/* the buffer must live until fclose() */
+	char *buffer = (char *)g_malloc(SAVE_BUFFER_SIZE);
+	setvbuf(fp, buffer, _IOFBF, SAVE_BUFFER_SIZE);
+
 	db_save_internal(fp, root);
 
-	if (ferror(fp)) {
+	const bool failed = ferror(fp);
+	const bool close_failed = fclose(fp) != 0;
+	g_free(buffer);
+
+	if (close_failed || failed) {
 		g_set_error(error_r, simple_db_quark(), errno,
 			    "Failed to write to database file: %s",
 			    g_strerror(errno));
-		fclose(fp);
+		RemoveFile(tmp_path);
+		g_timer_destroy(timer);
 		return false;
 	}
 
-	fclose(fp);
+#if defined(HAVE_ZLIB) && !defined(HAVE_GZ_STREAM)
+	if (compress) {
+		char *gz = g_strconcat(path.c_str(), ".tmp.gz", NULL);
+		const Path gz_path = Path::FromFS(gz);
+		g_free(gz);
+
+		bool success = compress_file(tmp_path, gz_path, error_r);
+		RemoveFile(tmp_path);
+		if (!success) {
+			RemoveFile(gz_path);
+			g_timer_destroy(timer);
+			return false;
+		}
+
+		if (!RenameFile(gz_path, path)) {
+			g_set_error(error_r, simple_db_quark(), errno,
+				    "Failed to rename database file: %s",
+				    g_strerror(errno));
+			RemoveFile(gz_path);
+			g_timer_destroy(timer);
+			return false;
+		}
+	} else
+#endif
+	if (!RenameFile(tmp_path, path)) {
+		g_set_error(error_r, simple_db_quark(), errno,
+			    "Failed to rename database file: %s",
+			    g_strerror(errno));
+		RemoveFile(tmp_path);
+		g_timer_destroy(timer);
+		return false;
+	}
 
 	struct stat st;
-	if (StatFile(path, st))
+	if (StatFile(path, st)) {
 		mtime = st.st_mtime;
 
+		g_message("saved database (%lu bytes) in %.2f seconds",
+			  (unsigned long)st.st_size,
+			  g_timer_elapsed(timer, NULL));
+	}
+
+	g_timer_destroy(timer);
 	return true;
 }
 
+#if defined(HAVE_ZLIB) && !defined(HAVE_GZ_STREAM)
+
+static bool
+compress_file(const Path &src_path, const Path &dest_path, GError **error_r)
+{
+	FILE *src = FOpen(src_path, FOpenMode::ReadBinary);
+	if (src == NULL) {
+		g_set_error(error_r, simple_db_quark(), errno,
+			    "Failed to open database file: %s",
+			    g_strerror(errno));
+		return false;
+	}
+
+	gzFile dest = gzopen(dest_path.c_str(), "wb");
+	if (dest == NULL) {
+		g_set_error(error_r, simple_db_quark(), errno,
+			    "Failed to create database file: %s",
+			    g_strerror(errno));
+		fclose(src);
+		return false;
+	}
+
+	char buffer[64 * 1024];
+	size_t nbytes;
+	bool success = true;
+	while ((nbytes = fread(buffer, 1, sizeof(buffer), src)) > 0) {
+		if (gzwrite(dest, buffer, nbytes) != (int)nbytes) {
+			int errnum;
+			g_set_error(error_r, simple_db_quark(), 0,
+				    "Failed to compress database file: %s",
+				    gzerror(dest, &errnum));
+			success = false;
+			break;
+		}
+	}
+
+	if (success && ferror(src)) {
+		g_set_error(error_r, simple_db_quark(), errno,
+			    "Failed to read database file: %s",
+			    g_strerror(errno));
+		success = false;
+	}
+
+	fclose(src);
+
+	if (gzclose(dest) != Z_OK && success) {
+		g_set_error(error_r, simple_db_quark(), 0,
+			    "Failed to write compressed database file");
+		success = false;
+	}
+
+	return success;
+}
+
+#endif
+
 const DatabasePlugin simple_db_plugin = {
 	"simple",
 	SimpleDatabase::Create,
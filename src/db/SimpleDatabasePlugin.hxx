@@ -38,6 +38,13 @@ class SimpleDatabase : public Database {
 
 	time_t mtime;
 
+#ifdef HAVE_ZLIB
+	/**
+	 * Write the database file with gzip compression?
+	 */
+	bool compress;
+#endif
+
 #ifndef NDEBUG
 	unsigned borrowed_song_count;
 #endif
@@ -85,6 +92,11 @@ public:
 			      DatabaseStats &stats,
 			      GError **error_r) const override;
 
+	virtual bool CountSongs(const DatabaseSelection &selection,
+				unsigned &songs_r,
+				unsigned long &duration_r,
+				GError **error_r) const override;
+
 protected:
 	bool Configure(const struct config_param *param, GError **error_r);
 
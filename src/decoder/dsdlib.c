@@ -65,7 +65,7 @@ dsdlib_skip_to(struct decoder *decoder, struct input_stream *is,
 	       goffset offset)
 {
 	if (input_stream_is_seekable(is))
-		return input_stream_seek(is, offset, SEEK_SET, NULL);
+		return input_stream_lock_seek(is, offset, SEEK_SET, NULL);
 
 	if (input_stream_get_offset(is) > offset)
 		return false;
@@ -98,7 +98,7 @@ dsdlib_skip(struct decoder *decoder, struct input_stream *is,
 		return true;
 
 	if (input_stream_is_seekable(is))
-		return input_stream_seek(is, delta, SEEK_CUR, NULL);
+		return input_stream_lock_seek(is, delta, SEEK_CUR, NULL);
 
 	char buffer[8192];
 	while (delta > 0) {
@@ -24,6 +24,7 @@
 #include "tag_rva2.h"
 #include "tag_handler.h"
 #include "audio_check.h"
+#include "mp3_seek_index.h"
 
 #include <assert.h>
 #include <unistd.h>
@@ -106,6 +107,12 @@ mp3_plugin_init(G_GNUC_UNUSED const struct config_param *param)
 	return true;
 }
 
+static void
+mp3_plugin_finish(void)
+{
+	mp3_seek_index_deinit();
+}
+
 #define MP3_DATA_OUTPUT_BUFFER_SIZE 2048
 
 struct mp3_data {
@@ -124,6 +131,25 @@ struct mp3_data {
 	unsigned long highest_frame;
 	unsigned long max_frames;
 	unsigned long current_frame;
+
+	/**
+	 * The number of entries in #frame_offsets which were restored
+	 * from the seek index cache.
+	 */
+	unsigned long cached_frames;
+
+	/**
+	 * The duration of the first frame.  The seek index cache
+	 * stores only frame offsets, and the times are calculated
+	 * from this value.
+	 */
+	mad_timer_t frame_duration;
+
+	/**
+	 * Do all frames seen so far have the same duration?  If not,
+	 * the frame offsets cannot be stored in the seek index cache.
+	 */
+	bool uniform_duration;
 	unsigned int drop_start_frames;
 	unsigned int drop_end_frames;
 	unsigned int drop_start_samples;
@@ -148,6 +174,8 @@ mp3_data_init(struct mp3_data *data, struct decoder *decoder,
 	data->frame_offsets = NULL;
 	data->times = NULL;
 	data->current_frame = 0;
+	data->cached_frames = 0;
+	data->uniform_duration = true;
 	data->drop_start_frames = 0;
 	data->drop_end_frames = 0;
 	data->drop_start_samples = 0;
@@ -873,6 +901,7 @@ mp3_decode_first_frame(struct mp3_data *data, struct tag **tag)
 
 	data->frame_offsets = g_malloc(sizeof(long) * data->max_frames);
 	data->times = g_malloc(sizeof(mad_timer_t) * data->max_frames);
+	data->frame_duration = data->frame.header.duration;
 
 	return true;
 }
@@ -920,30 +949,129 @@ mp3_open(struct input_stream *is, struct mp3_data *data,
 	return true;
 }
 
+/**
+ * Builds the key for the seek index cache.  The caller must free the
+ * return value with g_free().
+ */
+static char *
+mp3_seek_index_key(const struct mp3_data *data)
+{
+	return g_strconcat("mad:", input_stream_get_uri(data->input_stream),
+			   NULL);
+}
+
+/**
+ * Restores the frame offset table from the seek index cache, if this
+ * song has been played before.
+ */
+static void
+mp3_load_seek_index(struct mp3_data *data)
+{
+	goffset size = input_stream_get_size(data->input_stream);
+	if (size < 0 || !input_stream_is_seekable(data->input_stream))
+		return;
+
+	char *key = mp3_seek_index_key(data);
+
+	goffset *offsets = g_new(goffset, data->max_frames);
+	unsigned step;
+	unsigned length = mp3_seek_index_load(key, size, &step, offsets,
+					      data->max_frames);
+	g_free(key);
+
+	if (length > 0 && step == 1) {
+		mad_timer_t timer = mad_timer_zero;
+
+		for (unsigned i = 0; i < length; ++i) {
+			data->frame_offsets[i] = (long)offsets[i];
+			mad_timer_add(&timer, data->frame_duration);
+			data->times[i] = timer;
+		}
+
+		data->highest_frame = data->cached_frames = length;
+	}
+
+	g_free(offsets);
+}
+
+/**
+ * Stores the frame offset table in the seek index cache if more
+ * frames were discovered than were restored by
+ * mp3_load_seek_index().
+ */
+static void
+mp3_store_seek_index(const struct mp3_data *data)
+{
+	goffset size = input_stream_get_size(data->input_stream);
+	if (size < 0 || !input_stream_is_seekable(data->input_stream) ||
+	    !data->uniform_duration ||
+	    data->highest_frame <= data->cached_frames)
+		return;
+
+	goffset *offsets = g_new(goffset, data->highest_frame);
+	for (unsigned long i = 0; i < data->highest_frame; ++i)
+		offsets[i] = data->frame_offsets[i];
+
+	char *key = mp3_seek_index_key(data);
+	mp3_seek_index_store(key, size, 1, offsets, data->highest_frame);
+	g_free(key);
+	g_free(offsets);
+}
+
+/**
+ * Finds the first known frame which ends at or after the specified
+ * time.  Returns #highest_frame if the time is beyond the known part
+ * of the song.
+ */
 static long
 mp3_time_to_frame(const struct mp3_data *data, double t)
 {
-	unsigned long i;
+	/* the times[] array is monotonic: binary search */
+	unsigned long lower = 0, upper = data->highest_frame;
 
-	for (i = 0; i < data->highest_frame; ++i) {
+	while (lower < upper) {
+		unsigned long middle = lower + (upper - lower) / 2;
 		double frame_time =
-			mad_timer_count(data->times[i],
+			mad_timer_count(data->times[middle],
 					MAD_UNITS_MILLISECONDS) / 1000.;
 		if (frame_time >= t)
-			break;
+			upper = middle;
+		else
+			lower = middle + 1;
 	}
 
-	return i;
+	return lower;
+}
+
+/**
+ * Jumps to the last frame of the known part of the song, unless we're
+ * already past it.
+ */
+static bool
+mp3_seek_highest_frame(struct mp3_data *data)
+{
+	if (data->highest_frame <= data->current_frame + 1)
+		return true;
+
+	if (!mp3_seek(data, data->frame_offsets[data->highest_frame - 1]))
+		return false;
+
+	data->current_frame = data->highest_frame - 1;
+	return true;
 }
 
 static void
 mp3_update_timer_next_frame(struct mp3_data *data)
 {
+	data->bit_rate = (data->frame).header.bitrate;
+
 	if (data->current_frame >= data->highest_frame) {
 		/* record this frame's properties in
 		   data->frame_offsets (for seeking) and
 		   data->times */
-		data->bit_rate = (data->frame).header.bitrate;
+		if (mad_timer_compare(data->frame.header.duration,
+				      data->frame_duration) != 0)
+			data->uniform_duration = false;
 
 		if (data->current_frame >= data->max_frames)
 			/* cap data->current_frame */
@@ -1092,11 +1220,14 @@ mp3_read(struct mp3_data *data)
 					decoder_command_finished(decoder);
 				} else
 					decoder_seek_error(decoder);
-			} else {
+			} else if (mp3_seek_highest_frame(data)) {
+				/* skip the remaining frames without
+				   decoding them */
 				data->seek_where = decoder_seek_where(decoder);
 				data->mute_frame = MUTEFRAME_SEEK;
 				decoder_command_finished(decoder);
-			}
+			} else
+				decoder_seek_error(decoder);
 		} else if (cmd != DECODE_COMMAND_NONE)
 			return false;
 	}
@@ -1163,6 +1294,8 @@ mp3_decode(struct decoder *decoder, struct input_stream *input_stream)
 		return;
 	}
 
+	mp3_load_seek_index(&data);
+
 	decoder_initialized(decoder, &audio_format,
 			    input_stream_is_seekable(input_stream),
 			    data.total_time);
@@ -1174,6 +1307,7 @@ mp3_decode(struct decoder *decoder, struct input_stream *input_stream)
 
 	while (mp3_read(&data)) ;
 
+	mp3_store_seek_index(&data);
 	mp3_data_finish(&data);
 }
 
@@ -1197,6 +1331,7 @@ static const char *const mp3_mime_types[] = { "audio/mpeg", NULL };
 const struct decoder_plugin mad_decoder_plugin = {
 	.name = "mad",
 	.init = mp3_plugin_init,
+	.finish = mp3_plugin_finish,
 	.stream_decode = mp3_decode,
 	.scan_stream = mad_decoder_scan_stream,
 	.suffixes = mp3_suffixes,
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2003-2012 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "mp3_seek_index.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "mp3_seek_index"
+
+/**
+ * The maximum number of bytes occupied by all delta tables.  At 4
+ * bytes per MP3 frame, this is enough for roughly 100 hours of
+ * music.
+ */
+#define MP3_SEEK_INDEX_MAX_BYTES (16 * 1024 * 1024)
+
+struct mp3_seek_index {
+	char *key;
+
+	goffset size;
+
+	unsigned step;
+
+	/**
+	 * The number of offsets (one more than the number of deltas).
+	 */
+	unsigned length;
+
+	goffset base;
+
+	uint32_t deltas[1];
+};
+
+G_LOCK_DEFINE_STATIC(mp3_seek_index);
+
+/**
+ * Maps the key to a #mp3_seek_index.
+ */
+static GHashTable *mp3_seek_index_table;
+
+/**
+ * All #mp3_seek_index objects, the least recently used first.
+ */
+static GQueue mp3_seek_index_lru = G_QUEUE_INIT;
+
+static size_t mp3_seek_index_bytes;
+
+static size_t
+mp3_seek_index_sizeof(unsigned length)
+{
+	assert(length > 0);
+
+	return sizeof(struct mp3_seek_index) +
+		(length - 1) * sizeof(uint32_t);
+}
+
+static void
+mp3_seek_index_free(struct mp3_seek_index *index)
+{
+	assert(mp3_seek_index_bytes >= mp3_seek_index_sizeof(index->length));
+
+	mp3_seek_index_bytes -= mp3_seek_index_sizeof(index->length);
+
+	g_free(index->key);
+	g_free(index);
+}
+
+/**
+ * Removes an entry from the table and frees it.  Caller must hold
+ * the lock.
+ */
+static void
+mp3_seek_index_remove(struct mp3_seek_index *index)
+{
+	g_hash_table_remove(mp3_seek_index_table, index->key);
+	g_queue_remove(&mp3_seek_index_lru, index);
+	mp3_seek_index_free(index);
+}
+
+/**
+ * Looks up a table and marks it as recently used.  Caller must hold
+ * the lock.
+ */
+static struct mp3_seek_index *
+mp3_seek_index_find(const char *key, goffset size)
+{
+	if (mp3_seek_index_table == NULL)
+		return NULL;
+
+	struct mp3_seek_index *index =
+		g_hash_table_lookup(mp3_seek_index_table, key);
+	if (index == NULL)
+		return NULL;
+
+	if (index->size != size) {
+		/* the file was modified */
+		mp3_seek_index_remove(index);
+		return NULL;
+	}
+
+	g_queue_remove(&mp3_seek_index_lru, index);
+	g_queue_push_tail(&mp3_seek_index_lru, index);
+	return index;
+}
+
+void
+mp3_seek_index_deinit(void)
+{
+	G_LOCK(mp3_seek_index);
+
+	if (mp3_seek_index_table != NULL) {
+		struct mp3_seek_index *index;
+		while ((index = g_queue_pop_head(&mp3_seek_index_lru)) != NULL)
+			mp3_seek_index_free(index);
+
+		g_hash_table_destroy(mp3_seek_index_table);
+		mp3_seek_index_table = NULL;
+	}
+
+	assert(mp3_seek_index_bytes == 0);
+
+	G_UNLOCK(mp3_seek_index);
+}
+
+bool
+mp3_seek_index_store(const char *key, goffset size, unsigned step,
+		     const goffset *offsets, unsigned length)
+{
+	assert(step > 0);
+
+	if (length == 0 ||
+	    mp3_seek_index_sizeof(length) > MP3_SEEK_INDEX_MAX_BYTES / 4)
+		return false;
+
+	struct mp3_seek_index *index =
+		g_malloc(mp3_seek_index_sizeof(length));
+	index->size = size;
+	index->step = step;
+	index->length = length;
+	index->base = offsets[0];
+
+	for (unsigned i = 1; i < length; ++i) {
+		goffset delta = offsets[i] - offsets[i - 1];
+		if (delta <= 0 || delta > (goffset)G_MAXUINT32) {
+			g_free(index);
+			return false;
+		}
+
+		index->deltas[i - 1] = (uint32_t)delta;
+	}
+
+	index->key = g_strdup(key);
+
+	G_LOCK(mp3_seek_index);
+
+	if (mp3_seek_index_table == NULL)
+		mp3_seek_index_table = g_hash_table_new(g_str_hash,
+							 g_str_equal);
+
+	struct mp3_seek_index *old =
+		g_hash_table_lookup(mp3_seek_index_table, key);
+	if (old != NULL)
+		mp3_seek_index_remove(old);
+
+	mp3_seek_index_bytes += mp3_seek_index_sizeof(length);
+
+	while (mp3_seek_index_bytes > MP3_SEEK_INDEX_MAX_BYTES) {
+		struct mp3_seek_index *oldest =
+			g_queue_peek_head(&mp3_seek_index_lru);
+		assert(oldest != NULL);
+
+		mp3_seek_index_remove(oldest);
+	}
+
+	g_hash_table_insert(mp3_seek_index_table, index->key, index);
+	g_queue_push_tail(&mp3_seek_index_lru, index);
+
+	G_UNLOCK(mp3_seek_index);
+
+	g_debug("stored %u offsets for %s", length, key);
+	return true;
+}
+
+unsigned
+mp3_seek_index_load(const char *key, goffset size, unsigned *step_r,
+		    goffset *offsets, unsigned max_length)
+{
+	unsigned length = 0;
+
+	G_LOCK(mp3_seek_index);
+
+	const struct mp3_seek_index *index =
+		mp3_seek_index_find(key, size);
+	if (index != NULL && max_length > 0) {
+		length = index->length;
+		if (length > max_length)
+			length = max_length;
+
+		*step_r = index->step;
+
+		goffset offset = index->base;
+		offsets[0] = offset;
+		for (unsigned i = 1; i < length; ++i) {
+			offset += index->deltas[i - 1];
+			offsets[i] = offset;
+		}
+	}
+
+	G_UNLOCK(mp3_seek_index);
+
+	return length;
+}
+
+unsigned
+mp3_seek_index_length(const char *key, goffset size)
+{
+	G_LOCK(mp3_seek_index);
+
+	const struct mp3_seek_index *index =
+		mp3_seek_index_find(key, size);
+	unsigned length = index != NULL ? index->length : 0;
+
+	G_UNLOCK(mp3_seek_index);
+
+	return length;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2003-2012 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A cache of frame offset tables for frame based formats (MP3).  A
+ * decoder records the byte offset of every n-th frame while playing a
+ * song, and stores the table here when it's done.  The next time the
+ * same song is opened, the table is restored, and seeking becomes a
+ * lookup instead of a linear scan through the file.
+ *
+ * The tables are stored as 32 bit deltas, which is much more compact
+ * than an array of #goffset values.  The total size of the cache is
+ * bounded; the oldest entries get evicted first.
+ */
+
+#ifndef MPD_DECODER_MP3_SEEK_INDEX_H
+#define MPD_DECODER_MP3_SEEK_INDEX_H
+
+#include "gcc.h"
+
+#include <glib.h>
+
+#include <stdbool.h>
+
+/**
+ * Frees all cached tables.  It is safe to call this function more
+ * than once.
+ */
+void
+mp3_seek_index_deinit(void);
+
+/**
+ * Stores a frame offset table in the cache, replacing an existing
+ * one for the same key.
+ *
+ * @param key a string identifying the song and the plugin which
+ * generated the table, e.g. "mad:" followed by the URI
+ * @param size the size of the file in bytes; used to detect
+ * modifications
+ * @param step the number of frames between two entries of the table
+ * @param offsets the absolute byte offsets; must be increasing
+ * @param length the number of elements in #offsets
+ * @return false if the table was not stored (empty, not monotonic,
+ * or too large for the cache)
+ */
+gcc_nonnull_all
+bool
+mp3_seek_index_store(const char *key, goffset size, unsigned step,
+		     const goffset *offsets, unsigned length);
+
+/**
+ * Looks up a frame offset table and expands it into the
+ * caller-supplied buffer.
+ *
+ * @param step_r receives the number of frames between two entries
+ * @param offsets the destination buffer
+ * @param max_length the capacity of #offsets
+ * @return the number of offsets which were restored (0 if there is
+ * no matching table)
+ */
+gcc_nonnull_all
+unsigned
+mp3_seek_index_load(const char *key, goffset size, unsigned *step_r,
+		    goffset *offsets, unsigned max_length);
+
+/**
+ * Returns the number of offsets of a cached table (without copying
+ * it), or 0 if there is none.  Useful for allocating a buffer for
+ * mp3_seek_index_load().
+ */
+gcc_nonnull_all
+unsigned
+mp3_seek_index_length(const char *key, goffset size);
+
+#endif
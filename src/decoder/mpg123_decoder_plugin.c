@@ -21,11 +21,13 @@
 #include "decoder_api.h"
 #include "audio_check.h"
 #include "tag_handler.h"
+#include "mp3_seek_index.h"
 
 #include <glib.h>
 
 #include <mpg123.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "mpg123"
@@ -41,9 +43,68 @@ mpd_mpg123_init(G_GNUC_UNUSED const struct config_param *param)
 static void
 mpd_mpg123_finish(void)
 {
+	mp3_seek_index_deinit();
 	mpg123_exit();
 }
 
+/**
+ * Restores the frame index of a file which has been played before
+ * from the seek index cache, so libmpg123 doesn't need to scan the
+ * file for seeking.
+ *
+ * @return the number of index entries which were restored
+ */
+static size_t
+mpd_mpg123_load_index(mpg123_handle *handle, const char *key, goffset size)
+{
+	unsigned length = mp3_seek_index_length(key, size);
+	if (length == 0)
+		return 0;
+
+	goffset *offsets = g_new(goffset, length);
+	unsigned step;
+	length = mp3_seek_index_load(key, size, &step, offsets, length);
+
+	off_t *index = g_new(off_t, length);
+	for (unsigned i = 0; i < length; ++i)
+		index[i] = (off_t)offsets[i];
+	g_free(offsets);
+
+	int error = mpg123_set_index(handle, index, step, length);
+	g_free(index);
+
+	if (error != MPG123_OK) {
+		g_debug("mpg123_set_index() failed: %s",
+			mpg123_plain_strerror(error));
+		return 0;
+	}
+
+	return length;
+}
+
+/**
+ * Stores the frame index in the seek index cache if libmpg123 has
+ * learned more about the file than was restored by
+ * mpd_mpg123_load_index().
+ */
+static void
+mpd_mpg123_store_index(mpg123_handle *handle, const char *key, goffset size,
+		       size_t loaded)
+{
+	off_t *index, step;
+	size_t fill;
+	if (mpg123_index(handle, &index, &step, &fill) != MPG123_OK ||
+	    fill <= loaded || step <= 0)
+		return;
+
+	goffset *offsets = g_new(goffset, fill);
+	for (size_t i = 0; i < fill; ++i)
+		offsets[i] = index[i];
+
+	mp3_seek_index_store(key, size, (unsigned)step, offsets, fill);
+	g_free(offsets);
+}
+
 /**
  * Opens a file with an existing #mpg123_handle.
  *
@@ -123,6 +184,13 @@ mpd_mpg123_file_decode(struct decoder *decoder, const char *path_fs)
 		return;
 	}
 
+	struct stat st;
+	const goffset size = stat(path_fs, &st) == 0 ? st.st_size : -1;
+	char *index_key = g_strconcat("mpg123:", path_fs, NULL);
+	const size_t loaded_index = size >= 0
+		? mpd_mpg123_load_index(handle, index_key, size)
+		: 0;
+
 	num_samples = mpg123_length(handle);
 
 	/* tell MPD core we're ready */
@@ -190,6 +258,10 @@ mpd_mpg123_file_decode(struct decoder *decoder, const char *path_fs)
 
 	/* cleanup */
 
+	if (size >= 0)
+		mpd_mpg123_store_index(handle, index_key, size, loaded_index);
+	g_free(index_key);
+
 	mpg123_delete(handle);
 }
 
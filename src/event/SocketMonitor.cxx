@@ -24,12 +24,14 @@
 #include "gcc.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
 #else
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 /*
@@ -160,6 +162,29 @@ SocketMonitor::Write(const void *data, size_t length)
 	return send(Get(), (const char *)data, length, flags);
 }
 
+#ifndef WIN32
+
+SocketMonitor::ssize_t
+SocketMonitor::WriteV(const struct iovec *iov, size_t n)
+{
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec *>(iov);
+	msg.msg_iovlen = n;
+
+	return sendmsg(Get(), &msg, flags);
+}
+
+#endif
+
 void
 SocketMonitor::CommitEventFlags()
 {
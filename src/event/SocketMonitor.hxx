@@ -38,6 +38,7 @@
 #endif
 
 class EventLoop;
+struct iovec;
 
 class SocketMonitor {
 	struct Source {
@@ -120,6 +121,14 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+#ifndef WIN32
+	/**
+	 * Writes several buffers with one system call
+	 * (scatter/gather).
+	 */
+	ssize_t WriteV(const struct iovec *iov, size_t n);
+#endif
+
 protected:
 	/**
 	 * @return false if the socket has been closed
@@ -24,18 +24,28 @@
 #include "FilterInternal.hxx"
 #include "FilterRegistry.hxx"
 #include "audio_format.h"
+#include "pcm/pcm_buffer.h"
+#include "pcm/PcmVolume.hxx"
 
 #include <glib.h>
 
 #include <list>
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 class ChainFilter final : public Filter {
 	struct Child {
 		const char *name;
 		Filter *filter;
 
+		/**
+		 * The input format of this filter, valid while the
+		 * chain is open.
+		 */
+		struct audio_format format;
+
 		Child(const char *_name, Filter *_filter)
 			:name(_name), filter(_filter) {}
 		~Child() {
@@ -48,6 +58,13 @@ class ChainFilter final : public Filter {
 
 	std::list<Child> children;
 
+	/**
+	 * The buffer in which in-place filters and merged gain stages
+	 * operate.  It is only allocated when the first such filter
+	 * needs a writable copy of its input.
+	 */
+	struct pcm_buffer buffer;
+
 public:
 	void Append(const char *name, Filter *filter) {
 		children.emplace_back(name, filter);
@@ -64,6 +81,20 @@ private:
 	 * #until itself is not closed.
 	 */
 	void CloseUntil(const Filter *until);
+
+	/**
+	 * Returns a writable copy of the specified data in #buffer,
+	 * unless it is already there.
+	 */
+	void *MakeWritable(const void *src, size_t size, bool &writable) {
+		if (writable)
+			return const_cast<void *>(src);
+
+		void *dest = pcm_buffer_get(&buffer, size);
+		memcpy(dest, src, size);
+		writable = true;
+		return dest;
+	}
 };
 
 static inline GQuark
@@ -126,6 +157,7 @@ ChainFilter::Open(audio_format &in_audio_format, GError **error_r)
 	const audio_format *audio_format = &in_audio_format;
 
 	for (auto &child : children) {
+		child.format = *audio_format;
 		audio_format = chain_open_child(child.name, child.filter,
 						*audio_format, error_r);
 		if (audio_format == NULL) {
@@ -135,6 +167,8 @@ ChainFilter::Open(audio_format &in_audio_format, GError **error_r)
 		}
 	}
 
+	pcm_buffer_init(&buffer);
+
 	/* return the output format of the last filter */
 	return audio_format;
 }
@@ -144,19 +178,69 @@ ChainFilter::Close()
 {
 	for (auto &child : children)
 		child.filter->Close();
+
+	pcm_buffer_deinit(&buffer);
 }
 
 const void *
 ChainFilter::FilterPCM(const void *src, size_t src_size,
 		       size_t *dest_size_r, GError **error_r)
 {
-	for (auto &child : children) {
-		/* feed the output of the previous filter as input
-		   into the current one */
-		src = child.filter->FilterPCM(src, src_size, &src_size,
-					      error_r);
-		if (src == NULL)
-			return NULL;
+	/* does "src" point to our own buffer, which may be
+	   modified? */
+	bool writable = false;
+
+	for (auto i = children.begin(), end = children.end(); i != end;) {
+		Filter *filter = i->filter;
+
+		unsigned volume;
+		if (filter->GetGain(volume)) {
+			/* merge this and all adjacent gain stages into
+			   one multiplication per sample */
+			const enum sample_format format =
+				sample_format(i->format.format);
+
+			unsigned next_volume;
+			for (++i; i != end && i->filter->GetGain(next_volume);
+			     ++i)
+				volume = ((uint64_t)volume * next_volume +
+					  PCM_VOLUME_1 / 2) / PCM_VOLUME_1;
+
+			if (volume == PCM_VOLUME_1)
+				/* no-op */
+				continue;
+
+			void *dest = MakeWritable(src, src_size, writable);
+			if (volume == 0)
+				memset(dest, 0, src_size);
+			else if (!pcm_volume(dest, src_size, format, volume)) {
+				g_set_error(error_r, filter_quark(), 0,
+					    "pcm_volume() has failed");
+				return NULL;
+			}
+
+			src = dest;
+			continue;
+		}
+
+		if (filter->IsInPlace()) {
+			void *dest = MakeWritable(src, src_size, writable);
+			if (!filter->FilterInPlace(dest, src_size, error_r))
+				return NULL;
+
+			src = dest;
+		} else {
+			/* feed the output of the previous filter as
+			   input into the current one */
+			src = filter->FilterPCM(src, src_size, &src_size,
+						error_r);
+			if (src == NULL)
+				return NULL;
+
+			writable = false;
+		}
+
+		++i;
 	}
 
 	/* return the output of the last filter */
@@ -31,6 +31,8 @@
 class NormalizeFilter final : public Filter {
 	struct Compressor *compressor;
 
+	enum sample_format format;
+
 	struct pcm_buffer buffer;
 
 public:
@@ -38,6 +40,13 @@ public:
 	virtual void Close();
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r, GError **error_r);
+
+	virtual bool IsInPlace() const {
+		return true;
+	}
+
+	virtual bool FilterInPlace(void *buffer, size_t size,
+				   GError **error_r);
 };
 
 static Filter *
@@ -50,7 +59,20 @@ normalize_filter_init(gcc_unused const struct config_param *param,
 const struct audio_format *
 NormalizeFilter::Open(audio_format &audio_format, gcc_unused GError **error_r)
 {
-	audio_format.format = SAMPLE_FORMAT_S16;
+	switch (audio_format.format) {
+	case SAMPLE_FORMAT_S16:
+	case SAMPLE_FORMAT_S24_P32:
+	case SAMPLE_FORMAT_S32:
+	case SAMPLE_FORMAT_FLOAT:
+		/* these are processed natively */
+		break;
+
+	default:
+		audio_format.format = SAMPLE_FORMAT_S16;
+		break;
+	}
+
+	format = sample_format(audio_format.format);
 
 	compressor = Compressor_new(0);
 	pcm_buffer_init(&buffer);
@@ -65,14 +87,47 @@ NormalizeFilter::Close()
 	Compressor_delete(compressor);
 }
 
+bool
+NormalizeFilter::FilterInPlace(void *buffer, size_t size,
+			       gcc_unused GError **error_r)
+{
+	switch (format) {
+	case SAMPLE_FORMAT_S16:
+		Compressor_Process_int16(compressor, (int16_t *)buffer,
+					 size / sizeof(int16_t));
+		break;
+
+	case SAMPLE_FORMAT_S24_P32:
+		Compressor_Process_int32(compressor, (int32_t *)buffer,
+					 size / sizeof(int32_t), 24);
+		break;
+
+	case SAMPLE_FORMAT_S32:
+		Compressor_Process_int32(compressor, (int32_t *)buffer,
+					 size / sizeof(int32_t), 32);
+		break;
+
+	case SAMPLE_FORMAT_FLOAT:
+		Compressor_Process_float(compressor, (float *)buffer,
+					 size / sizeof(float));
+		break;
+
+	default:
+		assert(false);
+		break;
+	}
+
+	return true;
+}
+
 const void *
 NormalizeFilter::FilterPCM(const void *src, size_t src_size,
-			   size_t *dest_size_r, gcc_unused GError **error_r)
+			   size_t *dest_size_r, GError **error_r)
 {
-	int16_t *dest = (int16_t *)pcm_buffer_get(&buffer, src_size);
+	void *dest = pcm_buffer_get(&buffer, src_size);
 	memcpy(dest, src, src_size);
 
-	Compressor_Process_int16(compressor, dest, src_size / 2);
+	FilterInPlace(dest, src_size, error_r);
 
 	*dest_size_r = src_size;
 	return dest;
@@ -119,6 +119,18 @@ public:
 	virtual void Close();
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r, GError **error_r);
+
+	virtual bool IsInPlace() const {
+		return true;
+	}
+
+	virtual bool FilterInPlace(void *buffer, size_t size,
+				   GError **error_r);
+
+	virtual bool GetGain(unsigned &volume_r) const {
+		volume_r = volume;
+		return true;
+	}
 };
 
 static inline GQuark
@@ -177,38 +189,49 @@ ReplayGainFilter::Close()
 	pcm_buffer_deinit(&buffer);
 }
 
-const void *
-ReplayGainFilter::FilterPCM(const void *src, size_t src_size,
-			    size_t *dest_size_r, GError **error_r)
+bool
+ReplayGainFilter::FilterInPlace(void *dest, size_t size, GError **error_r)
 {
-
-	*dest_size_r = src_size;
-
 	if (volume == PCM_VOLUME_1)
 		/* optimized special case: 100% volume = no-op */
-		return src;
+		return true;
 
-	void *dest = pcm_buffer_get(&buffer, src_size);
 	if (volume <= 0) {
 		/* optimized special case: 0% volume = memset(0) */
 		/* XXX is this valid for all sample formats? What
 		   about floating point? */
-		memset(dest, 0, src_size);
-		return dest;
+		memset(dest, 0, size);
+		return true;
 	}
 
-	memcpy(dest, src, src_size);
-
-	bool success = pcm_volume(dest, src_size,
+	bool success = pcm_volume(dest, size,
 				  sample_format(format.format),
 				  volume);
 	if (!success) {
 		g_set_error(error_r, replay_gain_quark(), 0,
 			    "pcm_volume() has failed");
-		return NULL;
+		return false;
 	}
 
-	return dest;
+	return true;
+}
+
+const void *
+ReplayGainFilter::FilterPCM(const void *src, size_t src_size,
+			    size_t *dest_size_r, GError **error_r)
+{
+	*dest_size_r = src_size;
+
+	if (volume == PCM_VOLUME_1)
+		/* optimized special case: 100% volume = no-op */
+		return src;
+
+	void *dest = pcm_buffer_get(&buffer, src_size);
+	memcpy(dest, src, src_size);
+
+	return FilterInPlace(dest, src_size, error_r)
+		? dest
+		: NULL;
 }
 
 const struct filter_plugin replay_gain_filter_plugin = {
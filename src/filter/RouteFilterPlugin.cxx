@@ -47,6 +47,7 @@
 #include "FilterPlugin.hxx"
 #include "FilterInternal.hxx"
 #include "FilterRegistry.hxx"
+#include "pcm/PcmRoute.hxx"
 #include "pcm/pcm_buffer.h"
 
 #include <assert.h>
@@ -87,16 +88,11 @@ class RouteFilter final : public Filter {
 	struct audio_format output_format;
 
 	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * input buffer
+	 * True if the routing table maps every input channel to
+	 * itself; FilterPCM() passes the data through unmodified
+	 * then.
 	 */
-	size_t input_frame_size;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * output buffer
-	 */
-	size_t output_frame_size;
+	bool identity;
 
 	/**
 	 * The output buffer used last time around, can be reused if the size doesn't differ.
@@ -246,15 +242,14 @@ RouteFilter::Open(audio_format &audio_format, gcc_unused GError **error_r)
 {
 	// Copy the input format for later reference
 	input_format = audio_format;
-	input_frame_size = audio_format_frame_size(&input_format);
 
 	// Decide on an output format which has enough channels,
 	// and is otherwise identical
 	output_format = audio_format;
 	output_format.channels = min_output_channels;
 
-	// Precalculate this simple value, to speed up allocation later
-	output_frame_size = audio_format_frame_size(&output_format);
+	identity = pcm_route_is_identity(min_output_channels,
+					 input_format.channels, sources);
 
 	// This buffer grows as needed
 	pcm_buffer_init(&output_buffer);
@@ -272,55 +267,15 @@ const void *
 RouteFilter::FilterPCM(const void *src, size_t src_size,
 		       size_t *dest_size_r, gcc_unused GError **error_r)
 {
-	size_t number_of_frames = src_size / input_frame_size;
-
-	size_t bytes_per_frame_per_channel =
-		audio_format_sample_size(&input_format);
-
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src;
-
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination;
-
-	// Grow our reusable buffer, if needed, and set the moving pointer
-	*dest_size_r = number_of_frames * output_frame_size;
-	chan_destination = (uint8_t *)
-		pcm_buffer_get(&output_buffer, *dest_size_r);
-
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned int c=0; c<min_output_channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				memset(chan_destination,
-					0x00,
-					bytes_per_frame_per_channel);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
+	if (identity) {
+		*dest_size_r = src_size;
+		return src;
 	}
 
-	// Here it is, ladies and gentlemen! Rerouted data!
-	return (void *) output_buffer.buffer;
+	return pcm_route(&output_buffer,
+			 audio_format_sample_size(&input_format),
+			 min_output_channels, input_format.channels,
+			 sources, src, src_size, dest_size_r);
 }
 
 const struct filter_plugin route_filter_plugin = {
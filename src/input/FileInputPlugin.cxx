@@ -22,11 +22,15 @@
 #include "InputInternal.hxx"
 #include "InputStream.hxx"
 #include "InputPlugin.hxx"
+#include "PipelineStats.hxx"
 #include "fd_util.h"
 #include "open.h"
 #include "io_error.h"
+#include "conf.h"
+#include "util/fifo_buffer.h"
 
 #include <sys/stat.h>
+#include <assert.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
@@ -35,25 +39,321 @@
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "input_file"
 
+StatHistogram file_input_stall_time;
+
+/**
+ * The maximum number of bytes the read-ahead thread reads with one
+ * system call.
+ */
+static constexpr size_t FILE_READ_AHEAD_CHUNK = 64 * 1024;
+
+/**
+ * The size of the read-ahead buffer in bytes.  0 disables the
+ * read-ahead thread, and the decoder reads from the file
+ * synchronously.
+ */
+static size_t file_read_ahead;
+
 struct FileInputStream {
 	struct input_stream base;
 
 	int fd;
 
+	/**
+	 * The size of the read-ahead buffer which will be allocated
+	 * by the first Read() call, or 0 if read-ahead is disabled
+	 * for this file.
+	 */
+	size_t read_ahead_size;
+
+	/**
+	 * The read-ahead buffer, or nullptr if the read-ahead thread
+	 * has not been started (yet).  All of the following
+	 * attributes are only used in read-ahead mode, and are
+	 * protected by base.mutex.
+	 */
+	struct fifo_buffer *buffer;
+
+	GThread *thread;
+
+	/**
+	 * Wakes up the read-ahead thread.  The base.cond is shared
+	 * with the decoder, so the thread needs a cond of its own.
+	 */
+	Cond thread_cond;
+
+	/**
+	 * The file offset of the end of #buffer, i.e. where the
+	 * read-ahead thread continues reading.
+	 */
+	goffset read_offset;
+
+	/**
+	 * Incremented by every seek, so the read-ahead thread knows
+	 * to discard a read which was in progress.
+	 */
+	unsigned generation;
+
+	bool quit;
+
+	/**
+	 * Has the read-ahead thread reached the end of the file?
+	 */
+	bool end_reached;
+
+	GError *postponed_error;
+
+	/**
+	 * Measures the time the client spends waiting for the
+	 * read-ahead thread.
+	 */
+	GTimer *stall_timer;
+
+	unsigned stall_count;
+
+	double stall_seconds;
+
 	FileInputStream(const char *path, int _fd, off_t size,
 			Mutex &mutex, Cond &cond)
 		:base(input_plugin_file, path, mutex, cond),
-		 fd(_fd) {
+		 fd(_fd), read_ahead_size(0),
+		 buffer(nullptr), thread(nullptr),
+		 read_offset(0), generation(0),
+		 quit(false), end_reached(false),
+		 postponed_error(nullptr), stall_timer(nullptr),
+		 stall_count(0), stall_seconds(0) {
 		base.size = size;
 		base.seekable = true;
 		base.ready = true;
 	}
 
 	~FileInputStream() {
+		StopReadAhead();
+
 		close(fd);
 	}
+
+	/**
+	 * Starts the read-ahead thread at the current offset.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	bool StartReadAhead(GError **error_r);
+	void StopReadAhead();
+
+	/**
+	 * The read-ahead thread.
+	 */
+	void ReadAheadLoop();
+
+	bool IsAvailable() const {
+		return !fifo_buffer_is_empty(buffer) || end_reached ||
+			postponed_error != nullptr;
+	}
+
+	bool Seek(goffset offset);
+	size_t Read(void *ptr, size_t size, GError **error_r);
 };
 
+static gpointer
+input_file_read_ahead_thread(gpointer data)
+{
+	FileInputStream *fis = (FileInputStream *)data;
+
+	fis->ReadAheadLoop();
+	return nullptr;
+}
+
+inline bool
+FileInputStream::StartReadAhead(GError **error_r)
+{
+	assert(read_ahead_size > 0);
+	assert(buffer == nullptr);
+	assert(thread == nullptr);
+
+	buffer = fifo_buffer_new(read_ahead_size);
+	read_offset = base.offset;
+	stall_timer = g_timer_new();
+
+#if GLIB_CHECK_VERSION(2,32,0)
+	(void)error_r;
+	thread = g_thread_new("file", input_file_read_ahead_thread, this);
+#else
+	thread = g_thread_create(input_file_read_ahead_thread, this, true,
+				 error_r);
+	if (thread == nullptr) {
+		fifo_buffer_free(buffer);
+		buffer = nullptr;
+		g_timer_destroy(stall_timer);
+		stall_timer = nullptr;
+		read_ahead_size = 0;
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+inline void
+FileInputStream::StopReadAhead()
+{
+	if (thread == nullptr)
+		return;
+
+	base.mutex.lock();
+	quit = true;
+	thread_cond.signal();
+	base.mutex.unlock();
+
+	g_thread_join(thread);
+	thread = nullptr;
+
+	if (stall_count > 0)
+		g_debug("%s: waited %u times for the disk, %.3f s total",
+			base.uri.c_str(), stall_count, stall_seconds);
+
+	file_input_stall_time.Add(unsigned(stall_seconds * 1000000));
+
+	fifo_buffer_free(buffer);
+	buffer = nullptr;
+
+	g_timer_destroy(stall_timer);
+	stall_timer = nullptr;
+
+	if (postponed_error != nullptr) {
+		g_error_free(postponed_error);
+		postponed_error = nullptr;
+	}
+}
+
+inline void
+FileInputStream::ReadAheadLoop()
+{
+	const ScopeLock protect(base.mutex);
+
+	while (!quit) {
+		size_t max_length;
+		void *dest = end_reached || postponed_error != nullptr
+			? nullptr
+			: fifo_buffer_write(buffer, &max_length);
+		if (dest == nullptr) {
+			/* buffer is full, or nothing more to read */
+			thread_cond.wait(base.mutex);
+			continue;
+		}
+
+		if (max_length > FILE_READ_AHEAD_CHUNK)
+			max_length = FILE_READ_AHEAD_CHUNK;
+
+		const unsigned old_generation = generation;
+		const goffset offset = read_offset;
+
+		base.mutex.unlock();
+
+		ssize_t nbytes = lseek(fd, (off_t)offset, SEEK_SET) < 0
+			? -1
+			: read(fd, dest, max_length);
+		const int e = errno;
+
+		base.mutex.lock();
+
+		if (generation != old_generation)
+			/* the client has seeked meanwhile; discard
+			   this data */
+			continue;
+
+		if (nbytes < 0)
+			postponed_error =
+				g_error_new(errno_quark(), e,
+					    "Failed to read: %s",
+					    g_strerror(e));
+		else if (nbytes == 0)
+			end_reached = true;
+		else {
+			fifo_buffer_append(buffer, nbytes);
+			read_offset += nbytes;
+		}
+
+		base.cond.broadcast();
+	}
+}
+
+inline bool
+FileInputStream::Seek(goffset offset)
+{
+	assert(buffer != nullptr);
+
+	size_t length;
+	if (offset >= base.offset &&
+	    fifo_buffer_read(buffer, &length) != nullptr &&
+	    offset - base.offset <= (goffset)length) {
+		/* the new position is already in the buffer */
+		fifo_buffer_consume(buffer, offset - base.offset);
+	} else {
+		fifo_buffer_clear(buffer);
+		read_offset = offset;
+		++generation;
+		end_reached = false;
+
+		if (postponed_error != nullptr) {
+			g_error_free(postponed_error);
+			postponed_error = nullptr;
+		}
+
+		thread_cond.signal();
+	}
+
+	base.offset = offset;
+	return true;
+}
+
+inline size_t
+FileInputStream::Read(void *ptr, size_t size, GError **error_r)
+{
+	assert(buffer != nullptr);
+
+	if (!IsAvailable()) {
+		g_timer_start(stall_timer);
+
+		do {
+			base.cond.wait(base.mutex);
+		} while (!IsAvailable());
+
+		++stall_count;
+		stall_seconds += g_timer_elapsed(stall_timer, nullptr);
+	}
+
+	size_t length;
+	const void *src = fifo_buffer_read(buffer, &length);
+	if (src == nullptr) {
+		if (postponed_error != nullptr) {
+			g_propagate_error(error_r, postponed_error);
+			postponed_error = nullptr;
+		}
+
+		return 0;
+	}
+
+	if (size > length)
+		size = length;
+
+	memcpy(ptr, src, size);
+	fifo_buffer_consume(buffer, size);
+	thread_cond.signal();
+
+	base.offset += size;
+	return size;
+}
+
+static bool
+input_file_init(const struct config_param *param,
+		G_GNUC_UNUSED GError **error_r)
+{
+	file_read_ahead = config_get_block_unsigned(param, "read_ahead", 0) *
+		(size_t)1024;
+	return true;
+}
+
 static struct input_stream *
 input_file_open(const char *filename,
 		Mutex &mutex, Cond &cond,
@@ -96,6 +396,16 @@ input_file_open(const char *filename,
 
 	FileInputStream *fis = new FileInputStream(filename, fd, st.st_size,
 						   mutex, cond);
+
+	/* the read-ahead thread is started by the first read, so
+	   streams which are only opened and probed don't cause
+	   additional I/O */
+	if (file_read_ahead > 0 && st.st_size > 0) {
+		fis->read_ahead_size = file_read_ahead;
+		if ((goffset)fis->read_ahead_size > (goffset)st.st_size)
+			fis->read_ahead_size = st.st_size;
+	}
+
 	return &fis->base;
 }
 
@@ -105,6 +415,33 @@ input_file_seek(struct input_stream *is, goffset offset, int whence,
 {
 	FileInputStream *fis = (FileInputStream *)is;
 
+	if (fis->buffer != nullptr) {
+		switch (whence) {
+		case SEEK_SET:
+			break;
+
+		case SEEK_CUR:
+			offset += is->offset;
+			break;
+
+		case SEEK_END:
+			offset += is->size;
+			break;
+
+		default:
+			offset = -1;
+			break;
+		}
+
+		if (offset < 0) {
+			g_set_error(error_r, errno_quark(), EINVAL,
+				    "Failed to seek: %s", g_strerror(EINVAL));
+			return false;
+		}
+
+		return fis->Seek(offset);
+	}
+
 	offset = (goffset)lseek(fis->fd, (off_t)offset, whence);
 	if (offset < 0) {
 		g_set_error(error_r, errno_quark(), errno,
@@ -123,6 +460,13 @@ input_file_read(struct input_stream *is, void *ptr, size_t size,
 	FileInputStream *fis = (FileInputStream *)is;
 	ssize_t nbytes;
 
+	if (fis->buffer == nullptr && fis->read_ahead_size > 0 &&
+	    !fis->StartReadAhead(error_r))
+		return 0;
+
+	if (fis->buffer != nullptr)
+		return fis->Read(ptr, size, error_r);
+
 	nbytes = read(fis->fd, ptr, size);
 	if (nbytes < 0) {
 		g_set_error(error_r, errno_quark(), errno,
@@ -142,6 +486,27 @@ input_file_close(struct input_stream *is)
 	delete fis;
 }
 
+static bool
+input_file_check(struct input_stream *is, GError **error_r)
+{
+	FileInputStream *fis = (FileInputStream *)is;
+
+	if (fis->postponed_error == nullptr)
+		return true;
+
+	g_propagate_error(error_r, fis->postponed_error);
+	fis->postponed_error = nullptr;
+	return false;
+}
+
+static bool
+input_file_available(struct input_stream *is)
+{
+	FileInputStream *fis = (FileInputStream *)is;
+
+	return fis->buffer == nullptr || fis->IsAvailable();
+}
+
 static bool
 input_file_eof(struct input_stream *is)
 {
@@ -150,14 +515,14 @@ input_file_eof(struct input_stream *is)
 
 const struct input_plugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 	input_file_close,
+	input_file_check,
 	nullptr,
 	nullptr,
-	nullptr,
-	nullptr,
+	input_file_available,
 	input_file_read,
 	input_file_eof,
 	input_file_seek,
@@ -20,6 +20,16 @@
 #ifndef MPD_INPUT_FILE_HXX
 #define MPD_INPUT_FILE_HXX
 
+class StatHistogram;
+
 extern const struct input_plugin input_plugin_file;
 
+/**
+ * Microseconds each file stream spent waiting for its read-ahead
+ * thread, summed up over the life time of the stream; this is
+ * usually one value per song.  Streams without read-ahead are not
+ * counted.
+ */
+extern StatHistogram file_input_stall_time;
+
 #endif
@@ -100,6 +100,13 @@ gcc_nonnull(1)
 void
 input_stream_lock_wait_ready(struct input_stream *is);
 
+/**
+ * Returns the absolute URI which was used to open this stream.
+ */
+gcc_nonnull_all gcc_pure
+const char *
+input_stream_get_uri(const struct input_stream *is);
+
 gcc_nonnull_all gcc_pure
 const char *
 input_stream_get_mime_type(const struct input_stream *is);
@@ -28,18 +28,22 @@
 #include <assert.h>
 #include <string.h>
 
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "httpd_output"
 
+/**
+ * The maximum number of pages sent with one system call.
+ */
+static constexpr size_t HTTPD_MAX_IOV = 16;
+
 HttpdClient::~HttpdClient()
 {
-	if (state == RESPONSE) {
-		if (current_page != nullptr)
-			current_page->Unref();
-
-		for (auto page : pages)
-			page->Unref();
-	}
+	if (state == RESPONSE && current_page != nullptr)
+		current_page->Unref();
 
 	if (metadata)
 		metadata->Unref();
@@ -63,10 +67,21 @@ HttpdClient::BeginResponse()
 {
 	assert(state != RESPONSE);
 
+	const ScopeLock protect(httpd->mutex);
+
 	state = RESPONSE;
-	current_page = nullptr;
 
-	httpd->SendHeader(*this);
+	/* send the encoder header first, and then start with the
+	   burst of recent pages (if configured) */
+	current_page = stream->header;
+	current_position = 0;
+	if (current_page != nullptr)
+		current_page->Ref();
+
+	next_page = stream->GetBurstStart(httpd->burst_size);
+
+	if (current_page != nullptr || next_page < stream->GetEndPage())
+		ScheduleWrite();
 }
 
 /**
@@ -84,7 +99,29 @@ HttpdClient::HandleLine(const char *line)
 			return false;
 		}
 
-		line = strchr(line + 5, ' ');
+		/* select the stream by the request path (without
+		   the query string) */
+		const char *path = line + 4;
+		line = strchr(path, ' ');
+		size_t path_length = line != nullptr
+			? line - path
+			: strlen(path);
+		const char *query = (const char *)
+			memchr(path, '?', path_length);
+		if (query != nullptr)
+			path_length = query - path;
+
+		HttpdStream *found = httpd->FindStream(path, path_length);
+		if (found == nullptr) {
+			g_debug("no stream for path %.*s",
+				int(path_length), path);
+			SendNotFound();
+			return false;
+		}
+
+		stream = found;
+		metadata_supported = !stream->HasEncoderTags();
+
 		if (line == nullptr || strncmp(line + 1, "HTTP/", 5) != 0) {
 			/* HTTP/0.9 without request headers */
 			BeginResponse();
@@ -142,7 +179,7 @@ HttpdClient::SendResponse()
 			   "realTimeInfo.dlna.org: DLNA.ORG_TLAG=*\r\n"
 			   "contentFeatures.dlna.org: DLNA.ORG_OP=01;DLNA.ORG_CI=0\r\n"
 			   "\r\n",
-			   httpd->content_type);
+			   stream->content_type);
 
 	} else if (metadata_requested) {
 		gchar *metadata_header;
@@ -150,7 +187,7 @@ HttpdClient::SendResponse()
 		metadata_header =
 			icy_server_metadata_header(httpd->name, httpd->genre,
 						   httpd->website,
-						   httpd->content_type,
+						   stream->content_type,
 						   metaint);
 
 		g_strlcpy(buffer, metadata_header, sizeof(buffer));
@@ -165,7 +202,7 @@ HttpdClient::SendResponse()
 			   "Pragma: no-cache\r\n"
 			   "Cache-Control: no-cache, no-store\r\n"
 			   "\r\n",
-			   httpd->content_type);
+			   stream->content_type);
 	}
 
 	ssize_t nbytes = SocketMonitor::Write(buffer, strlen(buffer));
@@ -179,13 +216,26 @@ HttpdClient::SendResponse()
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput *_httpd, int _fd, EventLoop &_loop,
-			 bool _metadata_supported)
+void
+HttpdClient::SendNotFound()
+{
+	static constexpr char response[] =
+		"HTTP/1.1 404 Not Found\r\n"
+		"Content-Type: text/plain\r\n"
+		"Connection: close\r\n"
+		"\r\n"
+		"No such stream\r\n";
+
+	/* best effort; the connection is closed anyway */
+	SocketMonitor::Write(response, sizeof(response) - 1);
+}
+
+HttpdClient::HttpdClient(HttpdOutput *_httpd, int _fd, EventLoop &_loop)
 	:BufferedSocket(_fd, _loop),
-	 httpd(_httpd),
+	 httpd(_httpd), stream(&_httpd->streams.front()),
 	 state(REQUEST),
 	 dlna_streaming_requested(false),
-	 metadata_supported(_metadata_supported),
+	 metadata_supported(!stream->HasEncoderTags()),
 	 metadata_requested(false), metadata_sent(true),
 	 metaint(8192), /*TODO: just a std value */
 	 metadata(nullptr),
@@ -193,27 +243,13 @@ HttpdClient::HttpdClient(HttpdOutput *_httpd, int _fd, EventLoop &_loop,
 {
 }
 
-size_t
-HttpdClient::GetQueueSize() const
-{
-	if (state != RESPONSE)
-		return 0;
-
-	size_t size = 0;
-	for (auto page : pages)
-		size += page->size;
-	return size;
-}
-
 void
 HttpdClient::CancelQueue()
 {
 	if (state != RESPONSE)
 		return;
 
-	for (auto page : pages)
-		page->Unref();
-	pages.clear();
+	next_page = stream->GetEndPage();
 
 	if (current_page == nullptr)
 		CancelWrite();
@@ -230,17 +266,96 @@ HttpdClient::TryWritePage(const Page &page, size_t position)
 ssize_t
 HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
 {
-	return n >= 0
+	return n >= 0 && size_t(n) < page.size - position
 		? Write(page.data + position, n)
 		: TryWritePage(page, position);
 }
 
+ssize_t
+HttpdClient::TryWritePages(ssize_t limit)
+{
+#ifdef WIN32
+	return TryWritePageN(*current_page, current_position, limit);
+#else
+	assert(current_position < current_page->size);
+
+	struct iovec iov[HTTPD_MAX_IOV];
+	size_t n = 0, total = 0;
+
+	const Page *page = current_page;
+	size_t position = current_position;
+	uint64_t sequence = next_page;
+
+	while (true) {
+		size_t size = page->size - position;
+		if (limit >= 0 && total + size > size_t(limit))
+			size = limit - total;
+
+		iov[n].iov_base = const_cast<unsigned char *>(page->data +
+							      position);
+		iov[n].iov_len = size;
+		++n;
+		total += size;
+
+		if (n >= HTTPD_MAX_IOV ||
+		    (limit >= 0 && total >= size_t(limit)))
+			break;
+
+		page = stream->GetPage(sequence++);
+		if (page == nullptr)
+			break;
+
+		position = 0;
+	}
+
+	return n == 1
+		? Write(iov[0].iov_base, iov[0].iov_len)
+		: WriteV(iov, n);
+#endif
+}
+
+void
+HttpdClient::ConsumePages(size_t nbytes)
+{
+	size_t rest = current_page->size - current_position;
+	if (nbytes < rest) {
+		current_position += nbytes;
+		return;
+	}
+
+	nbytes -= rest;
+	current_page->Unref();
+	current_page = nullptr;
+
+	/* the following pages were sent without taking a reference,
+	   they are still in the ring */
+	while (nbytes > 0) {
+		Page *page = stream->GetPage(next_page);
+		assert(page != nullptr);
+		++next_page;
+
+		if (nbytes < page->size) {
+			page->Ref();
+			current_page = page;
+			current_position = nbytes;
+			return;
+		}
+
+		nbytes -= page->size;
+	}
+}
+
 ssize_t
 HttpdClient::GetBytesTillMetaData() const
 {
-	if (metadata_requested &&
-	    current_page->size - current_position > metaint - metadata_fill)
+	if (metadata_requested) {
+		assert(metadata_fill <= metaint);
+
+		/* always pass the limit, even if the current page
+		   ends before the metadata boundary: TryWritePages()
+		   may gather the following pages as well */
 		return metaint - metadata_fill;
+	}
 
 	return -1;
 }
@@ -253,7 +368,16 @@ HttpdClient::TryWrite()
 	assert(state == RESPONSE);
 
 	if (current_page == nullptr) {
-		if (pages.empty()) {
+		if (next_page < stream->first_page) {
+			/* the pages this client was going to read
+			   have been dropped from the ring meanwhile */
+			g_debug("client is too slow, skipping %u pages",
+				unsigned(stream->first_page - next_page));
+			next_page = stream->GetEndPage();
+		}
+
+		current_page = stream->GetPage(next_page);
+		if (current_page == nullptr) {
 			/* another thread has removed the event source
 			   while this thread was waiting for
 			   httpd->mutex */
@@ -261,8 +385,8 @@ HttpdClient::TryWrite()
 			return true;
 		}
 
-		current_page = pages.front();
-		pages.pop_front();
+		current_page->Ref();
+		++next_page;
 		current_position = 0;
 	}
 
@@ -316,9 +440,7 @@ HttpdClient::TryWrite()
 			metadata_current_position = 0;
 		}
 	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
+		ssize_t nbytes = TryWritePages(bytes_to_write);
 		if (nbytes < 0) {
 			auto e = GetSocketError();
 			if (IsSocketErrorAgain(e))
@@ -334,36 +456,30 @@ HttpdClient::TryWrite()
 			return false;
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
-
-		if (metadata_requested)
+		if (metadata_requested) {
 			metadata_fill += nbytes;
+			assert(metadata_fill <= metaint);
+		}
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
+		ConsumePages(nbytes);
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (current_page == nullptr &&
+		    next_page >= stream->GetEndPage())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
 }
 
 void
-HttpdClient::PushPage(Page *page)
+HttpdClient::OnNewPage()
 {
 	if (state != RESPONSE)
 		/* the client is still writing the HTTP request */
 		return;
 
-	page->Ref();
-	pages.push_back(page);
-
 	ScheduleWrite();
 }
 
@@ -419,7 +535,6 @@ HttpdClient::OnSocketInput(const void *data, size_t length)
 	*const_cast<char *>(newline) = 0;
 
 	if (!HandleLine(line)) {
-		assert(state == RESPONSE);
 		LockClose();
 		return InputResult::CLOSED;
 	}
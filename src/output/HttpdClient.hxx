@@ -23,11 +23,11 @@
 #include "event/BufferedSocket.hxx"
 #include "gcc.h"
 
-#include <list>
-
 #include <stddef.h>
+#include <stdint.h>
 
 struct HttpdOutput;
+struct HttpdStream;
 class Page;
 
 class HttpdClient final : public BufferedSocket {
@@ -36,6 +36,11 @@ class HttpdClient final : public BufferedSocket {
 	 */
 	HttpdOutput *const httpd;
 
+	/**
+	 * The stream selected by the request path.
+	 */
+	HttpdStream *stream;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -51,9 +56,10 @@ class HttpdClient final : public BufferedSocket {
 	} state;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
+	 * The sequence number of the next page in the
+	 * HttpdStream::pages ring to be sent to the client.
 	 */
-	std::list<Page *> pages;
+	uint64_t next_page;
 
 	/**
 	 * The #page which is currently being sent to the client.
@@ -115,8 +121,7 @@ public:
 	 * @param httpd the HTTP output device
 	 * @param fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput *httpd, int _fd, EventLoop &_loop,
-		    bool _metadata_supported);
+	HttpdClient(HttpdOutput *httpd, int _fd, EventLoop &_loop);
 
 	/**
 	 * Note: this does not remove the client from the
@@ -131,14 +136,15 @@ public:
 
 	void LockClose();
 
-	/**
-	 * Returns the total size of this client's page queue.
-	 */
-	gcc_pure
-	size_t GetQueueSize() const;
+	const HttpdStream *GetStream() const {
+		return stream;
+	}
 
 	/**
-	 * Clears the page queue.
+	 * Skips all pages which are in the ring, and continues with
+	 * the next page which will be generated.
+	 *
+	 * Caller must lock the mutex.
 	 */
 	void CancelQueue();
 
@@ -157,18 +163,47 @@ public:
 	 */
 	bool SendResponse();
 
+	/**
+	 * Sends a "404 Not Found" response for a request path which
+	 * doesn't select a stream.
+	 */
+	void SendNotFound();
+
 	gcc_pure
 	ssize_t GetBytesTillMetaData() const;
 
 	ssize_t TryWritePage(const Page &page, size_t position);
 	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
 
+	/**
+	 * Writes the rest of #current_page and as many of the
+	 * following pages in the ring as possible with one system
+	 * call.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @param limit the maximum number of bytes to be written, or
+	 * -1 for no limit
+	 */
+	ssize_t TryWritePages(ssize_t limit);
+
+	/**
+	 * Advances #current_page and #next_page after the specified
+	 * number of bytes has been sent by TryWritePages().
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void ConsumePages(size_t nbytes);
+
 	bool TryWrite();
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Called by the #HttpdOutput when a new page has been
+	 * appended to the ring.
+	 *
+	 * Caller must lock the mutex.
 	 */
-	void PushPage(Page *page);
+	void OnNewPage();
 
 	/**
 	 * Sends the passed metadata.
@@ -31,27 +31,44 @@
 #include "event/ServerSocket.hxx"
 
 #include <forward_list>
+#include <deque>
+#include <list>
+#include <string>
+
+#include <stdint.h>
 
 struct config_param;
 class EventLoop;
 class ServerSocket;
 class HttpdClient;
 class Page;
+class Filter;
 
-struct HttpdOutput final : private ServerSocket {
-	struct audio_output base;
-
+/**
+ * One encoded stream of an #HttpdOutput.  Every stream has its own
+ * encoder and page ring; a client selects a stream by the path in
+ * its request.
+ */
+struct HttpdStream {
 	/**
-	 * True if the audio output is open and accepts client
-	 * connections.
+	 * The path which selects this stream, e.g. "/high.mp3".  The
+	 * default stream has an empty path; it is used for all
+	 * requests which don't match another stream.
 	 */
-	bool open;
+	const std::string path;
 
 	/**
 	 * The configured encoder plugin.
 	 */
 	struct encoder *encoder;
 
+	/**
+	 * Converts the audio format of the output to the one
+	 * requested by the #encoder.  Only used by additional
+	 * streams; nullptr for the default stream.
+	 */
+	Filter *convert_filter;
+
 	/**
 	 * Number of bytes which were fed into the encoder, without
 	 * ever receiving new output.  This is used to estimate
@@ -65,6 +82,111 @@ struct HttpdOutput final : private ServerSocket {
 	 */
 	const char *content_type;
 
+	/**
+	 * The header page, which is sent to every client on connect.
+	 */
+	Page *header;
+
+	/**
+	 * The most recent pages generated by the encoder.  All
+	 * clients read from this ring, each at its own position
+	 * (see HttpdClient::next_page).  Protected by
+	 * HttpdOutput::mutex.
+	 */
+	std::deque<Page *> pages;
+
+	/**
+	 * The sequence number of the first element of #pages.  Page
+	 * sequence numbers increase monotonically, and are never
+	 * reused.
+	 */
+	uint64_t first_page;
+
+	/**
+	 * The sequence number of the first page after the current
+	 * #header.  A burst must not include data which belongs to
+	 * an older header.
+	 */
+	uint64_t header_page;
+
+	/**
+	 * The total size of all #pages.
+	 */
+	size_t pages_size;
+
+	HttpdStream(const char *_path)
+		:path(_path), encoder(nullptr), convert_filter(nullptr),
+		 unflushed_input(0), header(nullptr),
+		 first_page(0), header_page(0), pages_size(0) {}
+
+	~HttpdStream();
+
+	HttpdStream(const HttpdStream &) = delete;
+	HttpdStream &operator=(const HttpdStream &) = delete;
+
+	/**
+	 * Does this stream use encoder tags instead of Icy-Metadata?
+	 */
+	gcc_pure
+	bool HasEncoderTags() const;
+
+	/**
+	 * @return the sequence number of the page after the newest
+	 * one
+	 *
+	 * Caller must lock the mutex.
+	 */
+	uint64_t GetEndPage() const {
+		return first_page + pages.size();
+	}
+
+	/**
+	 * Returns the page with the specified sequence number, or
+	 * nullptr if it is not (yet or anymore) in the ring.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	Page *GetPage(uint64_t sequence) const {
+		return sequence >= first_page && sequence < GetEndPage()
+			? pages[sequence - first_page]
+			: nullptr;
+	}
+
+	/**
+	 * Determines where a new client starts reading, according
+	 * to the configured burst size.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	uint64_t GetBurstStart(size_t burst_size) const;
+
+	/**
+	 * Removes all pages from the ring.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void ClearPages();
+};
+
+struct HttpdOutput final : private ServerSocket {
+	struct audio_output base;
+
+	/**
+	 * True if the audio output is open and accepts client
+	 * connections.
+	 */
+	bool open;
+
+	/**
+	 * The encoded streams.  The first one is the default stream
+	 * configured with the "encoder" setting, the others are
+	 * configured with "stream" settings.  All of them are fed
+	 * from the same PCM data.
+	 */
+	std::list<HttpdStream> streams;
+
 	/**
 	 * This mutex protects the listener socket and the client
 	 * list.
@@ -77,11 +199,6 @@ struct HttpdOutput final : private ServerSocket {
 	 */
 	struct timer *timer;
 
-	/**
-	 * The header page, which is sent to every client on connect.
-	 */
-	Page *header;
-
 	/**
 	 * The metadata, which is sent to every client.
 	 */
@@ -106,6 +223,13 @@ struct HttpdOutput final : private ServerSocket {
 	 */
 	std::forward_list<HttpdClient> clients;
 
+	/**
+	 * The configured amount of recent data sent to a new client
+	 * right after the header, so it can fill its buffer quickly
+	 * and start playing.  0 disables this.
+	 */
+	size_t burst_size;
+
 	/**
 	 * A temporary buffer for the httpd_output_read_page()
 	 * function.
@@ -123,15 +247,26 @@ struct HttpdOutput final : private ServerSocket {
 
 	bool Configure(const config_param *param, GError **error_r);
 
+	/**
+	 * Parses a "stream" setting and adds a new #HttpdStream.
+	 */
+	bool ConfigureStream(const char *value, GError **error_r);
+
 	bool Bind(GError **error_r);
 	void Unbind();
 
 	/**
 	 * Caller must lock the mutex.
 	 */
-	bool OpenEncoder(struct audio_format *audio_format,
+	bool OpenEncoder(HttpdStream &stream,
+			 struct audio_format *audio_format,
 			 GError **error_r);
 
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void CloseEncoder(HttpdStream &stream);
+
 	/**
 	 * Caller must lock the mutex.
 	 */
@@ -164,36 +299,70 @@ struct HttpdOutput final : private ServerSocket {
 	void AddClient(int fd);
 
 	/**
-	 * Removes a client from the httpd_output.clients linked list.
+	 * Returns the stream which is selected by the specified
+	 * request path (without the query string), or nullptr if
+	 * there is no such stream.
 	 */
-	void RemoveClient(HttpdClient &client);
+	gcc_pure
+	HttpdStream *FindStream(const char *path, size_t length);
 
 	/**
-	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
+	 * Removes all pages from the rings of all streams.
+	 *
+	 * Caller must lock the mutex.
 	 */
-	void SendHeader(HttpdClient &client) const;
+	void ClearPages();
+
+	/**
+	 * Removes a client from the httpd_output.clients linked list.
+	 */
+	void RemoveClient(HttpdClient &client);
+
 
 	/**
 	 * Reads data from the encoder (as much as available) and
 	 * returns it as a new #page object.
 	 */
-	Page *ReadPage();
+	Page *ReadPage(HttpdStream &stream);
 
 	/**
-	 * Broadcasts a page struct to all clients.
+	 * Appends a page to the ring, drops the oldest pages which
+	 * exceed its capacity and wakes up the clients of this
+	 * stream.
 	 *
 	 * Mutext must not be locked.
 	 */
-	void BroadcastPage(Page *page);
+	void BroadcastPage(HttpdStream &stream, Page *page);
 
 	/**
-	 * Broadcasts data from the encoder to all clients.
+	 * Like BroadcastPage(), but the caller must lock the mutex.
 	 */
-	void BroadcastFromEncoder();
+	void BroadcastPageLocked(HttpdStream &stream, Page *page);
+
+	/**
+	 * Makes the page the new header of the stream, and appends
+	 * it to the ring for the clients which are already
+	 * connected.  Both happens in one critical section, so a
+	 * client which connects meanwhile doesn't get the header
+	 * twice.  The caller's reference is passed to the stream.
+	 *
+	 * Mutext must not be locked.
+	 */
+	void BroadcastHeader(HttpdStream &stream, Page *page);
+
+	/**
+	 * Broadcasts data from the encoder to all clients of this
+	 * stream.
+	 */
+	void BroadcastFromEncoder(HttpdStream &stream);
+
+	bool EncodeAndPlay(HttpdStream &stream,
+			   const void *chunk, size_t size, GError **error_r);
 
 	bool EncodeAndPlay(const void *chunk, size_t size, GError **error_r);
 
+	void SendTag(HttpdStream &stream, const struct tag *tag);
+
 	void SendTag(const struct tag *tag);
 
 private:
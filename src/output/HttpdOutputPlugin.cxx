@@ -24,13 +24,21 @@
 #include "output_api.h"
 #include "encoder_plugin.h"
 #include "EncoderList.hxx"
+#include "SharedEncoder.hxx"
 #include "resolver.h"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "fd_util.h"
 #include "Main.hxx"
+#include "FilterPlugin.hxx"
+#include "FilterInternal.hxx"
+#include "FilterRegistry.hxx"
+#include "filter/ConvertFilterPlugin.hxx"
+#include "ConfigData.hxx"
+#include "audio_format.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -44,6 +52,13 @@
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "httpd_output"
 
+/**
+ * The amount of data a client may lag behind the newest page (in
+ * addition to the burst) before it is considered too slow and
+ * skips ahead.
+ */
+static constexpr size_t HTTPD_MAX_CLIENT_LAG = 256 * 1024;
+
 /**
  * The quark used for GError.domain.
  */
@@ -53,10 +68,25 @@ httpd_output_quark(void)
 	return g_quark_from_static_string("httpd_output");
 }
 
+HttpdStream::~HttpdStream()
+{
+	assert(pages.empty());
+
+	delete convert_filter;
+
+	if (encoder != nullptr)
+		encoder_finish(encoder);
+}
+
+bool
+HttpdStream::HasEncoderTags() const
+{
+	return encoder->plugin->tag != nullptr;
+}
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop)
 	:ServerSocket(_loop),
-	 encoder(nullptr), unflushed_input(0),
 	 metadata(nullptr)
 {
 }
@@ -65,10 +95,6 @@ HttpdOutput::~HttpdOutput()
 {
 	if (metadata != nullptr)
 		metadata->Unref();
-
-	if (encoder != nullptr)
-		encoder_finish(encoder);
-
 }
 
 inline bool
@@ -112,6 +138,9 @@ HttpdOutput::Configure(const config_param *param, GError **error_r)
 
 	clients_max = config_get_block_unsigned(param,"max_clients", 0);
 
+	burst_size = config_get_block_unsigned(param, "burst_size", 0) *
+		(size_t)1024;
+
 	/* set up bind_to_address */
 
 	const char *bind_to_address =
@@ -125,18 +154,169 @@ HttpdOutput::Configure(const config_param *param, GError **error_r)
 
 	/* initialize encoder */
 
-	encoder = encoder_init(encoder_plugin, param, error_r);
-	if (encoder == nullptr)
+	streams.emplace_back("");
+	HttpdStream &stream = streams.back();
+
+	stream.encoder = shared_encoder_init(encoder_plugin, param, error_r);
+	if (stream.encoder == nullptr)
 		return false;
 
 	/* determine content type */
-	content_type = encoder_get_mime_type(encoder);
-	if (content_type == nullptr)
-		content_type = "application/octet-stream";
+	stream.content_type = encoder_get_mime_type(stream.encoder);
+	if (stream.content_type == nullptr)
+		stream.content_type = "application/octet-stream";
+
+	/* additional streams */
+
+	for (const auto &bp : param->block_params) {
+		if (bp.name != "stream")
+			continue;
+
+		bp.used = true;
+
+		if (!ConfigureStream(bp.value.c_str(), error_r))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Splits the value of a "stream" setting into words at white space.
+ * Double quotes group characters including white space, and are
+ * removed, e.g. name="My Radio" becomes one word: name=My Radio.
+ *
+ * @return false if a quote is not terminated
+ */
+static bool
+httpd_split_words(const char *p, std::list<std::string> &words)
+{
+	while (true) {
+		while (*p == ' ' || *p == '\t')
+			++p;
+
+		if (*p == 0)
+			return true;
+
+		std::string word;
+		while (*p != 0 && *p != ' ' && *p != '\t') {
+			if (*p == '"') {
+				const char *end = strchr(p + 1, '"');
+				if (end == nullptr)
+					return false;
+
+				word.append(p + 1, end);
+				p = end + 1;
+			} else
+				word.push_back(*p++);
+		}
+
+		words.push_back(std::move(word));
+	}
+}
+
+/**
+ * Parses the value of a "stream" setting, e.g. "/high.mp3
+ * encoder=lame bitrate=320".  The first word is the path, the
+ * following "name=value" pairs configure the encoder just like the
+ * settings of an "audio_output" block.
+ */
+bool
+HttpdOutput::ConfigureStream(const char *value, GError **error_r)
+{
+	std::list<std::string> words;
+	if (!httpd_split_words(value, words) || words.empty() ||
+	    words.front()[0] != '/') {
+		g_set_error(error_r, httpd_output_quark(), 0,
+			    "Malformed stream setting: %s", value);
+		return false;
+	}
+
+	const std::string path = std::move(words.front());
+	words.pop_front();
+
+	for (const auto &stream : streams) {
+		if (stream.path == path) {
+			g_set_error(error_r, httpd_output_quark(), 0,
+				    "Duplicate stream path: %s", path.c_str());
+			return false;
+		}
+	}
+
+	config_param encoder_param;
+	for (const auto &word : words) {
+		const auto eq = word.find('=');
+		if (eq == std::string::npos || eq == 0) {
+			g_set_error(error_r, httpd_output_quark(), 0,
+				    "Malformed stream setting: %s", value);
+			return false;
+		}
+
+		encoder_param.AddBlockParam(word.substr(0, eq).c_str(),
+					    word.c_str() + eq + 1);
+	}
+
+	const char *encoder_name =
+		config_get_block_string(&encoder_param, "encoder", "vorbis");
+	const struct encoder_plugin *encoder_plugin =
+		encoder_plugin_get(encoder_name);
+	if (encoder_plugin == NULL) {
+		g_set_error(error_r, httpd_output_quark(), 0,
+			    "No such encoder: %s", encoder_name);
+		return false;
+	}
+
+	struct encoder *encoder =
+		encoder_init(encoder_plugin, &encoder_param, error_r);
+	if (encoder == nullptr)
+		return false;
+
+	/* unlike the options of a configuration block, these are
+	   not checked by config_global_check() */
+	for (const auto &bp : encoder_param.block_params) {
+		if (!bp.used) {
+			g_set_error(error_r, httpd_output_quark(), 0,
+				    "Unknown setting \"%s\" in stream %s",
+				    bp.name.c_str(), path.c_str());
+			encoder_finish(encoder);
+			return false;
+		}
+	}
+
+	streams.emplace_back(path.c_str());
+
+	HttpdStream &stream = streams.back();
+	stream.encoder = encoder;
+
+	stream.content_type = encoder_get_mime_type(stream.encoder);
+	if (stream.content_type == nullptr)
+		stream.content_type = "application/octet-stream";
+
+	stream.convert_filter = filter_new(&convert_filter_plugin,
+					   nullptr, nullptr);
+	assert(stream.convert_filter != nullptr);
 
 	return true;
 }
 
+HttpdStream *
+HttpdOutput::FindStream(const char *path, size_t length)
+{
+	for (auto &stream : streams)
+		if (stream.path.length() == length &&
+		    memcmp(stream.path.data(), path, length) == 0)
+			return &stream;
+
+	/* without additional streams, every path selects the default
+	   stream, like before; with them, only "/" does, so a
+	   mistyped path is not silently served a different
+	   stream */
+	if (streams.size() == 1 || (length == 1 && *path == '/'))
+		return &streams.front();
+
+	return nullptr;
+}
+
 static struct audio_output *
 httpd_output_init(const struct config_param *param,
 		  GError **error_r)
@@ -189,8 +369,7 @@ httpd_output_finish(struct audio_output *ao)
 inline void
 HttpdOutput::AddClient(int fd)
 {
-	clients.emplace_front(this, fd, GetEventLoop(),
-			      encoder->plugin->tag == NULL);
+	clients.emplace_front(this, fd, GetEventLoop());
 	++clients_cnt;
 
 	/* pass metadata to client */
@@ -245,25 +424,30 @@ HttpdOutput::OnAccept(int fd, const sockaddr &address,
 }
 
 Page *
-HttpdOutput::ReadPage()
+HttpdOutput::ReadPage(HttpdStream &stream)
 {
-	if (unflushed_input >= 65536) {
+	if (stream.unflushed_input >= 65536) {
 		/* we have fed a lot of input into the encoder, but it
 		   didn't give anything back yet - flush now to avoid
 		   buffer underruns */
-		encoder_flush(encoder, NULL);
-		unflushed_input = 0;
+		encoder_flush(stream.encoder, NULL);
+		stream.unflushed_input = 0;
 	}
 
 	size_t size = 0;
 	do {
-		size_t nbytes = encoder_read(encoder,
+		if (size > 0 && shared_encoder_at_header(stream.encoder))
+			/* the header of a new stream must be a page
+			   of its own */
+			break;
+
+		size_t nbytes = encoder_read(stream.encoder,
 					     buffer + size,
 					     sizeof(buffer) - size);
 		if (nbytes == 0)
 			break;
 
-		unflushed_input = 0;
+		stream.unflushed_input = 0;
 
 		size += nbytes;
 	} while (size < sizeof(buffer));
@@ -274,6 +458,42 @@ HttpdOutput::ReadPage()
 	return Page::Copy(buffer, size);
 }
 
+uint64_t
+HttpdStream::GetBurstStart(size_t burst_size) const
+{
+	uint64_t sequence = GetEndPage();
+	size_t size = 0;
+
+	while (sequence > first_page && sequence > header_page) {
+		const Page *page = pages[sequence - 1 - first_page];
+		if (size + page->size > burst_size)
+			break;
+
+		size += page->size;
+		--sequence;
+	}
+
+	return sequence;
+}
+
+void
+HttpdStream::ClearPages()
+{
+	for (auto page : pages)
+		page->Unref();
+
+	first_page += pages.size();
+	pages.clear();
+	pages_size = 0;
+}
+
+void
+HttpdOutput::ClearPages()
+{
+	for (auto &stream : streams)
+		stream.ClearPages();
+}
+
 static bool
 httpd_output_enable(struct audio_output *ao, GError **error_r)
 {
@@ -291,31 +511,79 @@ httpd_output_disable(struct audio_output *ao)
 }
 
 inline bool
-HttpdOutput::OpenEncoder(struct audio_format *audio_format, GError **error)
+HttpdOutput::OpenEncoder(HttpdStream &stream,
+			 struct audio_format *audio_format, GError **error)
 {
-	if (!encoder_open(encoder, audio_format, error))
+	if (!encoder_open(stream.encoder, audio_format, error))
 		return false;
 
 	/* we have to remember the encoder header, i.e. the first
 	   bytes of encoder output after opening it, because it has to
-	   be sent to every new client */
-	header = ReadPage();
+	   be sent to every new client; a shared encoder flags it */
+	stream.header = shared_encoder_is_shared(stream.encoder)
+		? shared_encoder_read_header(stream.encoder)
+		: ReadPage(stream);
 
-	unflushed_input = 0;
+	stream.unflushed_input = 0;
 
 	return true;
 }
 
+inline void
+HttpdOutput::CloseEncoder(HttpdStream &stream)
+{
+	stream.ClearPages();
+
+	if (stream.header != nullptr) {
+		stream.header->Unref();
+		stream.header = nullptr;
+	}
+
+	encoder_close(stream.encoder);
+
+	if (stream.convert_filter != nullptr)
+		stream.convert_filter->Close();
+}
+
 inline bool
 HttpdOutput::Open(struct audio_format *audio_format, GError **error_r)
 {
 	assert(!open);
 	assert(clients.empty());
 
-	/* open the encoder */
+	/* open the encoders; the default stream determines the
+	   audio format of this output, and the other streams convert
+	   from it if their encoders require something else */
+
+	for (auto i = streams.begin(), end = streams.end(); i != end; ++i) {
+		HttpdStream &stream = *i;
+		bool success;
+
+		if (stream.convert_filter == nullptr) {
+			success = OpenEncoder(stream, audio_format, error_r);
+		} else {
+			struct audio_format in_format = *audio_format;
+			success = stream.convert_filter->Open(in_format,
+							      error_r) != nullptr;
+			if (success) {
+				struct audio_format out_format = *audio_format;
+				success = OpenEncoder(stream, &out_format,
+						      error_r);
+				if (success)
+					convert_filter_set(stream.convert_filter,
+							   out_format);
+				else
+					stream.convert_filter->Close();
+			}
+		}
 
-	if (!OpenEncoder(audio_format, error_r))
-		return false;
+		if (!success) {
+			/* roll back */
+			for (auto j = streams.begin(); j != i; ++j)
+				CloseEncoder(*j);
+			return false;
+		}
+	}
 
 	/* initialize other attributes */
 
@@ -350,10 +618,8 @@ HttpdOutput::Close()
 
 	clients.clear();
 
-	if (header != NULL)
-		header->Unref();
-
-	encoder_close(encoder);
+	for (auto &stream : streams)
+		CloseEncoder(stream);
 }
 
 static void
@@ -381,13 +647,6 @@ HttpdOutput::RemoveClient(HttpdClient &client)
 	}
 }
 
-void
-HttpdOutput::SendHeader(HttpdClient &client) const
-{
-	if (header != NULL)
-		client.PushPage(header);
-}
-
 static unsigned
 httpd_output_delay(struct audio_output *ao)
 {
@@ -412,43 +671,101 @@ httpd_output_delay(struct audio_output *ao)
 }
 
 void
-HttpdOutput::BroadcastPage(Page *page)
+HttpdOutput::BroadcastPage(HttpdStream &stream, Page *page)
+{
+	const ScopeLock protect(mutex);
+	BroadcastPageLocked(stream, page);
+}
+
+void
+HttpdOutput::BroadcastPageLocked(HttpdStream &stream, Page *page)
 {
 	assert(page != NULL);
 
-	const ScopeLock protect(mutex);
+	page->Ref();
+	stream.pages.push_back(page);
+	stream.pages_size += page->size;
+
+	/* drop the oldest pages; clients which have not sent them
+	   yet will skip ahead */
+	const size_t capacity = burst_size + HTTPD_MAX_CLIENT_LAG;
+	while (stream.pages_size > capacity && stream.pages.size() > 1) {
+		Page *old = stream.pages.front();
+		stream.pages.pop_front();
+		++stream.first_page;
+		stream.pages_size -= old->size;
+		old->Unref();
+	}
+
 	for (auto &client : clients)
-		client.PushPage(page);
+		if (client.GetStream() == &stream)
+			client.OnNewPage();
+}
+
+void
+HttpdOutput::BroadcastHeader(HttpdStream &stream, Page *page)
+{
+	assert(page != NULL);
+
+	const ScopeLock protect(mutex);
+
+	if (stream.header != NULL)
+		stream.header->Unref();
+	stream.header = page;
+
+	/* new clients get the header from HttpdStream::header, and
+	   their burst begins after the copy in the ring */
+	stream.header_page = stream.GetEndPage() + 1;
+
+	BroadcastPageLocked(stream, page);
 }
 
 void
-HttpdOutput::BroadcastFromEncoder()
+HttpdOutput::BroadcastFromEncoder(HttpdStream &stream)
 {
-	mutex.lock();
-	for (auto &client : clients) {
-		if (client.GetQueueSize() > 256 * 1024) {
-			g_debug("client is too slow, flushing its queue");
-			client.CancelQueue();
+	while (true) {
+		Page *page = shared_encoder_read_header(stream.encoder);
+		if (page != nullptr) {
+			BroadcastHeader(stream, page);
+			continue;
 		}
-	}
-	mutex.unlock();
 
-	Page *page;
-	while ((page = ReadPage()) != nullptr) {
-		BroadcastPage(page);
+		page = ReadPage(stream);
+		if (page == nullptr)
+			break;
+
+		BroadcastPage(stream, page);
 		page->Unref();
 	}
 }
 
 inline bool
-HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, GError **error_r)
+HttpdOutput::EncodeAndPlay(HttpdStream &stream,
+			   const void *chunk, size_t size, GError **error_r)
 {
-	if (!encoder_write(encoder, chunk, size, error_r))
+	if (stream.convert_filter != nullptr) {
+		chunk = stream.convert_filter->FilterPCM(chunk, size, &size,
+							 error_r);
+		if (chunk == nullptr)
+			return false;
+	}
+
+	if (!encoder_write(stream.encoder, chunk, size, error_r))
 		return false;
 
-	unflushed_input += size;
+	stream.unflushed_input += size;
+
+	BroadcastFromEncoder(stream);
+	return true;
+}
+
+inline bool
+HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, GError **error_r)
+{
+	for (auto &stream : streams)
+		if (!EncodeAndPlay(stream, chunk, size, error_r))
+			return false;
 
-	BroadcastFromEncoder();
 	return true;
 }
 
@@ -458,7 +775,9 @@ httpd_output_play(struct audio_output *ao, const void *chunk, size_t size,
 {
 	HttpdOutput *httpd = Cast(ao);
 
-	if (httpd->LockHasClients()) {
+	/* with a burst configured, keep encoding even without
+	   clients, so the first one gets the burst, too */
+	if (httpd->burst_size > 0 || httpd->LockHasClients()) {
 		if (!httpd->EncodeAndPlay(chunk, size, error_r))
 			return 0;
 	}
@@ -485,35 +804,53 @@ httpd_output_pause(struct audio_output *ao)
 }
 
 inline void
-HttpdOutput::SendTag(const struct tag *tag)
+HttpdOutput::SendTag(HttpdStream &stream, const struct tag *tag)
 {
-	assert(tag != NULL);
+	assert(stream.HasEncoderTags());
 
-	if (encoder->plugin->tag != NULL) {
-		/* embed encoder tags */
+	/* flush the current stream, and end it */
 
-		/* flush the current stream, and end it */
+	encoder_pre_tag(stream.encoder, NULL);
+	BroadcastFromEncoder(stream);
 
-		encoder_pre_tag(encoder, NULL);
-		BroadcastFromEncoder();
+	/* send the tag to the encoder - which starts a new stream
+	   now */
 
-		/* send the tag to the encoder - which starts a new
-		   stream now */
+	encoder_tag(stream.encoder, tag, NULL);
 
-		encoder_tag(encoder, tag, NULL);
+	if (shared_encoder_is_shared(stream.encoder)) {
+		/* another member may have applied this tag
+		   earlier; the shared encoder flags the new header
+		   wherever it is, and BroadcastFromEncoder() picks
+		   it up */
+		BroadcastFromEncoder(stream);
+		return;
+	}
 
-		/* the first page generated by the encoder will now be
-		   used as the new "header" page, which is sent to all
-		   new clients */
+	/* the first page generated by the encoder will now be used
+	   as the new "header" page, which is sent to all new
+	   clients */
 
-		Page *page = ReadPage();
-		if (page != NULL) {
-			if (header != NULL)
-				header->Unref();
-			header = page;
-			BroadcastPage(page);
-		}
-	} else {
+	Page *page = ReadPage(stream);
+	if (page != NULL)
+		BroadcastHeader(stream, page);
+}
+
+inline void
+HttpdOutput::SendTag(const struct tag *tag)
+{
+	assert(tag != NULL);
+
+	bool icy = false;
+	for (auto &stream : streams) {
+		if (stream.HasEncoderTags())
+			/* embed encoder tags */
+			SendTag(stream, tag);
+		else
+			icy = true;
+	}
+
+	if (icy) {
 		/* use Icy-Metadata */
 
 		if (metadata != NULL)
@@ -547,6 +884,7 @@ httpd_output_cancel(struct audio_output *ao)
 	HttpdOutput *httpd = Cast(ao);
 
 	const ScopeLock protect(httpd->mutex);
+	httpd->ClearPages();
 	for (auto &client : httpd->clients)
 		client.CancelQueue();
 }
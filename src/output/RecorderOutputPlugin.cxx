@@ -22,6 +22,7 @@
 #include "output_api.h"
 #include "encoder_plugin.h"
 #include "EncoderList.hxx"
+#include "SharedEncoder.hxx"
 #include "fd_util.h"
 #include "open.h"
 
@@ -109,7 +110,7 @@ RecorderOutput::Configure(const config_param *param, GError **error_r)
 
 	/* initialize encoder */
 
-	encoder = encoder_init(encoder_plugin, param, error_r);
+	encoder = shared_encoder_init(encoder_plugin, param, error_r);
 	if (encoder == nullptr)
 		return false;
 
@@ -22,6 +22,7 @@
 #include "output_api.h"
 #include "encoder_plugin.h"
 #include "EncoderList.hxx"
+#include "SharedEncoder.hxx"
 #include "mpd_error.h"
 
 #include <shout/shout.h>
@@ -188,7 +189,7 @@ ShoutOutput::Configure(const config_param *param, GError **error_r)
 		return false;
 	}
 
-	encoder = encoder_init(encoder_plugin, param, error_r);
+	encoder = shared_encoder_init(encoder_plugin, param, error_r);
 	if (encoder == nullptr)
 		return false;
 
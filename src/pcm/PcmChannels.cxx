@@ -19,8 +19,10 @@
 
 #include "config.h"
 #include "PcmChannels.hxx"
+#include "PcmRoute.hxx"
 #include "pcm_buffer.h"
 #include "PcmUtils.hxx"
+#include "audio_format.h"
 
 #include <assert.h>
 
@@ -37,6 +39,30 @@ MonoToStereo(D dest, S src, S end)
 
 }
 
+/**
+ * Upmix to more channels: the source channels are copied to the
+ * first output channels (mono goes to both front channels), and the
+ * remaining ones are silenced.
+ */
+static const void *
+pcm_upmix_channels(struct pcm_buffer *buffer, size_t sample_size,
+		   unsigned dest_channels, unsigned src_channels,
+		   const void *src, size_t src_size, size_t *dest_size_r)
+{
+	assert(dest_channels > src_channels);
+	assert(dest_channels <= MAX_CHANNELS);
+
+	signed char sources[MAX_CHANNELS];
+	for (unsigned c = 0; c < dest_channels; ++c)
+		sources[c] = c < src_channels ? (signed char)c : -1;
+
+	if (src_channels == 1)
+		sources[1] = 0;
+
+	return pcm_route(buffer, sample_size, dest_channels, src_channels,
+			 sources, src, src_size, dest_size_r);
+}
+
 static void
 pcm_convert_channels_16_2_to_1(int16_t *restrict dest,
 			       const int16_t *restrict src,
@@ -91,6 +117,11 @@ pcm_convert_channels_16(struct pcm_buffer *buffer,
 		MonoToStereo(dest, src, src_end);
 	else if (src_channels == 2 && dest_channels == 1)
 		pcm_convert_channels_16_2_to_1(dest, src, src_end);
+	else if (dest_channels > src_channels)
+		return (const int16_t *)
+			pcm_upmix_channels(buffer, sizeof(*src),
+					   dest_channels, src_channels,
+					   src, src_size, dest_size_r);
 	else if (dest_channels == 2)
 		pcm_convert_channels_16_n_to_2(dest, src_channels, src,
 					       src_end);
@@ -155,6 +186,11 @@ pcm_convert_channels_24(struct pcm_buffer *buffer,
 		MonoToStereo(dest, src, src_end);
 	else if (src_channels == 2 && dest_channels == 1)
 		pcm_convert_channels_24_2_to_1(dest, src, src_end);
+	else if (dest_channels > src_channels)
+		return (const int32_t *)
+			pcm_upmix_channels(buffer, sizeof(*src),
+					   dest_channels, src_channels,
+					   src, src_size, dest_size_r);
 	else if (dest_channels == 2)
 		pcm_convert_channels_24_n_to_2(dest, src_channels, src,
 					       src_end);
@@ -218,6 +254,11 @@ pcm_convert_channels_32(struct pcm_buffer *buffer,
 		MonoToStereo(dest, src, src_end);
 	else if (src_channels == 2 && dest_channels == 1)
 		pcm_convert_channels_32_2_to_1(dest, src, src_end);
+	else if (dest_channels > src_channels)
+		return (const int32_t *)
+			pcm_upmix_channels(buffer, sizeof(*src),
+					   dest_channels, src_channels,
+					   src, src_size, dest_size_r);
 	else if (dest_channels == 2)
 		pcm_convert_channels_32_n_to_2(dest, src_channels, src,
 					       src_end);
@@ -280,6 +321,11 @@ pcm_convert_channels_float(struct pcm_buffer *buffer,
 		MonoToStereo(dest, src, src_end);
 	else if (src_channels == 2 && dest_channels == 1)
 		pcm_convert_channels_float_2_to_1(dest, src, src_end);
+	else if (dest_channels > src_channels)
+		return (const float *)
+			pcm_upmix_channels(buffer, sizeof(*src),
+					   dest_channels, src_channels,
+					   src, src_size, dest_size_r);
 	else if (dest_channels == 2)
 		pcm_convert_channels_float_n_to_2(dest, src_channels, src,
 						  src_end);
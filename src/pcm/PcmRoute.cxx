@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PcmRoute.hxx"
+#include "pcm_buffer.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+bool
+pcm_route_is_identity(unsigned dest_channels, unsigned src_channels,
+		      const signed char *sources)
+{
+	if (dest_channels != src_channels)
+		return false;
+
+	for (unsigned c = 0; c < dest_channels; ++c)
+		if (sources[c] != (signed char)c)
+			return false;
+
+	return true;
+}
+
+/**
+ * Copy one input channel into one output channel.
+ */
+template<typename T>
+static void
+RouteChannel(T *restrict dest, unsigned dest_channels,
+	     const T *restrict src, unsigned src_channels,
+	     size_t n_frames)
+{
+	for (size_t i = 0; i < n_frames; ++i)
+		dest[i * dest_channels] = src[i * src_channels];
+}
+
+/**
+ * Fill one output channel with silence.
+ */
+template<typename T>
+static void
+SilenceChannel(T *dest, unsigned dest_channels, size_t n_frames)
+{
+	for (size_t i = 0; i < n_frames; ++i)
+		dest[i * dest_channels] = 0;
+}
+
+template<typename T>
+static void
+Route(T *dest, unsigned dest_channels,
+      const T *src, unsigned src_channels,
+      const signed char *sources, size_t n_frames)
+{
+	for (unsigned c = 0; c < dest_channels; ++c) {
+		const int s = sources[c];
+		if (s < 0 || (unsigned)s >= src_channels)
+			SilenceChannel(dest + c, dest_channels, n_frames);
+		else
+			RouteChannel(dest + c, dest_channels,
+				     src + s, src_channels, n_frames);
+	}
+}
+
+/**
+ * Fallback for sample sizes without a matching integer type.
+ */
+static void
+RouteBytes(uint8_t *dest, unsigned dest_channels,
+	   const uint8_t *src, unsigned src_channels,
+	   const signed char *sources, size_t n_frames,
+	   size_t sample_size)
+{
+	const size_t dest_frame_size = dest_channels * sample_size;
+	const size_t src_frame_size = src_channels * sample_size;
+
+	for (unsigned c = 0; c < dest_channels; ++c) {
+		const int s = sources[c];
+		uint8_t *d = dest + c * sample_size;
+
+		if (s < 0 || (unsigned)s >= src_channels) {
+			for (size_t i = 0; i < n_frames; ++i)
+				memset(d + i * dest_frame_size, 0,
+				       sample_size);
+		} else {
+			const uint8_t *p = src + s * sample_size;
+			for (size_t i = 0; i < n_frames; ++i)
+				memcpy(d + i * dest_frame_size,
+				       p + i * src_frame_size, sample_size);
+		}
+	}
+}
+
+const void *
+pcm_route(struct pcm_buffer *buffer, size_t sample_size,
+	  unsigned dest_channels, unsigned src_channels,
+	  const signed char *sources,
+	  const void *src, size_t src_size, size_t *dest_size_r)
+{
+	assert(sample_size > 0);
+	assert(dest_channels > 0);
+	assert(src_channels > 0);
+	assert(src_size % (sample_size * src_channels) == 0);
+
+	const size_t n_frames = src_size / (sample_size * src_channels);
+	const size_t dest_size = n_frames * sample_size * dest_channels;
+	*dest_size_r = dest_size;
+
+	void *dest = pcm_buffer_get(buffer, dest_size);
+
+	switch (sample_size) {
+	case 1:
+		Route((uint8_t *)dest, dest_channels,
+		      (const uint8_t *)src, src_channels,
+		      sources, n_frames);
+		break;
+
+	case 2:
+		Route((uint16_t *)dest, dest_channels,
+		      (const uint16_t *)src, src_channels,
+		      sources, n_frames);
+		break;
+
+	case 4:
+		Route((uint32_t *)dest, dest_channels,
+		      (const uint32_t *)src, src_channels,
+		      sources, n_frames);
+		break;
+
+	default:
+		RouteBytes((uint8_t *)dest, dest_channels,
+			   (const uint8_t *)src, src_channels,
+			   sources, n_frames, sample_size);
+		break;
+	}
+
+	return dest;
+}
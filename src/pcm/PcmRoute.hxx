@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_ROUTE_HXX
+#define MPD_PCM_ROUTE_HXX
+
+#include "gcc.h"
+
+#include <stddef.h>
+
+struct pcm_buffer;
+
+/**
+ * Checks whether the routing table copies every channel to itself,
+ * i.e. pcm_route() would produce a copy of the input.
+ */
+gcc_pure
+bool
+pcm_route_is_identity(unsigned dest_channels, unsigned src_channels,
+		      const signed char *sources);
+
+/**
+ * Copies channels from one interleaved PCM buffer to another,
+ * according to a routing table.
+ *
+ * The table is walked once per output channel, not once per sample:
+ * each output channel becomes one tight strided copy loop over all
+ * frames, specialized for the sample width, which the compiler can
+ * unroll and vectorize.
+ *
+ * @param buffer the destination pcm_buffer object
+ * @param sample_size the size of one sample in bytes
+ * @param dest_channels the number of channels in the destination
+ * @param src_channels the number of channels in the source
+ * @param sources for each output channel, the input channel it is
+ * copied from; a negative value or a value not smaller than
+ * #src_channels produces silence
+ * @param src the source PCM buffer
+ * @param src_size the number of bytes in #src
+ * @param dest_size_r returns the number of bytes of the destination buffer
+ * @return the destination buffer
+ */
+const void *
+pcm_route(struct pcm_buffer *buffer, size_t sample_size,
+	  unsigned dest_channels, unsigned src_channels,
+	  const signed char *sources,
+	  const void *src, size_t src_size, size_t *dest_size_r);
+
+#endif
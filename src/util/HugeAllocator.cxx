@@ -84,4 +84,10 @@ HugeDiscard(void *p, size_t size)
 #endif
 }
 
+bool
+HugeLock(void *p, size_t size)
+{
+	return mlock(p, AlignToPageSize(size)) == 0;
+}
+
 #endif
@@ -53,11 +53,24 @@ HugeFree(void *p, size_t size);
 void
 HugeDiscard(void *p, size_t size);
 
+/**
+ * Lock the allocation into RAM, so it never gets paged out.  This
+ * populates all pages immediately.  While locked, HugeDiscard() has
+ * no effect.
+ *
+ * @param p an allocation returned by HugeAllocate()
+ * @param size the allocation's size as passed to HugeAllocate()
+ * @return false on error, with errno set
+ */
+bool
+HugeLock(void *p, size_t size);
+
 #else
 
 /* not Linux: fall back to standard C calls */
 
 #include <stdlib.h>
+#include <errno.h>
 
 gcc_malloc
 static inline void *
@@ -77,6 +90,13 @@ HugeDiscard(void *, size_t)
 {
 }
 
+static inline bool
+HugeLock(void *, size_t)
+{
+	errno = ENOSYS;
+	return false;
+}
+
 #endif
 
 #endif
@@ -107,6 +107,15 @@ public:
 		return n_allocated == n_max;
 	}
 
+	/**
+	 * Lock the whole buffer into RAM (see HugeLock()).
+	 *
+	 * @return false on error, with errno set
+	 */
+	bool Lock() {
+		return HugeLock(data, CalcAllocationSize());
+	}
+
 	template<typename... Args>
 	T *Allocate(Args&&... args) {
 		assert(n_initialized <= n_max);
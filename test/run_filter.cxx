@@ -158,6 +158,11 @@ int main(int argc, char **argv)
 
 	/* play */
 
+	/* measure only the time spent in the filter */
+	GTimer *timer = g_timer_new();
+	g_timer_stop(timer);
+	unsigned long total_bytes = 0;
+
 	while (true) {
 		ssize_t nbytes;
 		size_t length;
@@ -167,8 +172,10 @@ int main(int argc, char **argv)
 		if (nbytes <= 0)
 			break;
 
+		g_timer_continue(timer);
 		dest = filter->FilterPCM(buffer, (size_t)nbytes,
 					 &length, &error);
+		g_timer_stop(timer);
 		if (dest == NULL) {
 			g_printerr("Filter failed: %s\n", error->message);
 			filter->Close();
@@ -176,6 +183,8 @@ int main(int argc, char **argv)
 			return 1;
 		}
 
+		total_bytes += nbytes;
+
 		nbytes = write(1, dest, length);
 		if (nbytes < 0) {
 			g_printerr("Failed to write: %s\n", g_strerror(errno));
@@ -185,6 +194,10 @@ int main(int argc, char **argv)
 		}
 	}
 
+	g_printerr("filtered %lu bytes in %.3f seconds\n",
+		   total_bytes, g_timer_elapsed(timer, NULL));
+	g_timer_destroy(timer);
+
 	/* cleanup and exit */
 
 	filter->Close();
@@ -110,14 +110,92 @@ dump_input_stream(struct input_stream *is)
 	return 0;
 }
 
+/**
+ * Seeks to the specified offset, and copies the specified number of
+ * bytes (or less at the end of the stream) to stdout.
+ */
+static int
+dump_input_range(struct input_stream *is, goffset offset, goffset length)
+{
+	GError *error = NULL;
+	char buffer[4096];
+
+	input_stream_lock(is);
+
+	input_stream_wait_ready(is);
+
+	if (!input_stream_seek(is, offset, SEEK_SET, &error)) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+		input_stream_unlock(is);
+		return EXIT_FAILURE;
+	}
+
+	while (length > 0) {
+		size_t size = sizeof(buffer);
+		if ((goffset)size > length)
+			size = length;
+
+		size_t num_read = input_stream_read(is, buffer, size, &error);
+		if (num_read == 0) {
+			if (error != NULL) {
+				g_warning("%s", error->message);
+				g_error_free(error);
+				input_stream_unlock(is);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		}
+
+		if (write(1, buffer, num_read) != (ssize_t)num_read)
+			break;
+
+		length -= num_read;
+	}
+
+	input_stream_unlock(is);
+
+	return 0;
+}
+
+/**
+ * Seeks to and dumps each "OFFSET:LENGTH" range, in the order given.
+ */
+static int
+dump_input_ranges(struct input_stream *is, int argc, char **argv)
+{
+	for (int i = 0; i < argc; ++i) {
+		char *endptr;
+		goffset offset = g_ascii_strtoll(argv[i], &endptr, 10);
+		if (endptr == argv[i] || *endptr != ':' || offset < 0) {
+			g_printerr("Malformed range: %s\n", argv[i]);
+			return 1;
+		}
+
+		const char *p = endptr + 1;
+		goffset length = g_ascii_strtoll(p, &endptr, 10);
+		if (endptr == p || *endptr != 0 || length < 0) {
+			g_printerr("Malformed range: %s\n", argv[i]);
+			return 1;
+		}
+
+		int ret = dump_input_range(is, offset, length);
+		if (ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	GError *error = NULL;
 	struct input_stream *is;
 	int ret;
 
-	if (argc != 2) {
-		g_printerr("Usage: run_input URI\n");
+	if (argc < 2) {
+		g_printerr("Usage: run_input URI [OFFSET:LENGTH ...]\n");
 		return 1;
 	}
 
@@ -157,7 +235,9 @@ int main(int argc, char **argv)
 
 	is = input_stream_open(argv[1], mutex, cond, &error);
 	if (is != NULL) {
-		ret = dump_input_stream(is);
+		ret = argc > 2
+			? dump_input_ranges(is, argc - 2, argv + 2)
+			: dump_input_stream(is);
 		input_stream_close(is);
 	} else {
 		if (error != NULL) {
@@ -86,7 +86,14 @@ find_named_config_block(ConfigOption option, const char *name)
 }
 
 player_control::player_control(gcc_unused unsigned _buffer_chunks,
-			       gcc_unused unsigned _buffered_before_play) {}
+			       gcc_unused unsigned _buffered_before_play,
+			       unsigned _buffered_before_play_min,
+			       unsigned _buffered_before_play_max,
+			       unsigned _prefetch_songs,
+			       bool _lock_buffer)
+	:buffered_before_play_min(_buffered_before_play_min),
+	 buffered_before_play_max(_buffered_before_play_max),
+	 prefetch_songs(_prefetch_songs), lock_buffer(_lock_buffer) {}
 player_control::~player_control() {}
 
 static struct audio_output *
@@ -101,7 +108,7 @@ load_audio_output(const char *name)
 		return nullptr;
 	}
 
-	static struct player_control dummy_player_control(32, 4);
+	static struct player_control dummy_player_control(32, 4, 4, 4, 0, false);
 
 	struct audio_output *ao =
 		audio_output_new(param, &dummy_player_control, &error);
@@ -8,3 +8,33 @@ mkdir -p test/tmp
 rm -f "$DST"
 bzip2 -c "$SRC" >"$DST"
 ./test/run_input "$DST/${SRC_BASE}" |diff "$SRC" -
+
+# small blocks, to exercise the block index
+rm -f "$DST"
+bzip2 -1 -c "$SRC" >"$DST"
+./test/run_input "$DST/${SRC_BASE}" |diff "$SRC" -
+
+# seek within a file which consists of many small blocks, and
+# compare with the original file
+SEEK_SRC="$(pwd)/test/tmp/seek"
+SEEK_DST="${SEEK_SRC}.bz2"
+: >"$SEEK_SRC"
+while [ "$(wc -c <"$SEEK_SRC")" -lt 1000000 ]; do
+	cat "$SRC" >>"$SEEK_SRC"
+done
+SEEK_SIZE=$(wc -c <"$SEEK_SRC")
+
+rm -f "$SEEK_DST"
+bzip2 -1 -c "$SEEK_SRC" >"$SEEK_DST"
+
+# the first seek goes far ahead, the following ones go back into
+# blocks whose offsets have been learned meanwhile, across block
+# boundaries and beyond the end of the file
+RANGES="700000:70000 1000:5000 99000:4000 650000:60000 295000:20000 \
+399990:20 $((SEEK_SIZE - 1000)):5000 0:100"
+
+for range in $RANGES; do
+	dd if="$SEEK_SRC" bs=1 skip="${range%:*}" count="${range#*:}" 2>/dev/null
+done >"${SEEK_SRC}.expected"
+
+./test/run_input "$SEEK_DST/seek" $RANGES |cmp "${SEEK_SRC}.expected" -
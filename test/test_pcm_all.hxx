@@ -38,6 +38,9 @@ test_pcm_channels_16();
 void
 test_pcm_channels_32();
 
+void
+test_pcm_route();
+
 void
 test_pcm_volume_8();
 
@@ -77,4 +80,13 @@ test_pcm_mix_24();
 void
 test_pcm_mix_32();
 
+void
+test_pcm_normalize_24();
+
+void
+test_pcm_normalize_32();
+
+void
+test_pcm_normalize_float();
+
 #endif
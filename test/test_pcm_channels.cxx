@@ -21,6 +21,7 @@
 #include "test_pcm_all.hxx"
 #include "test_pcm_util.hxx"
 #include "pcm/PcmChannels.hxx"
+#include "pcm/PcmRoute.hxx"
 #include "pcm/pcm_buffer.h"
 
 #include <glib.h>
@@ -94,3 +95,47 @@ test_pcm_channels_32()
 
 	pcm_buffer_deinit(&buffer);
 }
+
+void
+test_pcm_route()
+{
+	constexpr unsigned N = 256;
+	const auto src = TestDataBuffer<int16_t, N * 2>();
+
+	struct pcm_buffer buffer;
+	pcm_buffer_init(&buffer);
+
+	/* swap left and right, duplicate left, add a silent channel */
+
+	static const signed char sources[] = { 1, 0, 0, -1, 5 };
+	g_assert(!pcm_route_is_identity(5, 2, sources));
+
+	size_t dest_size;
+	const int16_t *dest = (const int16_t *)
+		pcm_route(&buffer, sizeof(*src), 5, 2, sources,
+			  src, sizeof(src), &dest_size);
+	g_assert(dest != NULL);
+	g_assert_cmpint(dest_size, ==, sizeof(src) / 2 * 5);
+	for (unsigned i = 0; i < N; ++i) {
+		g_assert_cmpint(dest[i * 5], ==, src[i * 2 + 1]);
+		g_assert_cmpint(dest[i * 5 + 1], ==, src[i * 2]);
+		g_assert_cmpint(dest[i * 5 + 2], ==, src[i * 2]);
+		g_assert_cmpint(dest[i * 5 + 3], ==, 0);
+		g_assert_cmpint(dest[i * 5 + 4], ==, 0);
+	}
+
+	/* mono to 5.1 */
+
+	dest = pcm_convert_channels_16(&buffer, 6, 1, src, sizeof(src),
+				       &dest_size);
+	g_assert(dest != NULL);
+	g_assert_cmpint(dest_size, ==, sizeof(src) * 6);
+	for (unsigned i = 0; i < N * 2; ++i) {
+		g_assert_cmpint(dest[i * 6], ==, src[i]);
+		g_assert_cmpint(dest[i * 6 + 1], ==, src[i]);
+		for (unsigned c = 2; c < 6; ++c)
+			g_assert_cmpint(dest[i * 6 + c], ==, 0);
+	}
+
+	pcm_buffer_deinit(&buffer);
+}
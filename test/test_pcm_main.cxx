@@ -31,6 +31,7 @@ main(int argc, char **argv)
 	g_test_add_func("/pcm/pack/unpack24", test_pcm_unpack_24);
 	g_test_add_func("/pcm/channels/16", test_pcm_channels_16);
 	g_test_add_func("/pcm/channels/32", test_pcm_channels_32);
+	g_test_add_func("/pcm/channels/route", test_pcm_route);
 
 	g_test_add_func("/pcm/volume/8", test_pcm_volume_8);
 	g_test_add_func("/pcm/volume/16", test_pcm_volume_16);
@@ -48,5 +49,9 @@ main(int argc, char **argv)
 	g_test_add_func("/pcm/mix/24", test_pcm_mix_24);
 	g_test_add_func("/pcm/mix/32", test_pcm_mix_32);
 
+	g_test_add_func("/pcm/normalize/24", test_pcm_normalize_24);
+	g_test_add_func("/pcm/normalize/32", test_pcm_normalize_32);
+	g_test_add_func("/pcm/normalize/float", test_pcm_normalize_float);
+
 	g_test_run();
 }
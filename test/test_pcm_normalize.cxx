@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "test_pcm_all.hxx"
+#include "AudioCompress/compress.h"
+#include "test_pcm_util.hxx"
+
+#include <glib.h>
+
+#include <algorithm>
+
+/**
+ * Create a compressor which applies the new gain immediately and
+ * amplifies by at most 4.
+ */
+static struct Compressor *
+NewTestCompressor()
+{
+	struct Compressor *compressor = Compressor_new(1);
+	struct CompressorConfig *config = Compressor_getConfig(compressor);
+	config->maxgain = 4;
+	config->smooth = 0;
+	return compressor;
+}
+
+/**
+ * Wraps a random sample generator, and scales its values down to
+ * 1/32 of full scale.
+ */
+template<typename G>
+struct Quiet : G {
+	auto operator()() const -> decltype(G::operator()()) {
+		return G::operator()() / 32;
+	}
+};
+
+static void
+test_pcm_normalize_int32(unsigned bits)
+{
+	constexpr unsigned N = 256;
+	const int32_t max = int32_t((1u << (bits - 1)) - 1);
+	const int32_t min = -max - 1;
+	const auto src = bits == 24
+		? TestDataBuffer<int32_t, N>(Quiet<GlibRandomInt24>())
+		: TestDataBuffer<int32_t, N>(Quiet<GlibRandomInt<int32_t>>());
+
+	struct Compressor *compressor = NewTestCompressor();
+
+	int32_t dest[N];
+
+	/* the first block ramps the gain up to the maximum, and the
+	   second one is amplified by exactly that */
+
+	std::copy(src.begin(), src.end(), dest);
+	Compressor_Process_int32(compressor, dest, N, bits);
+
+	std::copy(src.begin(), src.end(), dest);
+	Compressor_Process_int32(compressor, dest, N, bits);
+
+	for (unsigned i = 0; i < N; ++i)
+		g_assert_cmpint(dest[i], ==, src[i] * 4);
+
+	/* a loud block at the current gain must be clipped at the
+	   limits of the sample format */
+
+	std::copy(src.begin(), src.end(), dest);
+	dest[0] = max;
+	dest[1] = min + (1 << (bits - 16));
+	dest[2] = max / 2;
+	dest[3] = min / 2;
+	Compressor_Process_int32(compressor, dest, N, bits);
+
+	g_assert_cmpint(dest[0], ==, max);
+	g_assert_cmpint(dest[1], ==, min);
+	g_assert_cmpint(dest[2], ==, max);
+	g_assert_cmpint(dest[3], ==, min);
+
+	for (unsigned i = 0; i < N; ++i) {
+		g_assert_cmpint(dest[i], >=, min);
+		g_assert_cmpint(dest[i], <=, max);
+	}
+
+	Compressor_delete(compressor);
+}
+
+void
+test_pcm_normalize_24()
+{
+	test_pcm_normalize_int32(24);
+}
+
+void
+test_pcm_normalize_32()
+{
+	test_pcm_normalize_int32(32);
+}
+
+void
+test_pcm_normalize_float()
+{
+	constexpr unsigned N = 256;
+	const auto src = TestDataBuffer<float, N>(Quiet<GlibRandomFloat>());
+
+	struct Compressor *compressor = NewTestCompressor();
+
+	float dest[N];
+
+	std::copy(src.begin(), src.end(), dest);
+	Compressor_Process_float(compressor, dest, N);
+
+	std::copy(src.begin(), src.end(), dest);
+	Compressor_Process_float(compressor, dest, N);
+
+	for (unsigned i = 0; i < N; ++i)
+		g_assert_cmpfloat(dest[i], ==, src[i] * 4);
+
+	/* a loud block must be clamped to -1.0 .. +1.0 */
+
+	std::copy(src.begin(), src.end(), dest);
+	dest[0] = 1.0f;
+	dest[1] = -0.99f;
+	dest[2] = 0.5f;
+	dest[3] = -0.5f;
+	Compressor_Process_float(compressor, dest, N);
+
+	g_assert_cmpfloat(dest[0], ==, 1.0f);
+	g_assert_cmpfloat(dest[1], ==, -1.0f);
+	g_assert_cmpfloat(dest[2], ==, 1.0f);
+	g_assert_cmpfloat(dest[3], ==, -1.0f);
+
+	for (unsigned i = 0; i < N; ++i) {
+		g_assert_cmpfloat(dest[i], >=, -1.0f);
+		g_assert_cmpfloat(dest[i], <=, 1.0f);
+	}
+
+	Compressor_delete(compressor);
+}
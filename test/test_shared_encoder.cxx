@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2003-2013 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedEncoder.hxx"
+#include "encoder_plugin.h"
+#include "audio_format.h"
+#include "conf.h"
+#include "ConfigData.hxx"
+#include "Page.hxx"
+#include "tag.h"
+
+#include <glib.h>
+
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ * A fake encoder which copies its input to its output, and marks the
+ * stream boundaries: "<H0>" is the header after opening, "<Hn>" the
+ * header after the n-th tag, and "<E>" the end of a stream.
+ */
+
+struct FakeEncoder {
+	struct encoder base;
+
+	/**
+	 * The "quality" setting; it is not used, but it must be
+	 * consistent in a group of shared encoders.
+	 */
+	const char *quality;
+
+	std::string output;
+
+	unsigned n_tags;
+};
+
+static struct encoder *
+fake_encoder_init(const struct config_param *param, GError **error_r);
+
+static void
+fake_encoder_finish(struct encoder *encoder)
+{
+	delete (FakeEncoder *)encoder;
+}
+
+static bool
+fake_encoder_open(struct encoder *_encoder,
+		  gcc_unused struct audio_format *audio_format,
+		  gcc_unused GError **error_r)
+{
+	FakeEncoder *encoder = (FakeEncoder *)_encoder;
+
+	encoder->output = "<H0>";
+	encoder->n_tags = 0;
+	return true;
+}
+
+static void
+fake_encoder_close(gcc_unused struct encoder *encoder)
+{
+}
+
+static bool
+fake_encoder_end(struct encoder *_encoder, gcc_unused GError **error_r)
+{
+	FakeEncoder *encoder = (FakeEncoder *)_encoder;
+
+	encoder->output += "<E>";
+	return true;
+}
+
+static bool
+fake_encoder_flush(gcc_unused struct encoder *encoder,
+		   gcc_unused GError **error_r)
+{
+	return true;
+}
+
+static bool
+fake_encoder_tag(struct encoder *_encoder,
+		 gcc_unused const struct tag *tag,
+		 gcc_unused GError **error_r)
+{
+	FakeEncoder *encoder = (FakeEncoder *)_encoder;
+
+	char buffer[16];
+	g_snprintf(buffer, sizeof(buffer), "<H%u>", ++encoder->n_tags);
+	encoder->output += buffer;
+	return true;
+}
+
+static bool
+fake_encoder_write(struct encoder *_encoder,
+		   const void *data, size_t length,
+		   gcc_unused GError **error_r)
+{
+	FakeEncoder *encoder = (FakeEncoder *)_encoder;
+
+	encoder->output.append((const char *)data, length);
+	return true;
+}
+
+static size_t
+fake_encoder_read(struct encoder *_encoder, void *dest, size_t length)
+{
+	FakeEncoder *encoder = (FakeEncoder *)_encoder;
+
+	if (length > encoder->output.length())
+		length = encoder->output.length();
+
+	memcpy(dest, encoder->output.data(), length);
+	encoder->output.erase(0, length);
+	return length;
+}
+
+static const struct encoder_plugin fake_encoder_plugin = {
+	"fake",
+	fake_encoder_init,
+	fake_encoder_finish,
+	fake_encoder_open,
+	fake_encoder_close,
+	fake_encoder_end,
+	fake_encoder_flush,
+	fake_encoder_end,
+	fake_encoder_tag,
+	fake_encoder_write,
+	fake_encoder_read,
+	nullptr,
+};
+
+static struct encoder *
+fake_encoder_init(const struct config_param *param,
+		  gcc_unused GError **error_r)
+{
+	FakeEncoder *encoder = new FakeEncoder();
+	encoder->quality = config_get_block_string(param, "quality", nullptr);
+	encoder_struct_init(&encoder->base, &fake_encoder_plugin);
+	return &encoder->base;
+}
+
+/**
+ * Reads the encoded data the way the httpd output does: stream
+ * headers are taken with shared_encoder_read_header(), and the data
+ * between them is read with encoder_read().
+ */
+static void
+read_like_httpd(struct encoder *encoder, std::string &header,
+		std::string &data)
+{
+	while (true) {
+		Page *page = shared_encoder_read_header(encoder);
+		if (page != nullptr) {
+			header.assign((const char *)page->data, page->size);
+			data += "[header]";
+			page->Unref();
+			continue;
+		}
+
+		char buffer[256];
+		size_t nbytes = encoder_read(encoder, buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		const std::string chunk(buffer, nbytes);
+
+		/* a header must never be returned as normal data */
+		assert(chunk.find("<H") == std::string::npos);
+
+		data += chunk;
+	}
+}
+
+static std::string
+read_all(struct encoder *encoder)
+{
+	std::string result;
+	char buffer[256];
+	size_t nbytes;
+	while ((nbytes = encoder_read(encoder, buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+static void
+write_string(struct encoder *encoder, const char *s)
+{
+	G_GNUC_UNUSED bool success =
+		encoder_write(encoder, s, strlen(s), nullptr);
+	assert(success);
+}
+
+/**
+ * Sends a tag to the encoder.  The data which ends the current
+ * stream must be read between encoder_pre_tag() and encoder_tag();
+ * this is done by the function object.
+ */
+template<typename R>
+static void
+send_tag(struct encoder *encoder, struct tag *tag, R read)
+{
+	G_GNUC_UNUSED bool success = encoder_pre_tag(encoder, nullptr);
+	assert(success);
+
+	read();
+
+	success = encoder_tag(encoder, tag, nullptr);
+	assert(success);
+}
+
+/**
+ * Two members at different speeds: the "recorder" is ahead and
+ * applies the tag; the "httpd" member lags behind, and must still get
+ * the new stream header as its header, not as data.
+ */
+static void
+test_different_speeds(void)
+{
+	config_param param;
+	param.AddBlockParam("shared_encoder", "test");
+
+	struct encoder *recorder =
+		shared_encoder_init(&fake_encoder_plugin, &param, nullptr);
+	struct encoder *httpd =
+		shared_encoder_init(&fake_encoder_plugin, &param, nullptr);
+	assert(recorder != nullptr);
+	assert(httpd != nullptr);
+	assert(shared_encoder_is_shared(httpd));
+
+	struct audio_format audio_format;
+	audio_format_init(&audio_format, 44100, SAMPLE_FORMAT_S16, 2);
+
+	G_GNUC_UNUSED bool success =
+		encoder_open(recorder, &audio_format, nullptr);
+	assert(success);
+	success = encoder_open(httpd, &audio_format, nullptr);
+	assert(success);
+
+	std::string recorder_data, httpd_header, httpd_data;
+
+	auto read_recorder = [&](){
+		recorder_data += read_all(recorder);
+	};
+
+	auto read_httpd = [&](){
+		read_like_httpd(httpd, httpd_header, httpd_data);
+	};
+
+	/* the recorder plays the whole first song, the tag and the
+	   beginning of the second song */
+
+	struct tag *tag = tag_new();
+	tag_add_item(tag, TAG_TITLE, "Foo");
+
+	write_string(recorder, "aa");
+	recorder_data += read_all(recorder);
+	write_string(recorder, "bb");
+	send_tag(recorder, tag, read_recorder);
+	write_string(recorder, "cc");
+	recorder_data += read_all(recorder);
+
+	assert(recorder_data == "<H0>aabb<E><H1>cc");
+
+	/* the httpd output is still playing the first song */
+
+	read_like_httpd(httpd, httpd_header, httpd_data);
+	assert(httpd_header == "<H1>");
+
+	write_string(httpd, "aa");
+	write_string(httpd, "bb");
+	send_tag(httpd, tag, read_httpd);
+	read_like_httpd(httpd, httpd_header, httpd_data);
+	assert(httpd_header == "<H1>");
+
+	write_string(httpd, "cc");
+	write_string(httpd, "dd");
+	read_like_httpd(httpd, httpd_header, httpd_data);
+	assert(httpd_data == "[header]aabb<E>[header]ccdd");
+	assert(httpd_header == "<H1>");
+
+	/* now the httpd output is ahead, and applies the next tag */
+
+	send_tag(httpd, tag, read_httpd);
+	write_string(httpd, "ee");
+	read_like_httpd(httpd, httpd_header, httpd_data);
+	assert(httpd_header == "<H2>");
+	assert(httpd_data == "[header]aabb<E>[header]ccdd<E>[header]ee");
+
+	write_string(recorder, "dd");
+	send_tag(recorder, tag, read_recorder);
+	write_string(recorder, "ee");
+	recorder_data += read_all(recorder);
+	assert(recorder_data == "<H0>aabb<E><H1>ccdd<E><H2>ee");
+
+	tag_free(tag);
+
+	encoder_close(httpd);
+	encoder_close(recorder);
+	encoder_finish(httpd);
+	encoder_finish(recorder);
+}
+
+/**
+ * All members of a group must have the same encoder settings.
+ */
+static void
+test_different_settings(void)
+{
+	config_param a, b, c;
+	a.AddBlockParam("shared_encoder", "test");
+	a.AddBlockParam("quality", "5");
+	b.AddBlockParam("shared_encoder", "test");
+	b.AddBlockParam("quality", "5");
+	c.AddBlockParam("shared_encoder", "test");
+	c.AddBlockParam("quality", "9");
+
+	struct encoder *ea =
+		shared_encoder_init(&fake_encoder_plugin, &a, nullptr);
+	assert(ea != nullptr);
+
+	struct encoder *eb =
+		shared_encoder_init(&fake_encoder_plugin, &b, nullptr);
+	assert(eb != nullptr);
+	assert(b.block_params[1].used);
+
+	GError *error = nullptr;
+	struct encoder *ec =
+		shared_encoder_init(&fake_encoder_plugin, &c, &error);
+	assert(ec == nullptr);
+	assert(error != nullptr);
+	g_error_free(error);
+
+	encoder_finish(eb);
+	encoder_finish(ea);
+}
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	test_different_speeds();
+	test_different_settings();
+}